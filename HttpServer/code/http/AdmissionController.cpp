@@ -0,0 +1,191 @@
+#include "AdmissionController.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <muduo/base/Logging.h>
+
+namespace http
+{
+
+ConcurrencyLimiter::ConcurrencyLimiter(const AdmissionConfig& config)
+    : config_(config)
+    , limit_(config.initialLimit)
+    , inflight_(0)
+    , avgServiceSecs_(0)
+    , estimatedLimit_(config.initialLimit)
+    , minRtt_(0)
+    , minRttResetTime_(muduo::Timestamp::now())
+    , rttSum_(0)
+    , sampleCount_(0)
+    , windowDropped_(false)
+{
+}
+
+bool ConcurrencyLimiter::tryAcquire(double ratio, double queueDelaySecs)
+{
+    double queued = queuedRequests(queueDelaySecs);
+    int current = inflight_.load(std::memory_order_relaxed);
+    while (true)
+    {
+        // ratio <= 0 表示不受自适应上限约束
+        if (ratio > 0 && current + queued >= std::max(1, static_cast<int>(limit() * ratio)))
+        {
+            return false;
+        }
+        if (inflight_.compare_exchange_weak(current, current + 1, std::memory_order_relaxed))
+        {
+            return true;
+        }
+    }
+}
+
+void ConcurrencyLimiter::cancel()
+{
+    inflight_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void ConcurrencyLimiter::release(double queueDelaySecs, double serviceSecs, bool dropped)
+{
+    inflight_.fetch_sub(1, std::memory_order_relaxed);
+    // 延迟样本从接收时刻算起，排队变长与处理变慢都会使其膨胀
+    updateLimit(queueDelaySecs + serviceSecs, serviceSecs, dropped);
+}
+
+double ConcurrencyLimiter::queuedRequests(double queueDelaySecs) const
+{
+    double service = avgServiceSecs_.load(std::memory_order_relaxed);
+    if (queueDelaySecs <= 0 || service <= 0)
+    {
+        return 0;
+    }
+    return queueDelaySecs / service;
+}
+
+void ConcurrencyLimiter::updateLimit(double sampleRtt, double serviceSecs, bool dropped)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    double avgService = avgServiceSecs_.load(std::memory_order_relaxed);
+    avgServiceSecs_.store(avgService == 0 ? serviceSecs : avgService * 0.9 + serviceSecs * 0.1,
+                          std::memory_order_relaxed);
+
+    // 周期性重置最小延迟基线，避免依赖方恢复或变慢后基线失真
+    muduo::Timestamp now = muduo::Timestamp::now();
+    if (muduo::timeDifference(now, minRttResetTime_) > config_.minRttResetSecs)
+    {
+        minRtt_ = 0;
+        minRttResetTime_ = now;
+    }
+
+    if (!dropped && (minRtt_ == 0 || sampleRtt < minRtt_))
+    {
+        minRtt_ = sampleRtt;
+    }
+    rttSum_ += sampleRtt;
+    windowDropped_ = windowDropped_ || dropped;
+    if (++sampleCount_ < config_.windowSize)
+    {
+        return;
+    }
+
+    double avgRtt = rttSum_ / sampleCount_;
+    double gradient = 1.0;
+    if (windowDropped_)
+    {
+        // 出现失败时按乘性减收缩
+        gradient = 0.5;
+    }
+    else if (avgRtt > 0 && minRtt_ > 0)
+    {
+        gradient = std::max(0.5, std::min(1.0, minRtt_ * config_.tolerance / avgRtt));
+    }
+
+    double newLimit = estimatedLimit_ * gradient + std::sqrt(estimatedLimit_);
+    newLimit = estimatedLimit_ * (1 - config_.smoothing) + newLimit * config_.smoothing;
+    newLimit = std::max<double>(config_.minLimit, std::min<double>(config_.maxLimit, newLimit));
+
+    if (static_cast<int>(newLimit) != limit())
+    {
+        LOG_DEBUG << "Concurrency limit " << limit() << " -> " << static_cast<int>(newLimit)
+                  << ", minRtt=" << minRtt_ << "s, avgRtt=" << avgRtt << "s";
+    }
+    estimatedLimit_ = newLimit;
+    limit_.store(static_cast<int>(newLimit), std::memory_order_relaxed);
+
+    rttSum_ = 0;
+    sampleCount_ = 0;
+    windowDropped_ = false;
+}
+
+AdmissionController::AdmissionController(const AdmissionConfig& config)
+    : config_(config)
+    , globalLimiter_(config)
+    , defaultGroup_{"", kNormal, std::make_unique<ConcurrencyLimiter>(config)}
+{
+}
+
+void AdmissionController::addRouteGroup(const std::string& pathPrefix, Priority priority)
+{
+    groups_.push_back(RouteGroup{pathPrefix, priority, std::make_unique<ConcurrencyLimiter>(config_)});
+    std::stable_sort(groups_.begin(), groups_.end(),
+        [](const RouteGroup& a, const RouteGroup& b) {
+            return a.prefix.size() > b.prefix.size();
+        });
+}
+
+AdmissionController::Ticket AdmissionController::tryAdmit(const HttpRequest& req)
+{
+    RouteGroup* group = findGroup(req.path());
+    double ratio = priorityRatio(group->priority);
+    double queueDelay = 0;
+    if (req.receiveTime().valid())
+    {
+        queueDelay = std::max(0.0, muduo::timeDifference(muduo::Timestamp::now(), req.receiveTime()));
+    }
+    if (globalLimiter_.tryAcquire(ratio, queueDelay))
+    {
+        // 关键分组同样不受分组上限约束
+        if (group->limiter->tryAcquire(ratio > 0 ? 1.0 : 0, queueDelay))
+        {
+            return Ticket(&globalLimiter_, group->limiter.get(), queueDelay);
+        }
+        globalLimiter_.cancel();
+    }
+
+    LOG_WARN << "Request shed: " << req.path() << ", queued " << queueDelay * 1000 << "ms"
+             << ", inflight=" << globalLimiter_.inflight() << "/" << globalLimiter_.limit()
+             << ", group inflight=" << group->limiter->inflight() << "/" << group->limiter->limit();
+    return Ticket();
+}
+
+AdmissionController::RouteGroup* AdmissionController::findGroup(const std::string& path)
+{
+    for (auto& group : groups_)
+    {
+        if (path.compare(0, group.prefix.size(), group.prefix) == 0)
+        {
+            return &group;
+        }
+    }
+    return &defaultGroup_;
+}
+
+// 不同优先级可使用的并发上限比例，低优先级请求先被拒绝
+double AdmissionController::priorityRatio(Priority priority)
+{
+    switch (priority)
+    {
+        case kCritical:
+            return 0;
+        case kHigh:
+            return 1.0;
+        case kNormal:
+            return 0.9;
+        case kLow:
+            return 0.75;
+    }
+    return 1.0;
+}
+
+} // namespace http
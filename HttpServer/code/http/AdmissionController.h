@@ -0,0 +1,181 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <muduo/base/Timestamp.h>
+
+#include "HttpRequest.h"
+
+namespace http
+{
+
+// 准入控制配置
+struct AdmissionConfig
+{
+    int    initialLimit = 64;     // 初始并发上限
+    int    minLimit = 8;          // 并发上限下界
+    int    maxLimit = 1024;       // 并发上限上界
+    double smoothing = 0.2;       // 新上限的平滑系数 (0, 1]
+    double tolerance = 1.5;       // 允许的延迟膨胀倍数，超过后开始收缩上限
+    int    windowSize = 100;      // 每多少个样本计算一次新上限
+    double minRttResetSecs = 30;  // 最小延迟基线的重置周期（秒）
+    int    retryAfterSecs = 1;    // 503 响应中的 Retry-After
+
+    static AdmissionConfig defaultConfig()
+    {
+        return AdmissionConfig();
+    }
+};
+
+// 基于延迟梯度的自适应并发限制器
+// limit = limit * gradient + sqrt(limit)，gradient = minRtt * tolerance / sampleRtt，取值 [0.5, 1]
+// 延迟正常时上限缓慢增长，延迟膨胀时按比例收缩
+// 处理函数在 IO 线程上同步执行，正在处理的请求数不会超过 IO 线程数，过载表现为请求在缓冲区中排队；
+// 因此延迟样本从请求接收时刻算起（含排队时间），准入时的负载 = 正在处理数 + 排在本请求之前的请求数，
+// 后者按 Little 定律估计为 排队时间 / 平均处理时间
+class ConcurrencyLimiter
+{
+public:
+    explicit ConcurrencyLimiter(const AdmissionConfig& config);
+
+    // 尝试占用一个并发名额，ratio 为该优先级可使用的上限比例，queueDelaySecs 为请求从接收到准入的等待时间
+    bool tryAcquire(double ratio, double queueDelaySecs);
+    // 归还名额但不提交延迟样本（请求最终未被处理）
+    void cancel();
+    // 释放名额并提交延迟样本，dropped 表示请求失败（5xx），按过载信号处理
+    void release(double queueDelaySecs, double serviceSecs, bool dropped);
+
+    int limit() const { return limit_.load(std::memory_order_relaxed); }
+    int inflight() const { return inflight_.load(std::memory_order_relaxed); }
+
+private:
+    void updateLimit(double sampleRtt, double serviceSecs, bool dropped);
+    // 排队时间折算的排队请求数
+    double queuedRequests(double queueDelaySecs) const;
+
+private:
+    AdmissionConfig  config_;
+    std::atomic<int> limit_; // 当前并发上限
+    std::atomic<int> inflight_; // 正在处理的请求数
+    std::atomic<double> avgServiceSecs_; // 处理时间（不含排队）的指数移动平均
+    std::mutex       mutex_; // 保护以下采样状态
+    double           estimatedLimit_; // 未取整的上限估计值
+    double           minRtt_; // 窗口内观测到的最小延迟
+    muduo::Timestamp minRttResetTime_; // 上次重置最小延迟的时间
+    double           rttSum_; // 当前窗口的延迟之和
+    int              sampleCount_; // 当前窗口的样本数
+    bool             windowDropped_; // 当前窗口内是否出现过失败
+};
+
+// 准入控制器：全局限制器按优先级比例准入，实现跨分组的优先级丢弃；
+// 每个路由分组另有独立限制器，慢分组只收缩自己的上限，不拖累其它分组
+class AdmissionController
+{
+public:
+    // 优先级越高越晚被丢弃
+    enum Priority
+    {
+        kCritical, // 健康检查等，永不因自适应上限被拒绝
+        kHigh,
+        kNormal,
+        kLow,
+    };
+
+    // 请求通过准入后持有的凭证，析构时归还名额并提交延迟样本
+    class Ticket
+    {
+    public:
+        Ticket() = default;
+        Ticket(ConcurrencyLimiter* global, ConcurrencyLimiter* group, double queueDelaySecs)
+            : global_(global)
+            , group_(group)
+            , start_(muduo::Timestamp::now())
+            , queueDelaySecs_(queueDelaySecs)
+        {}
+        ~Ticket() { release(false); }
+
+        Ticket(Ticket&& other) noexcept
+            : global_(other.global_)
+            , group_(other.group_)
+            , start_(other.start_)
+            , queueDelaySecs_(other.queueDelaySecs_)
+        {
+            other.global_ = nullptr;
+            other.group_ = nullptr;
+        }
+
+        Ticket& operator=(Ticket&& other) noexcept
+        {
+            if (this != &other)
+            {
+                release(false);
+                global_ = other.global_;
+                group_ = other.group_;
+                start_ = other.start_;
+                queueDelaySecs_ = other.queueDelaySecs_;
+                other.global_ = nullptr;
+                other.group_ = nullptr;
+            }
+            return *this;
+        }
+
+        Ticket(const Ticket&) = delete;
+        Ticket& operator=(const Ticket&) = delete;
+
+        bool admitted() const { return global_ != nullptr; }
+
+        // 请求处理完毕，提交本次的排队时间与处理时间
+        void release(bool dropped)
+        {
+            if (global_)
+            {
+                double service = muduo::timeDifference(muduo::Timestamp::now(), start_);
+                global_->release(queueDelaySecs_, service, dropped);
+                group_->release(queueDelaySecs_, service, dropped);
+                global_ = nullptr;
+                group_ = nullptr;
+            }
+        }
+
+    private:
+        ConcurrencyLimiter* global_ = nullptr;
+        ConcurrencyLimiter* group_ = nullptr;
+        muduo::Timestamp    start_; // 准入时间
+        double              queueDelaySecs_ = 0; // 从接收到准入的等待时间
+    };
+
+    explicit AdmissionController(const AdmissionConfig& config = AdmissionConfig::defaultConfig());
+
+    // 按路径前缀划分路由分组，最长前缀优先；未匹配的请求归入默认分组
+    // 需在服务器启动前调用
+    void addRouteGroup(const std::string& pathPrefix, Priority priority);
+
+    // 尝试准入请求，返回的 Ticket 未 admitted 时应直接回复 503
+    // 排队时间按 req.receiveTime() 计算，同一次读取中解析出的后续流水线请求会累积前面请求的处理时间
+    Ticket tryAdmit(const HttpRequest& req);
+
+    int retryAfterSecs() const { return config_.retryAfterSecs; }
+
+private:
+    struct RouteGroup
+    {
+        std::string                         prefix;
+        Priority                            priority;
+        std::unique_ptr<ConcurrencyLimiter> limiter;
+    };
+
+    RouteGroup* findGroup(const std::string& path);
+    static double priorityRatio(Priority priority);
+
+private:
+    AdmissionConfig         config_;
+    ConcurrencyLimiter      globalLimiter_; // 所有分组共享的总并发上限
+    std::vector<RouteGroup> groups_; // 按前缀长度降序排列
+    RouteGroup              defaultGroup_;
+};
+
+} // namespace http
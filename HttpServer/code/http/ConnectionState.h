@@ -0,0 +1,53 @@
+#pragma once
+
+#include <memory>
+
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <muduo/net/TcpConnection.h>
+
+#include "HttpContext.h"
+#include "../ssl/SslConnection.h"
+
+namespace http
+{
+
+// 每个连接的状态，保存在 TcpConnection 的 context 中，由连接自己持有，只在所属 IO 线程上访问
+// SslConnection 持有 TcpConnectionPtr，连接断开时 HttpServer 清空 context 打破循环引用；
+// 异步握手的任务也会持有 SslConnection，因此用 shared_ptr
+struct ConnectionState
+{
+    // 正在发送的文件响应，输出缓冲区清空后（WriteCompleteCallback）继续发送下一块
+    struct FileTransfer
+    {
+        int   fd = -1; // 没有正在发送的文件时为 -1
+        off_t offset = 0; // 下一块的起始位置
+        off_t end = 0; // 文件长度
+        bool  closeAfter = false; // 发送完毕后关闭连接
+    };
+
+    ~ConnectionState()
+    {
+        if (file.fd >= 0)
+        {
+            ::close(file.fd); // 连接在文件发完前断开
+        }
+    }
+
+    HttpContext                         context; // HTTP 解析状态
+    std::shared_ptr<ssl::SslConnection> ssl; // TLS 状态，HTTP 连接为空
+    FileTransfer                        file; // 发送中的文件，发送期间暂停处理流水线中的后续请求
+};
+
+// boost::any 要求可拷贝，用 shared_ptr 保存
+using ConnectionStatePtr = std::shared_ptr<ConnectionState>;
+
+// 取出连接的状态，连接已断开（context 已清空）时返回 nullptr
+inline ConnectionState* connectionState(const muduo::net::TcpConnectionPtr& conn)
+{
+    ConnectionStatePtr* state = boost::any_cast<ConnectionStatePtr>(conn->getMutableContext());
+    return state ? state->get() : nullptr;
+}
+
+} // namespace http
@@ -118,6 +118,12 @@ void HttpRequest::addHeader(const char *start, const char *colon, const char *en
     {
         value.resize(value.size() - 1);
     }
+    if (key == "Cookie")
+    {
+        // 重新赋值会使已解析的视图失效
+        cookies_.values.clear();
+        cookies_.parsed = false;
+    }
     headers_[key] = value;
 }
 
@@ -132,6 +138,72 @@ std::string HttpRequest::getHeader(const std::string &field) const
     return result;
 }
 
+std::string_view HttpRequest::getCookie(std::string_view name) const
+{
+    const auto& jar = cookies();
+    auto it = jar.find(name);
+    return it != jar.end() ? it->second : std::string_view();
+}
+
+bool HttpRequest::hasCookie(std::string_view name) const
+{
+    return cookies().count(name) > 0;
+}
+
+// 按 RFC 6265 解析 "name1=value1; name2=value2"，名称完整匹配（"xsessionId" 不会匹配 "sessionId"）
+// 同名 cookie 保留第一个（浏览器把路径更具体的放在前面），值两侧的双引号会被去掉
+const std::unordered_map<std::string_view, std::string_view>& HttpRequest::cookies() const
+{
+    if (cookies_.parsed)
+    {
+        return cookies_.values;
+    }
+    cookies_.parsed = true;
+
+    auto header = headers_.find("Cookie");
+    if (header == headers_.end())
+    {
+        return cookies_.values;
+    }
+
+    auto trim = [](std::string_view s) {
+        while (!s.empty() && (s.front() == ' ' || s.front() == '\t'))
+        {
+            s.remove_prefix(1);
+        }
+        while (!s.empty() && (s.back() == ' ' || s.back() == '\t'))
+        {
+            s.remove_suffix(1);
+        }
+        return s;
+    };
+
+    std::string_view rest(header->second);
+    while (!rest.empty())
+    {
+        size_t semicolon = rest.find(';');
+        std::string_view pair = rest.substr(0, semicolon);
+        rest = semicolon == std::string_view::npos ? std::string_view() : rest.substr(semicolon + 1);
+
+        size_t equal = pair.find('=');
+        if (equal == std::string_view::npos)
+        {
+            continue;
+        }
+        std::string_view name = trim(pair.substr(0, equal));
+        std::string_view value = trim(pair.substr(equal + 1));
+        if (value.size() >= 2 && value.front() == '"' && value.back() == '"')
+        {
+            value = value.substr(1, value.size() - 2);
+        }
+        if (!name.empty())
+        {
+            cookies_.values.emplace(name, value);
+        }
+    }
+    return cookies_.values;
+}
+
 void HttpRequest::swap(HttpRequest &that)
 {
     std::swap(method_, that.method_);
@@ -141,6 +213,10 @@ void HttpRequest::swap(HttpRequest &that)
     std::swap(version_, that.version_);
     std::swap(headers_, that.headers_);
     std::swap(receiveTime_, that.receiveTime_);
+    std::swap(deadline_, that.deadline_);
+    std::swap(authClaims_, that.authClaims_);
+    // map 交换的是节点，视图指向的字符串不会移动，可以随之交换
+    std::swap(cookies_, that.cookies_);
 }
 
 } // namespace http
\ No newline at end of file
@@ -1,10 +1,14 @@
 #pragma once
 
 #include <map>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <unordered_map>
+#include <utility>
 
 #include <muduo/base/Timestamp.h>
+#include <nlohmann/json_fwd.hpp>
 
 namespace http
 {
@@ -25,6 +29,13 @@ public:
     
     void setReceiveTime(muduo::Timestamp t);
     muduo::Timestamp receiveTime() const { return receiveTime_; }
+
+    // 请求截止时间，无效的 Timestamp 表示不限时
+    void setDeadline(muduo::Timestamp t) { deadline_ = t; }
+    muduo::Timestamp deadline() const { return deadline_; }
+    bool hasDeadline() const { return deadline_.valid(); }
+    bool deadlineExceeded() const
+    { return hasDeadline() && !(muduo::Timestamp::now() < deadline_); }
     
     bool setMethod(const char* start, const char* end);
     Method method() const { return method_; }
@@ -54,6 +65,18 @@ public:
     const std::map<std::string, std::string>& headers() const
     { return headers_; }
 
+    // Cookie 请求头中名为 name 的值，不存在时返回空
+    // 第一次访问时解析整个 Cookie 头，之后 O(1) 查找；返回的视图指向请求头，在请求对象存续期间有效
+    std::string_view getCookie(std::string_view name) const;
+    bool hasCookie(std::string_view name) const;
+    const std::unordered_map<std::string_view, std::string_view>& cookies() const;
+
+    // 认证中间件验证通过后设置的 token claims，未认证时为空
+    void setAuthClaims(std::shared_ptr<const nlohmann::json> claims)
+    { authClaims_ = std::move(claims); }
+    const nlohmann::json* authClaims() const
+    { return authClaims_.get(); }
+
     void setBody(const std::string& body) { content_ = body; }
     void setBody(const char* start, const char* end) 
     { 
@@ -74,6 +97,38 @@ public:
 
     void swap(HttpRequest& that);
 
+private:
+    // 解析后的 Cookie 视图，指向所属请求的 headers_
+    // 复制请求时视图会指向源对象，所以副本不复制视图而是按需重新解析；
+    // 移动时 std::map 的节点随之转移，视图仍然有效
+    struct CookieJar
+    {
+        std::unordered_map<std::string_view, std::string_view> values;
+        bool                                                   parsed = false;
+
+        CookieJar() = default;
+        CookieJar(const CookieJar&) {}
+        CookieJar& operator=(const CookieJar&)
+        {
+            values.clear();
+            parsed = false;
+            return *this;
+        }
+        CookieJar(CookieJar&& other) noexcept
+            : values(std::move(other.values))
+            , parsed(std::exchange(other.parsed, false))
+        {
+            other.values.clear();
+        }
+        CookieJar& operator=(CookieJar&& other) noexcept
+        {
+            values = std::move(other.values);
+            parsed = std::exchange(other.parsed, false);
+            other.values.clear();
+            return *this;
+        }
+    };
+
 private:
     Method                                       method_; // 请求方法
     std::string                                  version_; // http版本
@@ -81,9 +136,12 @@ private:
     std::unordered_map<std::string, std::string> pathParameters_; // 路径参数
     std::unordered_map<std::string, std::string> queryParameters_; // 查询参数
     muduo::Timestamp                             receiveTime_; // 接收时间
+    muduo::Timestamp                             deadline_; // 截止时间
     std::map<std::string, std::string>           headers_; // 请求头
     std::string                                  content_; // 请求体
     uint64_t                                     contentLength_ { 0 }; // 请求体长度
+    std::shared_ptr<const nlohmann::json>        authClaims_; // 认证信息
+    mutable CookieJar                            cookies_; // 指向 Cookie 头的视图，按需解析
 };  
 
 } // namespace http
\ No newline at end of file
@@ -20,11 +20,14 @@ public:
         k404NotFound = 404,
         k409Conflict = 409,
         k500InternalServerError = 500,
+        k503ServiceUnavailable = 503,
+        k504GatewayTimeout = 504,
     };
 
     HttpResponse(bool close = true)
         : statusCode_(kUnknown)
         , closeConnection_(close)
+        , isFile_(false)
     {}
 
     void setVersion(std::string version)
@@ -59,6 +62,20 @@ public:
         // body_ += "\0";
     }
 
+    // 响应体为磁盘文件：由 HttpServer 打开并补上 Content-Length，
+    // HTTPS 连接启用了 kTLS 时用 sendfile 发送，不经过用户态内存
+    void setFile(const std::string& filePath)
+    {
+        filePath_ = filePath;
+        isFile_ = true;
+    }
+
+    bool isFile() const
+    { return isFile_; }
+
+    const std::string& filePath() const
+    { return filePath_; }
+
     void setStatusLine(const std::string& version,
                          HttpStatusCode statusCode,
                          const std::string& statusMessage);
@@ -74,6 +91,7 @@ private:
     std::map<std::string, std::string> headers_;
     std::string                        body_;
     bool                               isFile_;
+    std::string                        filePath_; // isFile_ 为 true 时的文件路径
 };
 
 } // namespace http
\ No newline at end of file
@@ -1,12 +1,43 @@
 #include "HttpServer.h"
 
+#include <algorithm>
 #include <any>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
 #include <functional>
 #include <memory>
 
+#include <fcntl.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 namespace http
 {
 
+namespace
+{
+
+// 信号处理函数中只能使用全局变量，指向 reloadCertificatesOnSignal 创建的 eventfd
+volatile sig_atomic_t gReloadEventFd = -1;
+
+void onReloadSignalHandler(int)
+{
+    int savedErrno = errno;
+    int fd = gReloadEventFd;
+    if (fd >= 0)
+    {
+        uint64_t one = 1;
+        ssize_t n = ::write(fd, &one, sizeof(one)); // write 是异步信号安全的
+        (void)n;
+    }
+    errno = savedErrno;
+}
+
+} // namespace
+
 // 默认http回应函数
 void defaultHttpCallback(const HttpRequest &, HttpResponse *resp)
 {
@@ -27,10 +58,38 @@ HttpServer::HttpServer(int port,
     initialize();
 }
 
+HttpServer::~HttpServer()
+{
+    if (reloadChannel_)
+    {
+        gReloadEventFd = -1;
+        reloadChannel_->disableAll();
+        reloadChannel_->remove();
+        ::close(reloadEventFd_);
+    }
+}
+
 // 服务器运行函数
 void HttpServer::start()
 {
     LOG_WARN << "HttpServer[" << server_.name() << "] starts listening on" << server_.ipPort();
+    if (sessionManager_)
+    {
+        // 过期会话在主循环上增量清理
+        sessionManager_->startCleanup(&mainLoop_);
+    }
+    if (sslCtx_)
+    {
+        // 票据密钥到期轮换，其它工作进程写入的新密钥也在这里加载
+        mainLoop_.runEvery(sslCtx_->ticketKeyCheckInterval(),
+                           std::bind(&ssl::SslContext::rotateTicketKeys, sslCtx_.get()));
+        // 证书文件被替换后自动重新加载
+        if (sslCtx_->certificateCheckInterval() > 0)
+        {
+            mainLoop_.runEvery(sslCtx_->certificateCheckInterval(),
+                               std::bind(&ssl::SslContext::checkCertificates, sslCtx_.get()));
+        }
+    }
     server_.start();
     mainLoop_.loop();
 }
@@ -45,6 +104,8 @@ void HttpServer::initialize()
                   std::placeholders::_1,
                   std::placeholders::_2,
                   std::placeholders::_3));
+    server_.setWriteCompleteCallback(
+        std::bind(&HttpServer::resumeFileTransfer, this, std::placeholders::_1));
 }
 
 void HttpServer::setSslConfig(const ssl::SslConfig& config)
@@ -60,26 +121,80 @@ void HttpServer::setSslConfig(const ssl::SslConfig& config)
     }
 }
 
+void HttpServer::reloadCertificatesOnSignal(int signo)
+{
+    // 信号可能投递给任意线程（握手线程池、连接池维护线程等在此之前就已创建，屏蔽信号对它们无效），
+    // 处理函数只向 eventfd 写入计数，证书在主循环上重新加载
+    reloadEventFd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (reloadEventFd_ < 0)
+    {
+        LOG_SYSERR << "eventfd";
+        return;
+    }
+    gReloadEventFd = reloadEventFd_;
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = &onReloadSignalHandler;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART; // 被打断的系统调用自动重启
+    if (::sigaction(signo, &action, nullptr) != 0)
+    {
+        LOG_SYSERR << "sigaction";
+        gReloadEventFd = -1;
+        ::close(reloadEventFd_);
+        reloadEventFd_ = -1;
+        return;
+    }
+    reloadChannel_ = std::make_unique<muduo::net::Channel>(&mainLoop_, reloadEventFd_);
+    reloadChannel_->setReadCallback(std::bind(&HttpServer::onReloadSignal, this));
+    reloadChannel_->enableReading();
+}
+
+void HttpServer::onReloadSignal()
+{
+    uint64_t count;
+    ssize_t n = ::read(reloadEventFd_, &count, sizeof(count)); // 多次信号合并为一次重新加载
+    (void)n;
+
+    if (sslCtx_)
+    {
+        LOG_INFO << "Reloading certificates on signal";
+        sslCtx_->reloadCertificates();
+    }
+}
+
+void HttpServer::setRouteTimeout(const std::string& pathPrefix, double seconds)
+{
+    routeTimeouts_.emplace_back(pathPrefix, seconds);
+    std::stable_sort(routeTimeouts_.begin(), routeTimeouts_.end(),
+        [](const std::pair<std::string, double>& a, const std::pair<std::string, double>& b) {
+            return a.first.size() > b.first.size();
+        });
+}
+
 void HttpServer::onConnection(const muduo::net::TcpConnectionPtr& conn)
 {
     if (conn->connected())
     {
+        auto state = std::make_shared<ConnectionState>();
         if (useSSL_)
         {
-            auto sslConn = std::make_unique<ssl::SslConnection>(conn, sslCtx_.get());
-            sslConn->setMessageCallback(
+            // SslConnection 接管连接的消息回调，解密后的数据再交给 onMessage 解析
+            state->ssl = std::make_shared<ssl::SslConnection>(conn, sslCtx_.get());
+            state->ssl->setMessageCallback(
                 std::bind(&HttpServer::onMessage, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
-            sslConns_[conn] = std::move(sslConn);
-            sslConns_[conn]->startHandshake();
         }
-        conn->setContext(HttpContext());
+        conn->setContext(state);
+        if (state->ssl)
+        {
+            state->ssl->startHandshake();
+        }
     }
     else 
     {
-        if (useSSL_)
-        {
-            sslConns_.erase(conn);
-        }
+        // 释放连接状态（包括 SslConnection 对连接的引用）
+        conn->setContext(boost::any());
     }
 }
 
@@ -89,46 +204,47 @@ void HttpServer::onMessage(const muduo::net::TcpConnectionPtr &conn,
 {
     try
     {
-        // 这层判断只是代表是否支持ssl
-        if (useSSL_)
-        {
-            LOG_INFO << "onMessage useSSL_ is true";
-            // 1.查找对应的SSL连接
-            auto it = sslConns_.find(conn);
-            if (it != sslConns_.end())
-            {
-                LOG_INFO << "onMessage sslConns_ is not empty";
-                // 2. SSL连接处理数据
-                it->second->onRead(conn, buf, receiveTime);
-
-                // 3. 如果 SSL 握手还未完成，直接返回
-                if (!it->second->isHandshakeCompleted())
-                {
-                    LOG_INFO << "onMessage sslConns_ is not empty";
-                    return;
-                }
-
-                // 4. 从SSL连接的解密缓冲区获取数据
-                muduo::net::Buffer* decryptedBuf = it->second->getDecryptedBuffer();
-                if (decryptedBuf->readableBytes() == 0)
-                    return; // 没有解密后的数据
-
-                // 5. 使用解密后的数据进行HTTP 处理
-                buf = decryptedBuf; // 将 buf 指向解密后的数据
-                LOG_INFO << "onMessage decryptedBuf is not empty";
-            }
-        }
         // HttpContext对象用于解析出buf中的请求报文，并把报文的关键信息封装到HttpRequest对象中
-        HttpContext *context = boost::any_cast<HttpContext>(conn->getMutableContext());
-        if (!context->parseRequest(buf, receiveTime)) // 解析一个http请求
+        // HTTPS 连接上 buf 是 SslConnection 的解密缓冲区，未解析完的数据会保留到下次
+        ConnectionState *state = connectionState(conn);
+        HttpContext *context = &state->context;
+        if (state->file.fd >= 0)
         {
-            // 如果解析http报文过程中出错
-            conn->send("HTTP/1.1 400 Bad Request\r\n\r\n");
-            conn->shutdown();
+            // 文件响应还没发完（0.5-RTT 响应在握手完成后由这里继续），发完后再处理后续请求
+            resumeFileTransfer(conn);
+            return;
         }
-        // 如果buf缓冲区中解析出一个完整的数据包才封装响应报文
-        if (context->gotAll())
+        // 客户端可能一次发来多个请求（流水线），逐个处理，响应按请求顺序发出；
+        // 短连接的响应发出后连接进入关闭流程，剩余的请求不再处理
+        while (conn->connected())
         {
+            // 上一个文件响应还在分块发送，发送完毕后由 resumeFileTransfer 继续处理
+            if (state->file.fd >= 0)
+            {
+                break;
+            }
+            // 推迟处理的早期数据请求已经解析完毕，不再继续解析
+            if (!context->gotAll() && !context->parseRequest(buf, receiveTime)) // 解析一个http请求
+            {
+                // 如果解析http报文过程中出错
+                muduo::net::Buffer badRequest;
+                badRequest.append("HTTP/1.1 400 Bad Request\r\n\r\n");
+                sendBuffer(conn, &badRequest);
+                conn->shutdown();
+                return;
+            }
+            // 请求还不完整，等待更多数据
+            if (!context->gotAll())
+            {
+                break;
+            }
+            // 握手完成前到达的请求来自 0-RTT 早期数据，可能被重放，不允许的路由等握手完成后
+            // SslConnection 再次回调时处理
+            if (state->ssl && !state->ssl->isHandshakeCompleted() && !acceptsEarlyData(context->request()))
+            {
+                return;
+            }
+            applyDeadline(context->request());
             onRequest(conn, context->request());
             context->reset();
         }
@@ -137,7 +253,9 @@ void HttpServer::onMessage(const muduo::net::TcpConnectionPtr &conn,
     {
         // 捕获异常，返回错误信息
         LOG_ERROR << "Exception in onMessage: " << e.what();
-        conn->send("HTTP/1.1 400 Bad Request\r\n\r\n");
+        muduo::net::Buffer badRequest;
+        badRequest.append("HTTP/1.1 400 Bad Request\r\n\r\n");
+        sendBuffer(conn, &badRequest);
         conn->shutdown();
     }
 }
@@ -149,16 +267,47 @@ void HttpServer::onRequest(const muduo::net::TcpConnectionPtr &conn, const HttpR
                   (req.getVersion() == "HTTP/1.0" && connection != "Keep-Alive"));
     HttpResponse response(close);
 
-    // 根据请求报文信息来封装响应报文对象
-    httpCallback_(req, &response); // 执行onHttpCallback函数
+    AdmissionController::Ticket ticket;
+    if (admissionController_)
+    {
+        ticket = admissionController_->tryAdmit(req);
+        if (!ticket.admitted())
+        {
+            // 过载时快速拒绝，不进入中间件和路由
+            sendServiceUnavailable(conn, close);
+            return;
+        }
+    }
 
-    // 可以给response设置一个成员，判断是否请求的是文件，如果是文件设置为true，并且存在文件位置在这里send出去。
-    muduo::net::Buffer buf;
-    response.appendToBuffer(&buf);
-    // 打印完整的响应内容用于调试
-    LOG_INFO << "Sending response:\n" << buf.toStringPiece().as_string();
+    {
+        session::SessionManager::RequestScope sessionScope;
+        // 根据请求报文信息来封装响应报文对象
+        httpCallback_(req, &response); // 执行onHttpCallback函数
+        // 本次请求中修改过的会话统一写回一次
+        session::SessionManager::flushPendingSessions();
+    }
+    // 5xx 视为依赖方过载信号，参与并发上限的收缩
+    ticket.release(response.getStatusCode() >= HttpResponse::k500InternalServerError);
 
-    conn->send(&buf);
+    if (response.isFile())
+    {
+        sendFileResponse(conn, response);
+        ConnectionState* state = connectionState(conn);
+        if (state && state->file.fd >= 0)
+        {
+            // 文件还在分块发送，短连接等发送完毕后再关闭
+            return;
+        }
+    }
+    else
+    {
+        muduo::net::Buffer buf;
+        response.appendToBuffer(&buf);
+        // 打印完整的响应内容用于调试（会拷贝整个响应，只在 DEBUG 级别输出）
+        LOG_DEBUG << "Sending response:\n" << buf.toStringPiece().as_string();
+
+        sendBuffer(conn, &buf);
+    }
     // 如果是短连接的话，返回响应报文后就断开连接
     if (response.closeConnection())
     {
@@ -166,14 +315,234 @@ void HttpServer::onRequest(const muduo::net::TcpConnectionPtr &conn, const HttpR
     }
 }
 
+void HttpServer::sendServiceUnavailable(const muduo::net::TcpConnectionPtr &conn, bool close)
+{
+    HttpResponse response(close);
+    response.setStatusLine("HTTP/1.1", HttpResponse::k503ServiceUnavailable, "Service Unavailable");
+    response.addHeader("Retry-After", std::to_string(admissionController_->retryAfterSecs()));
+    response.setContentLength(0);
+
+    muduo::net::Buffer buf;
+    response.appendToBuffer(&buf);
+    sendBuffer(conn, &buf);
+    if (close)
+    {
+        conn->shutdown();
+    }
+}
+
+void HttpServer::sendBuffer(const muduo::net::TcpConnectionPtr &conn, muduo::net::Buffer *buf)
+{
+    if (useSSL_)
+    {
+        ConnectionState* state = connectionState(conn);
+        if (state && state->ssl)
+        {
+            state->ssl->send(buf->peek(), buf->readableBytes());
+            buf->retrieveAll();
+        }
+        return;
+    }
+    conn->send(buf);
+}
+
+void HttpServer::sendFileResponse(const muduo::net::TcpConnectionPtr &conn, HttpResponse& response)
+{
+    int fd = ::open(response.filePath().c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || ::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+    {
+        LOG_ERROR << "Cannot open response file " << response.filePath() << ": " << strerror(errno);
+        if (fd >= 0)
+        {
+            ::close(fd);
+        }
+        HttpResponse notFound(response.closeConnection());
+        notFound.setStatusLine("HTTP/1.1", HttpResponse::k404NotFound, "Not Found");
+        notFound.setContentLength(0);
+        muduo::net::Buffer buf;
+        notFound.appendToBuffer(&buf);
+        sendBuffer(conn, &buf);
+        return;
+    }
+
+    response.setContentLength(st.st_size);
+    muduo::net::Buffer buf;
+    response.appendToBuffer(&buf);
+    sendBuffer(conn, &buf);
+
+    // 文件内容分块发送：每次只在输出缓冲区清空时读出下一块，不会一次把整个文件读进内存
+    ConnectionState* state = connectionState(conn);
+    if (!state || (useSSL_ && !state->ssl))
+    {
+        ::close(fd);
+        return;
+    }
+    state->file.fd = fd;
+    state->file.offset = 0;
+    state->file.end = st.st_size;
+    state->file.closeAfter = response.closeConnection();
+    sendFileChunks(conn, state);
+}
+
+bool HttpServer::sendFileChunks(const muduo::net::TcpConnectionPtr &conn, ConnectionState* state)
+{
+    ConnectionState::FileTransfer& file = state->file;
+    while (file.offset < file.end)
+    {
+        // 数据积压在输出缓冲区（socket 发送缓冲区已满）时等待 WriteCompleteCallback
+        if (!conn->connected() || conn->outputBuffer()->readableBytes() > 0)
+        {
+            return false;
+        }
+
+        size_t chunk = static_cast<size_t>(std::min<off_t>(file.end - file.offset, kFileChunkSize));
+        ssize_t n;
+        if (state->ssl)
+        {
+            // 启用了 kTLS 时 sendfile，否则读出加密
+            n = state->ssl->sendFile(file.fd, file.offset, chunk);
+            if (n == 0)
+            {
+                return false; // 0.5-RTT 响应要等握手完成，届时 onMessage 会再次被调用
+            }
+        }
+        else
+        {
+            // 明文连接：muduo 不支持 sendfile，读出后交给输出缓冲区
+            muduo::net::Buffer buf;
+            buf.ensureWritableBytes(chunk);
+            do
+            {
+                n = ::pread(file.fd, buf.beginWrite(), chunk, file.offset);
+            } while (n < 0 && errno == EINTR);
+            if (n > 0)
+            {
+                buf.hasWritten(n);
+                conn->send(&buf);
+            }
+        }
+        if (n <= 0)
+        {
+            LOG_ERROR << "Failed to read response file: " << (n < 0 ? strerror(errno) : "unexpected EOF");
+            conn->forceClose(); // 已经发出了 Content-Length，只能断开
+            return false;
+        }
+        file.offset += n;
+    }
+
+    ::close(file.fd);
+    file = ConnectionState::FileTransfer();
+    return true;
+}
+
+void HttpServer::resumeFileTransfer(const muduo::net::TcpConnectionPtr &conn)
+{
+    ConnectionState* state = connectionState(conn);
+    if (!state || state->file.fd < 0)
+    {
+        return;
+    }
+    bool close = state->file.closeAfter;
+    if (!sendFileChunks(conn, state))
+    {
+        return;
+    }
+
+    if (close)
+    {
+        conn->shutdown();
+        return;
+    }
+    // 文件发送期间暂停的流水线请求
+    muduo::net::Buffer* buf = state->ssl ? state->ssl->getDecryptedBuffer() : conn->inputBuffer();
+    if (buf->readableBytes() > 0)
+    {
+        onMessage(conn, buf, muduo::Timestamp::now());
+    }
+}
+
+// 截止时间 = 接收时间 + min(路由超时, 客户端 X-Request-Timeout-Ms)
+// 从接收时间起算，请求在 IO 线程上排队的时间也计入
+void HttpServer::applyDeadline(HttpRequest& req) const
+{
+    double timeout = defaultTimeout_;
+    for (const auto& route : routeTimeouts_)
+    {
+        if (req.path().compare(0, route.first.size(), route.first) == 0)
+        {
+            timeout = route.second;
+            break;
+        }
+    }
+
+    std::string header = req.getHeader("X-Request-Timeout-Ms");
+    if (!header.empty())
+    {
+        char* end = nullptr;
+        double clientTimeout = std::strtod(header.c_str(), &end) / 1000.0;
+        // strtod 接受 inf/nan 与 1e300 之类的值，换算成微秒时溢出，只接受有限的正数并截断到上限
+        if (end != header.c_str() && std::isfinite(clientTimeout) && clientTimeout > 0)
+        {
+            timeout = std::min(timeout > 0 ? timeout : kMaxClientTimeoutSecs, clientTimeout);
+        }
+    }
+
+    if (timeout > 0)
+    {
+        req.setDeadline(muduo::addTime(req.receiveTime(), timeout));
+    }
+}
+
+bool HttpServer::acceptsEarlyData(const HttpRequest& req) const
+{
+    // HttpRequest 不解析 HEAD（按错误请求处理），幂等方法只有 GET
+    if (req.method() != HttpRequest::kGet)
+    {
+        return false;
+    }
+    for (const std::string& prefix : earlyDataRoutes_)
+    {
+        if (req.path().compare(0, prefix.size(), prefix) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void HttpServer::setGatewayTimeout(HttpResponse* resp) const
+{
+    *resp = HttpResponse(resp->closeConnection());
+    resp->setStatusLine("HTTP/1.1", HttpResponse::k504GatewayTimeout, "Gateway Timeout");
+    resp->setContentLength(0);
+}
+
 // 执行请求对应的路由处理函数
 void HttpServer::handleRequest(const HttpRequest &req, HttpResponse *resp)
 {
+    // 处理函数及其中的 DB 调用可通过 RequestDeadline 获取截止时间
+    RequestDeadline::Scope deadlineScope(req.deadline());
     try
     {
+        if (req.deadlineExceeded())
+        {
+            // 在 IO 线程上排队期间已经超时，不再执行处理函数
+            LOG_WARN << "Request expired before handling: " << req.path();
+            setGatewayTimeout(resp);
+            return;
+        }
+
         // 处理请求前的中间件
         HttpRequest mutableReq = req;
-        middlewareChain_.processBefore(mutableReq);
+        if (middlewarePipeline_)
+        {
+            middlewarePipeline_->processBefore(mutableReq);
+        }
+        else
+        {
+            middlewareChain_.processBefore(mutableReq);
+        }
 
         // 路由处理
         if (!router_.route(mutableReq, resp))
@@ -185,16 +554,42 @@ void HttpServer::handleRequest(const HttpRequest &req, HttpResponse *resp)
             resp->setCloseConnection(true);
         }
 
+        // 处理函数无法被中途打断，返回时已超时则丢弃其结果
+        if (req.deadlineExceeded())
+        {
+            LOG_WARN << "Request exceeded deadline: " << req.path();
+            setGatewayTimeout(resp);
+        }
+
         // 处理响应后的中间件
-        middlewareChain_.processAfter(*resp);
+        if (middlewarePipeline_)
+        {
+            middlewarePipeline_->processAfter(*resp);
+        }
+        else
+        {
+            middlewareChain_.processAfter(*resp);
+        }
     }
     catch (const HttpResponse& res) 
     {
         // 处理中间件抛出的响应（如CORS预检请求）
         *resp = res;
     }
+    catch (const DeadlineExceeded& e)
+    {
+        LOG_WARN << e.what() << ": " << req.path();
+        setGatewayTimeout(resp);
+    }
     catch (const std::exception& e) 
     {
+        // 超时导致的下游错误（如查询被中断）同样返回 504
+        if (req.deadlineExceeded())
+        {
+            LOG_WARN << "Request failed after deadline: " << e.what();
+            setGatewayTimeout(resp);
+            return;
+        }
         // 错误处理
         resp->setStatusCode(HttpResponse::k500InternalServerError);
         resp->setBody(e.what());
@@ -3,23 +3,32 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#include <csignal>
 
 #include <functional>
 #include <iostream>
 #include <map>
 #include <memory>
+#include <string>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include <muduo/net/TcpServer.h>
 #include <muduo/net/EventLoop.h>
+#include <muduo/net/Channel.h>
 #include <muduo/base/Logging.h>
 
+#include "AdmissionController.h"
+#include "ConnectionState.h"
 #include "HttpContext.h"
 #include "HttpRequest.h"
 #include "HttpResponse.h"
+#include "../utils/RequestDeadline.h"
 #include "../router/Router.h"
 #include "../session/SessionManager.h"
 #include "../middleware/MiddlewareChain.h"
+#include "../middleware/MiddlewarePipeline.h"
 #include "../middleware/CorsMiddleware.h"
 #include "../ssl/SslConnection.h"
 #include "../ssl/SslContext.h"
@@ -40,6 +49,7 @@ public:
                const std::string& name,
                bool useSSL = false,
                muduo::net::TcpServer::Option option = muduo::net::TcpServer::kNoReusePort);
+    ~HttpServer();
     
     void setThreadNum(int numThreads)
     {
@@ -110,6 +120,46 @@ public:
         middlewareChain_.addMiddleware(middleware);
     }
 
+    // 开启自适应并发限制，过载时直接返回 503
+    void enableAdmissionControl(const AdmissionConfig& config = AdmissionConfig::defaultConfig())
+    {
+        admissionController_ = std::make_unique<AdmissionController>(config);
+    }
+
+    // 为路径前缀设置优先级分组，需先调用 enableAdmissionControl
+    void setRoutePriority(const std::string& pathPrefix, AdmissionController::Priority priority)
+    {
+        if (admissionController_)
+        {
+            admissionController_->addRouteGroup(pathPrefix, priority);
+        }
+    }
+
+    // 设置默认请求超时（秒），0 表示不限时
+    void setRequestTimeout(double seconds)
+    {
+        defaultTimeout_ = seconds;
+    }
+
+    // 为路径前缀单独设置请求超时（秒），最长前缀优先，需在服务器启动前调用
+    void setRouteTimeout(const std::string& pathPrefix, double seconds);
+
+    // 允许在 TLS 1.3 0-RTT 早期数据中处理的路径前缀（需要 SslConfig::setEarlyData），只对 GET 生效
+    // 早期数据可能被重放，只应标记没有副作用的幂等路由；其余请求推迟到握手完成后处理
+    void allowEarlyData(const std::string& pathPrefix)
+    {
+        earlyDataRoutes_.push_back(pathPrefix);
+    }
+
+    // 使用编译期组合的中间件流水线，替代 addMiddleware 注册的中间件链
+    // 例：server.setMiddlewarePipeline(middleware::CorsMiddleware(config), AuthMiddleware(...));
+    template <typename... Ms>
+    void setMiddlewarePipeline(Ms&&... middlewares)
+    {
+        middlewarePipeline_ = std::make_unique<middleware::MiddlewarePipeline<std::decay_t<Ms>...>>(
+            std::forward<Ms>(middlewares)...);
+    }
+
     void enableSSL(bool enable) 
     {
         useSSL_ = enable;
@@ -117,6 +167,10 @@ public:
 
     void setSslConfig(const ssl::SslConfig& config);
 
+    // 收到 signo 信号时在主循环上重新加载证书（不断开连接），需要在 start() 之前调用
+    // 会替换该信号原有的处理函数，同一时间只能有一个 HttpServer 使用
+    void reloadCertificatesOnSignal(int signo = SIGHUP);
+
 private:
     void initialize();
 
@@ -125,8 +179,24 @@ private:
                    muduo::net::Buffer* buf,
                    muduo::Timestamp receiveTime);
     void onRequest(const muduo::net::TcpConnectionPtr&, const HttpRequest&);
+    void sendServiceUnavailable(const muduo::net::TcpConnectionPtr& conn, bool close);
+    // 发送一个完整的响应，HTTPS 连接上加密后一次写出
+    void sendBuffer(const muduo::net::TcpConnectionPtr& conn, muduo::net::Buffer* buf);
+    // 发送响应头并开始分块发送文件内容，文件打不开时改为 404
+    void sendFileResponse(const muduo::net::TcpConnectionPtr& conn, HttpResponse& response);
+    // 继续发送 state->file，输出缓冲区有积压时返回 false 等待下次回调，发送完毕返回 true
+    bool sendFileChunks(const muduo::net::TcpConnectionPtr& conn, ConnectionState* state);
+    // 继续发送文件（WriteCompleteCallback，或握手完成后的 onMessage），发送完毕后关闭短连接或处理暂停的流水线请求
+    void resumeFileTransfer(const muduo::net::TcpConnectionPtr& conn);
+    static const size_t kFileChunkSize = 64 * 1024; // 文件每次读出的块大小
+    // 客户端 X-Request-Timeout-Ms 的上限（路由未配置超时时使用），防止过大的值溢出时间计算
+    static constexpr double kMaxClientTimeoutSecs = 600;
+    void applyDeadline(HttpRequest& req) const;
+    bool acceptsEarlyData(const HttpRequest& req) const;
+    void setGatewayTimeout(HttpResponse* resp) const;
 
     void handleRequest(const HttpRequest& req, HttpResponse* resp);
+    void onReloadSignal();
     
 private:
     muduo::net::InetAddress                      listenAddr_; // 监听地址
@@ -136,10 +206,15 @@ private:
     router::Router                               router_; // 路由
     std::unique_ptr<session::SessionManager>     sessionManager_; // 会话管理器
     middleware::MiddlewareChain                  middlewareChain_; // 中间件链
+    std::unique_ptr<middleware::PipelineBase>    middlewarePipeline_; // 编译期中间件流水线（可选）
+    std::unique_ptr<AdmissionController>         admissionController_; // 准入控制（可选）
+    double                                       defaultTimeout_ = 0; // 默认请求超时（秒）
+    std::vector<std::pair<std::string, double>>  routeTimeouts_; // 路径前缀 -> 超时，按前缀长度降序
+    std::vector<std::string>                     earlyDataRoutes_; // 允许 0-RTT 的路径前缀
     std::unique_ptr<ssl::SslContext>             sslCtx_; // SSL 上下文
     bool                                         useSSL_; // 是否使用 SSL   
-    // TcpConnectionPtr -> SslConnectionPtr 
-    std::map<muduo::net::TcpConnectionPtr, std::unique_ptr<ssl::SslConnection>> sslConns_;
+    int                                          reloadEventFd_ = -1; // 信号处理函数写入，触发证书重新加载
+    std::unique_ptr<muduo::net::Channel>         reloadChannel_;
 }; 
 
 } // namespace http
\ No newline at end of file
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace http
+{
+namespace middleware
+{
+
+struct AuthConfig
+{
+    enum Algorithm
+    {
+        kHS256, // HMAC-SHA256，使用共享密钥
+        kES256, // ECDSA P-256 + SHA256，使用公钥
+    };
+
+    Algorithm                algorithm = kHS256;
+    std::string              secret; // HS256 共享密钥，至少 32 字节
+    std::string              publicKeyFile; // ES256 公钥（PEM）
+    std::string              issuer; // 非空时校验 iss
+    std::string              audience; // 非空时校验 aud
+    std::vector<std::string> excludedPaths; // 不需要认证的路径前缀，如 /login、/health
+    int                      leewaySecs = 30; // exp/nbf 的时钟偏差容忍
+    size_t                   cacheCapacity = 10000; // 验证缓存容量（0 关闭缓存）
+    int                      cacheTtlSecs = 300; // 缓存条目最长有效期，不超过 token 的 exp
+
+    static AuthConfig hs256(const std::string& secret)
+    {
+        AuthConfig config;
+        config.algorithm = kHS256;
+        config.secret = secret;
+        return config;
+    }
+
+    static AuthConfig es256(const std::string& publicKeyFile)
+    {
+        AuthConfig config;
+        config.algorithm = kES256;
+        config.publicKeyFile = publicKeyFile;
+        return config;
+    }
+};
+
+} // namespace middleware
+} // namespace http
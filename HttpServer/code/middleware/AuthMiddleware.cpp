@@ -0,0 +1,411 @@
+#include "AuthMiddleware.h"
+#include "../utils/Base64Url.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <stdexcept>
+
+#include <strings.h>
+
+#include <muduo/base/Logging.h>
+#include <openssl/bn.h>
+#include <openssl/crypto.h>
+#include <openssl/ec.h>
+#include <openssl/ecdsa.h>
+#include <openssl/evp.h>
+#include <openssl/objects.h>
+#include <openssl/hmac.h>
+#include <openssl/pem.h>
+#include <openssl/sha.h>
+
+namespace http
+{
+namespace middleware
+{
+
+namespace
+{
+
+int64_t nowSeconds()
+{
+    return std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// 读取 exp/nbf 等 NumericDate，非数值或超出合理范围时返回 false
+// 范围限制避免大浮点数转 int64_t 以及加减 leeway 时的溢出（均为未定义行为）
+bool numericDate(const json& value, int64_t* out)
+{
+    static const int64_t kMaxNumericDate = 1000000000000000LL; // 约 3 千万年，远超任何合法的过期时间
+    if (value.is_number_unsigned())
+    {
+        uint64_t v = value.get<uint64_t>();
+        if (v > static_cast<uint64_t>(kMaxNumericDate))
+        {
+            return false;
+        }
+        *out = static_cast<int64_t>(v);
+        return true;
+    }
+    if (value.is_number_integer())
+    {
+        int64_t v = value.get<int64_t>();
+        if (v > kMaxNumericDate || v < -kMaxNumericDate)
+        {
+            return false;
+        }
+        *out = v;
+        return true;
+    }
+    if (value.is_number_float())
+    {
+        double v = value.get<double>();
+        if (!std::isfinite(v) || std::fabs(v) > static_cast<double>(kMaxNumericDate))
+        {
+            return false;
+        }
+        *out = static_cast<int64_t>(v);
+        return true;
+    }
+    return false;
+}
+
+std::string sha256(const std::string& data)
+{
+    unsigned char digest[SHA256_DIGEST_LENGTH];
+    SHA256(reinterpret_cast<const unsigned char*>(data.data()), data.size(), digest);
+    return std::string(reinterpret_cast<const char*>(digest), sizeof(digest));
+}
+
+} // namespace
+
+AuthMiddleware::VerifyCache::VerifyCache(size_t capacity)
+    : capacityPerShard_((capacity + kShards - 1) / kShards)
+    , shards_(new Shard[kShards])
+{
+}
+
+AuthMiddleware::VerifyCache::Shard& AuthMiddleware::VerifyCache::shardFor(const std::string& key)
+{
+    // key 本身是 SHA-256 摘要，直接取首字节分片
+    return shards_[static_cast<unsigned char>(key[0]) % kShards];
+}
+
+AuthMiddleware::ClaimsPtr AuthMiddleware::VerifyCache::get(const std::string& key, int64_t now)
+{
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.index.find(key);
+    if (it == shard.index.end())
+    {
+        return nullptr;
+    }
+    if (it->second->expiresAt <= now)
+    {
+        shard.lru.erase(it->second);
+        shard.index.erase(it);
+        return nullptr;
+    }
+    shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+    return it->second->claims;
+}
+
+void AuthMiddleware::VerifyCache::put(const std::string& key, ClaimsPtr claims, int64_t expiresAt)
+{
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.index.find(key);
+    if (it != shard.index.end())
+    {
+        it->second->claims = std::move(claims);
+        it->second->expiresAt = expiresAt;
+        shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+        return;
+    }
+
+    shard.lru.push_front(Entry{key, std::move(claims), expiresAt});
+    shard.index[key] = shard.lru.begin();
+    if (shard.lru.size() > capacityPerShard_)
+    {
+        shard.index.erase(shard.lru.back().key);
+        shard.lru.pop_back();
+    }
+}
+
+AuthMiddleware::AuthMiddleware(const AuthConfig& config)
+    : config_(config)
+{
+    // HMAC 密钥短于摘要长度时可被暴力猜出，空密钥则任何人都能签发 token（RFC 7518 3.2）
+    if (config_.algorithm == AuthConfig::kHS256 && config_.secret.size() < kMinHs256SecretBytes)
+    {
+        throw std::runtime_error("JWT HS256 secret must be at least "
+                                 + std::to_string(kMinHs256SecretBytes) + " bytes");
+    }
+
+    if (config_.algorithm == AuthConfig::kES256)
+    {
+        FILE* fp = fopen(config_.publicKeyFile.c_str(), "r");
+        if (!fp)
+        {
+            throw std::runtime_error("Failed to open JWT public key: " + config_.publicKeyFile);
+        }
+        EVP_PKEY* key = PEM_read_PUBKEY(fp, nullptr, nullptr, nullptr);
+        fclose(fp);
+        if (!key)
+        {
+            throw std::runtime_error("Failed to load JWT public key: " + config_.publicKeyFile);
+        }
+        publicKey_.reset(key, EVP_PKEY_free);
+
+        // ES256 只能使用 P-256，其它曲线的密钥说明配置错误
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+        char group[64] = {0};
+        size_t groupLen = 0;
+        bool p256 = EVP_PKEY_get_base_id(key) == EVP_PKEY_EC
+            && EVP_PKEY_get_group_name(key, group, sizeof(group), &groupLen)
+            && OBJ_sn2nid(group) == NID_X9_62_prime256v1;
+#else
+        const EC_KEY* ec = EVP_PKEY_id(key) == EVP_PKEY_EC ? EVP_PKEY_get0_EC_KEY(key) : nullptr;
+        bool p256 = ec && EC_GROUP_get_curve_name(EC_KEY_get0_group(ec)) == NID_X9_62_prime256v1;
+#endif
+        if (!p256)
+        {
+            throw std::runtime_error("JWT public key is not a P-256 EC key: " + config_.publicKeyFile);
+        }
+    }
+
+    if (config_.cacheCapacity > 0)
+    {
+        cache_ = std::make_shared<VerifyCache>(config_.cacheCapacity);
+    }
+}
+
+void AuthMiddleware::before(HttpRequest& request)
+{
+    // 预检请求由 CORS 处理，不携带凭证
+    if (request.method() == HttpRequest::kOptions || isExcluded(request.path()))
+    {
+        return;
+    }
+
+    std::string authorization = request.getHeader("Authorization");
+    // 认证方案名称不区分大小写（RFC 7235）
+    static const char kBearer[] = "Bearer ";
+    static const size_t kBearerLen = sizeof(kBearer) - 1;
+    if (authorization.size() < kBearerLen || strncasecmp(authorization.c_str(), kBearer, kBearerLen) != 0)
+    {
+        reject("missing bearer token");
+    }
+    std::string token = authorization.substr(kBearerLen);
+
+    int64_t now = nowSeconds();
+    std::string key;
+    if (cache_)
+    {
+        key = sha256(token);
+        if (ClaimsPtr claims = cache_->get(key, now))
+        {
+            request.setAuthClaims(std::move(claims));
+            return;
+        }
+    }
+
+    std::string error;
+    ClaimsPtr claims = verify(token, &error);
+    if (!claims)
+    {
+        LOG_DEBUG << "JWT rejected: " << error;
+        reject(error);
+    }
+
+    if (cache_)
+    {
+        // 缓存条目不超过 token 自身的有效期
+        int64_t expiresAt = now + config_.cacheTtlSecs;
+        int64_t exp = 0;
+        if (claims->contains("exp") && numericDate((*claims)["exp"], &exp))
+        {
+            expiresAt = std::min(expiresAt, exp + config_.leewaySecs);
+        }
+        cache_->put(key, claims, expiresAt);
+    }
+    request.setAuthClaims(std::move(claims));
+}
+
+AuthMiddleware::ClaimsPtr AuthMiddleware::verify(const std::string& token, std::string* error) const
+{
+    size_t dot1 = token.find('.');
+    size_t dot2 = dot1 == std::string::npos ? std::string::npos : token.find('.', dot1 + 1);
+    if (dot2 == std::string::npos || token.find('.', dot2 + 1) != std::string::npos)
+    {
+        *error = "malformed token";
+        return nullptr;
+    }
+
+    const char* data = token.data();
+    std::string headerJson, payloadJson, signature;
+    if (!base64UrlDecode(data, data + dot1, &headerJson) ||
+        !base64UrlDecode(data + dot1 + 1, data + dot2, &payloadJson) ||
+        !base64UrlDecode(data + dot2 + 1, data + token.size(), &signature))
+    {
+        *error = "invalid base64url encoding";
+        return nullptr;
+    }
+
+    try
+    {
+        // 只接受配置的算法，防止 alg=none 或 HS/ES 混淆攻击
+        json header = json::parse(headerJson);
+        const char* expectedAlg = config_.algorithm == AuthConfig::kES256 ? "ES256" : "HS256";
+        if (!header.is_object() || header.value("alg", "") != expectedAlg)
+        {
+            *error = "unexpected algorithm";
+            return nullptr;
+        }
+
+        if (!verifySignature(token.substr(0, dot2), signature))
+        {
+            *error = "invalid signature";
+            return nullptr;
+        }
+
+        auto claims = std::make_shared<json>(json::parse(payloadJson));
+        if (!claims->is_object())
+        {
+            *error = "invalid claims";
+            return nullptr;
+        }
+
+        int64_t now = nowSeconds();
+        int64_t date = 0;
+        if (claims->contains("exp") &&
+            (!numericDate((*claims)["exp"], &date) || date + config_.leewaySecs <= now))
+        {
+            *error = "token expired";
+            return nullptr;
+        }
+        if (claims->contains("nbf") &&
+            (!numericDate((*claims)["nbf"], &date) || date - config_.leewaySecs > now))
+        {
+            *error = "token not yet valid";
+            return nullptr;
+        }
+        if (!config_.issuer.empty() && claims->value("iss", "") != config_.issuer)
+        {
+            *error = "unexpected issuer";
+            return nullptr;
+        }
+        if (!config_.audience.empty())
+        {
+            // aud 可以是字符串或字符串数组
+            bool matched = false;
+            if (claims->contains("aud"))
+            {
+                const json& aud = (*claims)["aud"];
+                if (aud.is_string())
+                {
+                    matched = aud.get<std::string>() == config_.audience;
+                }
+                else if (aud.is_array())
+                {
+                    for (const auto& item : aud)
+                    {
+                        matched = matched || (item.is_string() && item.get<std::string>() == config_.audience);
+                    }
+                }
+            }
+            if (!matched)
+            {
+                *error = "unexpected audience";
+                return nullptr;
+            }
+        }
+        return claims;
+    }
+    catch (const std::exception& e)
+    {
+        // 解析器的错误信息含引号且暴露实现细节，只写日志，不放进响应头
+        LOG_DEBUG << "Invalid JWT json: " << e.what();
+        *error = "invalid token json";
+        return nullptr;
+    }
+}
+
+bool AuthMiddleware::verifySignature(const std::string& signingInput, const std::string& signature) const
+{
+    const unsigned char* input = reinterpret_cast<const unsigned char*>(signingInput.data());
+
+    if (config_.algorithm == AuthConfig::kHS256)
+    {
+        unsigned char mac[EVP_MAX_MD_SIZE];
+        unsigned int macLen = 0;
+        if (!HMAC(EVP_sha256(), config_.secret.data(), static_cast<int>(config_.secret.size()),
+                  input, signingInput.size(), mac, &macLen))
+        {
+            return false;
+        }
+        return signature.size() == macLen && CRYPTO_memcmp(mac, signature.data(), macLen) == 0;
+    }
+
+    // JWS 中 ES256 签名是定长的 R || S（各 32 字节），OpenSSL 需要 DER 编码
+    if (signature.size() != 64)
+    {
+        return false;
+    }
+    const unsigned char* raw = reinterpret_cast<const unsigned char*>(signature.data());
+    ECDSA_SIG* sig = ECDSA_SIG_new();
+    BIGNUM* r = BN_bin2bn(raw, 32, nullptr);
+    BIGNUM* s = BN_bin2bn(raw + 32, 32, nullptr);
+    if (!sig || !r || !s || !ECDSA_SIG_set0(sig, r, s))
+    {
+        BN_free(r);
+        BN_free(s);
+        ECDSA_SIG_free(sig);
+        return false;
+    }
+    unsigned char* der = nullptr;
+    int derLen = i2d_ECDSA_SIG(sig, &der);
+    ECDSA_SIG_free(sig);
+    if (derLen <= 0)
+    {
+        return false;
+    }
+
+    bool ok = false;
+    EVP_MD_CTX* ctx = EVP_MD_CTX_new();
+    if (ctx &&
+        EVP_DigestVerifyInit(ctx, nullptr, EVP_sha256(), nullptr, publicKey_.get()) == 1 &&
+        EVP_DigestVerify(ctx, der, derLen, input, signingInput.size()) == 1)
+    {
+        ok = true;
+    }
+    EVP_MD_CTX_free(ctx);
+    OPENSSL_free(der);
+    return ok;
+}
+
+bool AuthMiddleware::isExcluded(const std::string& path) const
+{
+    for (const auto& prefix : config_.excludedPaths)
+    {
+        if (path.compare(0, prefix.size(), prefix) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void AuthMiddleware::reject(const std::string& reason)
+{
+    HttpResponse response;
+    response.setStatusLine("HTTP/1.1", HttpResponse::k401Unauthorized, "Unauthorized");
+    response.addHeader("WWW-Authenticate", "Bearer error=\"invalid_token\", error_description=\"" + reason + "\"");
+    response.setContentLength(0);
+    throw response;
+}
+
+} // namespace middleware
+} // namespace http
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <openssl/evp.h>
+
+#include "AuthConfig.h"
+#include "Middleware.h"
+#include "../http/HttpRequest.h"
+#include "../http/HttpResponse.h"
+#include "../utils/JsonUtil.h"
+
+namespace http
+{
+namespace middleware
+{
+
+// Bearer token (JWT) 认证中间件
+// 验证通过后把 claims 挂到请求上，处理函数通过 HttpRequest::authClaims() 读取
+// 同一个 token 的验证结果按 SHA-256 摘要缓存，重复请求无需再做签名验证
+class AuthMiddleware : public Middleware
+{
+public:
+    // HS256 密钥的最小长度（与 SHA-256 摘要等长），更短的密钥构造时抛出异常
+    static const size_t kMinHs256SecretBytes = 32;
+
+    // 配置无效（HS256 密钥过短、ES256 公钥无法加载或不是 P-256）时抛出 std::runtime_error
+    explicit AuthMiddleware(const AuthConfig& config);
+
+    void before(HttpRequest& request) override;
+    void after(HttpResponse&) override {}
+
+private:
+    using ClaimsPtr = std::shared_ptr<const json>;
+
+    // 分片 LRU 缓存：token 摘要 -> 已验证的 claims
+    class VerifyCache
+    {
+    public:
+        explicit VerifyCache(size_t capacity);
+
+        ClaimsPtr get(const std::string& key, int64_t now);
+        void put(const std::string& key, ClaimsPtr claims, int64_t expiresAt);
+
+    private:
+        struct Entry
+        {
+            std::string key;
+            ClaimsPtr   claims;
+            int64_t     expiresAt; // 过期时间（unix 秒）
+        };
+
+        struct Shard
+        {
+            std::mutex                                                    mutex;
+            std::list<Entry>                                              lru; // 头部为最近使用
+            std::unordered_map<std::string, std::list<Entry>::iterator>   index;
+        };
+
+        static const size_t kShards = 16;
+
+        Shard& shardFor(const std::string& key);
+
+        size_t                   capacityPerShard_;
+        std::unique_ptr<Shard[]> shards_;
+    };
+
+    ClaimsPtr verify(const std::string& token, std::string* error) const;
+    bool verifySignature(const std::string& signingInput, const std::string& signature) const;
+    bool isExcluded(const std::string& path) const;
+    [[noreturn]] static void reject(const std::string& reason);
+
+private:
+    AuthConfig                   config_;
+    std::shared_ptr<EVP_PKEY>    publicKey_; // ES256 公钥
+    std::shared_ptr<VerifyCache> cache_; // 共享指针使中间件可按值放入 MiddlewarePipeline
+};
+
+} // namespace middleware
+} // namespace http
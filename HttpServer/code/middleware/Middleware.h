@@ -18,15 +18,6 @@ public:
     
     // 响应后处理
     virtual void after(HttpResponse& response) = 0;
-    
-    // 设置下一个中间件
-    void setNext(std::shared_ptr<Middleware> next) 
-    {
-        nextMiddleware_ = next;
-    }
-
-protected:
-    std::shared_ptr<Middleware> nextMiddleware_;
 };
 
 } // namespace middleware
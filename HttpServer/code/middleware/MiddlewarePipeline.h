@@ -0,0 +1,94 @@
+#pragma once
+
+#include <tuple>
+#include <utility>
+
+#include <muduo/base/Logging.h>
+
+#include "../http/HttpRequest.h"
+#include "../http/HttpResponse.h"
+
+namespace http
+{
+namespace middleware
+{
+
+// HttpServer 持有的流水线接口，整条流水线每个请求只有一次虚调用
+class PipelineBase
+{
+public:
+    virtual ~PipelineBase() = default;
+    virtual void processBefore(HttpRequest& request) = 0;
+    virtual void processAfter(HttpResponse& response) = 0;
+};
+
+// 编译期组合的中间件流水线
+// 中间件按值保存在 tuple 中，before 正序、after 逆序调用，与 MiddlewareChain 的顺序一致
+// 调用时使用限定名，即使中间件继承自 Middleware 也不会走虚函数，编译器可以内联整段调用序列
+// 中间件类型只需提供 before(HttpRequest&) 和 after(HttpResponse&)
+template <typename... Ms>
+class MiddlewarePipeline final : public PipelineBase
+{
+public:
+    MiddlewarePipeline() = default;
+
+    template <typename... Args>
+    explicit MiddlewarePipeline(Args&&... middlewares)
+        : middlewares_(std::forward<Args>(middlewares)...)
+    {}
+
+    void processBefore(HttpRequest& request) override
+    {
+        before(request, std::index_sequence_for<Ms...>{});
+    }
+
+    void processAfter(HttpResponse& response) override
+    {
+        try
+        {
+            after(response, std::index_sequence_for<Ms...>{});
+        }
+        catch (const std::exception& e)
+        {
+            LOG_ERROR << "Error in middleware after processing: " << e.what();
+        }
+    }
+
+    // 访问流水线中的某个中间件（如运行时调整配置）
+    template <typename M>
+    M& get() { return std::get<M>(middlewares_); }
+
+private:
+    template <size_t... I>
+    void before(HttpRequest& request, std::index_sequence<I...>)
+    {
+        (callBefore<I>(request), ...);
+    }
+
+    template <size_t... I>
+    void after(HttpResponse& response, std::index_sequence<I...>)
+    {
+        // 逆序：下标 sizeof...(Ms) - 1 - I
+        (callAfter<sizeof...(Ms) - 1 - I>(response), ...);
+    }
+
+    template <size_t I>
+    void callBefore(HttpRequest& request)
+    {
+        using M = std::tuple_element_t<I, std::tuple<Ms...>>;
+        std::get<I>(middlewares_).M::before(request);
+    }
+
+    template <size_t I>
+    void callAfter(HttpResponse& response)
+    {
+        using M = std::tuple_element_t<I, std::tuple<Ms...>>;
+        std::get<I>(middlewares_).M::after(response);
+    }
+
+private:
+    std::tuple<Ms...> middlewares_;
+};
+
+} // namespace middleware
+} // namespace http
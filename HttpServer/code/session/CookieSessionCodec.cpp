@@ -0,0 +1,300 @@
+#include "CookieSessionCodec.h"
+#include "../utils/Base64Url.h"
+
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
+
+namespace http
+{
+namespace session
+{
+
+namespace
+{
+
+// 数据格式（整数按小端序逐字节写入）：
+//   i64 过期秒 | i32 maxAge | u8 ID 长度 | ID | u16 键值对数 | (u16 长度, 键, u16 长度, 值)...
+const uint8_t kFlagEncrypted = 0x01;
+const size_t  kMacSize = 32;
+const size_t  kIvSize = 16;
+
+template <typename T>
+void put(std::string& out, T value)
+{
+    for (size_t i = 0; i < sizeof(T); ++i)
+    {
+        out.push_back(static_cast<char>((static_cast<uint64_t>(value) >> (8 * i)) & 0xFF));
+    }
+}
+
+template <typename T>
+bool get(const std::string& in, size_t* pos, T* value)
+{
+    if (in.size() - *pos < sizeof(T))
+    {
+        return false;
+    }
+    uint64_t v = 0;
+    for (size_t i = 0; i < sizeof(T); ++i)
+    {
+        v |= static_cast<uint64_t>(static_cast<unsigned char>(in[*pos + i])) << (8 * i);
+    }
+    *value = static_cast<T>(v);
+    *pos += sizeof(T);
+    return true;
+}
+
+bool getBytes(const std::string& in, size_t* pos, size_t len, std::string* value)
+{
+    if (in.size() - *pos < len)
+    {
+        return false;
+    }
+    value->assign(in, *pos, len);
+    *pos += len;
+    return true;
+}
+
+std::string hmacSha256(const std::string& key, const char* data, size_t len)
+{
+    unsigned char mac[EVP_MAX_MD_SIZE];
+    unsigned int macLen = 0;
+    HMAC(EVP_sha256(), key.data(), static_cast<int>(key.size()),
+         reinterpret_cast<const unsigned char*>(data), len, mac, &macLen);
+    return std::string(reinterpret_cast<char*>(mac), macLen);
+}
+
+// AES-256-CTR，加密和解密是同一操作
+bool aesCtr(const std::string& key, const char* iv, const std::string& in, std::string* out)
+{
+    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+    if (!ctx)
+    {
+        return false;
+    }
+    out->resize(in.size());
+    int len = 0;
+    bool ok = EVP_EncryptInit_ex(ctx, EVP_aes_256_ctr(), nullptr,
+                                 reinterpret_cast<const unsigned char*>(key.data()),
+                                 reinterpret_cast<const unsigned char*>(iv)) == 1 &&
+              EVP_EncryptUpdate(ctx, reinterpret_cast<unsigned char*>(&(*out)[0]), &len,
+                                reinterpret_cast<const unsigned char*>(in.data()),
+                                static_cast<int>(in.size())) == 1;
+    EVP_CIPHER_CTX_free(ctx);
+    return ok;
+}
+
+bool validKeyId(const std::string& id)
+{
+    if (id.empty())
+    {
+        return false;
+    }
+    for (char c : id)
+    {
+        if (!isalnum(static_cast<unsigned char>(c)) && c != '-' && c != '_')
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+// 由主密钥派生的签名密钥和加密密钥，互不复用
+struct CookieSessionCodec::DerivedKey
+{
+    std::string id;
+    std::string macKey;
+    std::string encKey;
+};
+
+CookieSessionCodec::CookieSessionCodec(const CookieSessionConfig& config)
+    : config_(config)
+{
+    if (config_.keys.empty())
+    {
+        throw std::invalid_argument("CookieSessionCodec requires at least one key");
+    }
+    for (const auto& key : config_.keys)
+    {
+        if (!validKeyId(key.id) || key.secret.size() < 32)
+        {
+            throw std::invalid_argument("Invalid cookie session key: " + key.id);
+        }
+        auto derived = std::make_unique<DerivedKey>();
+        derived->id = key.id;
+        derived->macKey = hmacSha256(key.secret, "cookie-session-mac", 18);
+        derived->encKey = hmacSha256(key.secret, "cookie-session-enc", 18);
+        keys_.push_back(std::move(derived));
+    }
+}
+
+CookieSessionCodec::~CookieSessionCodec() = default;
+
+std::string CookieSessionCodec::encode(const Session& session) const
+{
+    std::string data;
+    put<int64_t>(data, std::chrono::duration_cast<std::chrono::seconds>(
+        session.getExpiryTime().time_since_epoch()).count());
+    put<int32_t>(data, session.getMaxAge());
+    put<uint8_t>(data, static_cast<uint8_t>(session.getId().size()));
+    data.append(session.getId());
+    put<uint16_t>(data, static_cast<uint16_t>(session.getData().size()));
+    for (const auto& kv : session.getData())
+    {
+        if (kv.name().size() > 0xFFFF || kv.value.size() > 0xFFFF)
+        {
+            return std::string();
+        }
+        put<uint16_t>(data, static_cast<uint16_t>(kv.name().size()));
+        data.append(kv.name());
+        put<uint16_t>(data, static_cast<uint16_t>(kv.value.size()));
+        data.append(kv.value);
+    }
+
+    const DerivedKey& key = *keys_.front();
+    std::string body;
+    if (config_.encrypt)
+    {
+        char iv[kIvSize];
+        if (RAND_bytes(reinterpret_cast<unsigned char*>(iv), sizeof(iv)) != 1)
+        {
+            return std::string();
+        }
+        std::string cipher;
+        if (!aesCtr(key.encKey, iv, data, &cipher))
+        {
+            return std::string();
+        }
+        body.push_back(static_cast<char>(kFlagEncrypted));
+        body.append(iv, sizeof(iv));
+        body.append(cipher);
+    }
+    else
+    {
+        body.push_back(0);
+        body.append(data);
+    }
+
+    // 签名覆盖密钥标识和 base64 后的数据，与解码时校验的字节完全一致
+    std::string value = key.id + "." + base64UrlEncode(body);
+    value += "." + base64UrlEncode(hmacSha256(key.macKey, value.data(), value.size()));
+    if (value.size() + config_.cookieName.size() + 1 > config_.maxCookieBytes)
+    {
+        return std::string();
+    }
+    return value;
+}
+
+std::shared_ptr<Session> CookieSessionCodec::decode(const std::string& value, SessionManager* manager) const
+{
+    size_t dot1 = value.find('.');
+    size_t dot2 = value.rfind('.');
+    if (dot1 == std::string::npos || dot1 == dot2)
+    {
+        return nullptr;
+    }
+
+    const DerivedKey* key = findKey(value.substr(0, dot1));
+    if (!key)
+    {
+        return nullptr; // 密钥已下线
+    }
+
+    std::string mac;
+    if (!base64UrlDecode(value.data() + dot2 + 1, value.data() + value.size(), &mac) ||
+        mac.size() != kMacSize)
+    {
+        return nullptr;
+    }
+    std::string expected = hmacSha256(key->macKey, value.data(), dot2);
+    if (CRYPTO_memcmp(expected.data(), mac.data(), kMacSize) != 0)
+    {
+        return nullptr;
+    }
+
+    std::string body;
+    if (!base64UrlDecode(value.data() + dot1 + 1, value.data() + dot2, &body) || body.empty())
+    {
+        return nullptr;
+    }
+
+    // 根据标志解密，切换 encrypt 配置不影响已签发的 cookie
+    std::string data;
+    if (static_cast<uint8_t>(body[0]) & kFlagEncrypted)
+    {
+        if (body.size() < 1 + kIvSize ||
+            !aesCtr(key->encKey, body.data() + 1, body.substr(1 + kIvSize), &data))
+        {
+            return nullptr;
+        }
+    }
+    else
+    {
+        data = body.substr(1);
+    }
+
+    size_t pos = 0;
+    int64_t expiresAt = 0;
+    int32_t maxAge = 0;
+    uint8_t idLen = 0;
+    uint16_t count = 0;
+    std::string id;
+    if (!get(data, &pos, &expiresAt) || !get(data, &pos, &maxAge) ||
+        !get(data, &pos, &idLen) || !getBytes(data, &pos, idLen, &id) ||
+        !get(data, &pos, &count))
+    {
+        return nullptr;
+    }
+
+    SessionData values;
+    values.reserve(count);
+    for (uint16_t i = 0; i < count; ++i)
+    {
+        uint16_t klen = 0, vlen = 0;
+        std::string k, v;
+        if (!get(data, &pos, &klen) || !getBytes(data, &pos, klen, &k) ||
+            !get(data, &pos, &vlen) || !getBytes(data, &pos, vlen, &v))
+        {
+            return nullptr;
+        }
+        values.set(k, v);
+    }
+
+    auto session = std::make_shared<Session>(id, manager, maxAge);
+    session->restore(std::move(values),
+                     std::chrono::system_clock::time_point(std::chrono::seconds(expiresAt)));
+    if (session->isExpired())
+    {
+        return nullptr;
+    }
+    if (key != keys_.front().get())
+    {
+        session->markDirty(); // 密钥轮换：用当前密钥重新签发
+    }
+    return session;
+}
+
+const CookieSessionCodec::DerivedKey* CookieSessionCodec::findKey(const std::string& id) const
+{
+    for (const auto& key : keys_)
+    {
+        if (key->id == id)
+        {
+            return key.get();
+        }
+    }
+    return nullptr;
+}
+
+} // namespace session
+} // namespace http
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Session.h"
+
+namespace http
+{
+namespace session
+{
+
+struct CookieSessionKey
+{
+    std::string id; // 密钥标识，写入 cookie，只能包含字母、数字、'-'、'_'
+    std::string secret; // 主密钥，签名密钥和加密密钥都由它派生
+};
+
+struct CookieSessionConfig
+{
+    std::vector<CookieSessionKey> keys; // 第一个用于签发，其余只用于验证，轮换时把新密钥放到最前面
+    bool                          encrypt = false; // 是否加密会话数据（AES-256-CTR，先加密后签名）
+    std::string                   cookieName = "session";
+    std::string                   cookieAttributes = "Path=/; HttpOnly";
+    size_t                        maxCookieBytes = 4000; // 超过浏览器限制的会话无法写入 cookie
+};
+
+// 无状态会话的编解码：会话数据序列化后签名（可选加密）写入 cookie 本身，服务端不保存任何状态
+// cookie 格式：<密钥标识>.<base64url(标志 | [IV] | 数据)>.<base64url(HMAC-SHA256)>
+// 只适合数据量小的会话；会话无法在服务端主动失效，只能等待过期
+class CookieSessionCodec
+{
+public:
+    explicit CookieSessionCodec(const CookieSessionConfig& config);
+    ~CookieSessionCodec();
+
+    // 编码为 cookie 值，超过 maxCookieBytes 时返回空串
+    std::string encode(const Session& session) const;
+
+    // 验证并解码，签名错误、格式错误或已过期时返回 nullptr
+    // 用旧密钥签发的会话会被标记为脏，请求结束时用当前密钥重新签发
+    std::shared_ptr<Session> decode(const std::string& value, SessionManager* manager) const;
+
+    const CookieSessionConfig& config() const
+    { return config_; }
+
+private:
+    struct DerivedKey;
+
+    const DerivedKey* findKey(const std::string& id) const;
+
+private:
+    CookieSessionConfig                      config_;
+    std::vector<std::unique_ptr<DerivedKey>> keys_; // 与 config_.keys 一一对应
+};
+
+} // namespace session
+} // namespace http
@@ -0,0 +1,397 @@
+#include "MysqlSessionStorage.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include <muduo/base/Logging.h>
+
+#include "../utils/DbConnectionPool.h"
+#include "../utils/JsonUtil.h"
+
+namespace http
+{
+namespace session
+{
+
+namespace
+{
+
+int64_t nowSecond()
+{
+    return std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+int64_t toSecond(std::chrono::system_clock::time_point tp)
+{
+    return std::chrono::duration_cast<std::chrono::seconds>(tp.time_since_epoch()).count();
+}
+
+} // namespace
+
+MysqlSessionStorage::MysqlSessionStorage(const MysqlSessionStorageConfig& config)
+    : config_(config)
+    , shards_(new Shard[kShards])
+    , cleanCursor_(0)
+    , stopping_(false)
+{
+    createTable();
+    flushThread_ = std::thread(&MysqlSessionStorage::flushLoop, this);
+}
+
+MysqlSessionStorage::~MysqlSessionStorage()
+{
+    {
+        std::lock_guard<std::mutex> lock(threadMutex_);
+        stopping_ = true;
+    }
+    cv_.notify_one();
+    if (flushThread_.joinable())
+    {
+        flushThread_.join();
+    }
+
+    try
+    {
+        flush(); // 退出前写回剩余数据
+    }
+    catch (...)
+    {
+        // 析构函数中不抛出异常
+    }
+}
+
+void MysqlSessionStorage::save(std::shared_ptr<Session> session)
+{
+    // 在调用线程上序列化，后台线程只接触序列化后的数据
+    // save 在 IO 线程的请求处理中调用，序列化失败只记录日志，不影响响应
+    PendingWrite write;
+    try
+    {
+        write = PendingWrite{encode(*session), toSecond(session->getExpiryTime()), session->getMaxAge()};
+    }
+    catch (const std::exception& e)
+    {
+        LOG_ERROR << "Failed to serialize session " << session->getId() << ": " << e.what();
+        return;
+    }
+    int64_t now = nowSecond();
+
+    Shard& shard = shardFor(session->getId());
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.dirty[session->getId()] = std::move(write);
+    shard.deleted.erase(session->getId());
+    cachePut(shard, session, now);
+}
+
+std::shared_ptr<Session> MysqlSessionStorage::load(const std::string& sessionId)
+{
+    int64_t now = nowSecond();
+    Shard& shard = shardFor(sessionId);
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (shard.deleted.count(sessionId))
+        {
+            return nullptr;
+        }
+
+        auto dirtyIt = shard.dirty.find(sessionId);
+        auto it = shard.index.find(sessionId);
+        if (it != shard.index.end() &&
+            (now - it->second->loadedAt < config_.cacheTtlSecs || dirtyIt != shard.dirty.end()))
+        {
+            shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+            std::shared_ptr<Session> session = it->second->session;
+            return session->isExpired() ? nullptr : session;
+        }
+
+        // 缓存已淘汰但还未写回，直接用待写数据恢复
+        if (dirtyIt != shard.dirty.end())
+        {
+            std::shared_ptr<Session> session = decode(sessionId, dirtyIt->second);
+            cachePut(shard, session, now);
+            return session->isExpired() ? nullptr : session;
+        }
+    }
+
+    // 数据库查询在锁外进行
+    std::shared_ptr<Session> session = loadFromDb(sessionId);
+    if (session)
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        // 查询期间可能已被本实例修改或删除，以本地为准
+        if (shard.deleted.count(sessionId))
+        {
+            return nullptr;
+        }
+        if (!shard.dirty.count(sessionId))
+        {
+            cachePut(shard, session, now);
+        }
+    }
+    return session;
+}
+
+void MysqlSessionStorage::remove(const std::string& sessionId)
+{
+    Shard& shard = shardFor(sessionId);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.index.find(sessionId);
+    if (it != shard.index.end())
+    {
+        shard.lru.erase(it->second);
+        shard.index.erase(it);
+    }
+    shard.dirty.erase(sessionId);
+    shard.deleted.insert(sessionId);
+}
+
+// 只清理本地缓存中过期或超过缓存有效期的条目，数据库中的过期行由后台线程批量删除
+size_t MysqlSessionStorage::cleanExpired(size_t maxCount)
+{
+    int64_t now = nowSecond();
+    size_t perShard = std::max<size_t>(1, maxCount / kShards);
+    size_t removed = 0;
+    for (size_t i = 0; i < kShards; ++i)
+    {
+        Shard& shard = shards_[(cleanCursor_ + i) % kShards];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        // 从最久未使用的一端开始检查
+        size_t checked = 0;
+        auto it = shard.lru.end();
+        while (it != shard.lru.begin() && checked < perShard)
+        {
+            --it;
+            ++checked;
+            bool stale = now - it->loadedAt >= config_.cacheTtlSecs && !shard.dirty.count(it->id);
+            if (stale || it->session->isExpired())
+            {
+                shard.index.erase(it->id);
+                it = shard.lru.erase(it);
+                ++removed;
+            }
+        }
+    }
+    cleanCursor_ = (cleanCursor_ + 1) % kShards;
+    return removed;
+}
+
+void MysqlSessionStorage::flush()
+{
+    std::lock_guard<std::mutex> flushLock(flushMutex_);
+    for (size_t i = 0; i < kShards; ++i)
+    {
+        Shard& shard = shards_[i];
+        std::unordered_map<std::string, PendingWrite> rows;
+        std::unordered_set<std::string> deleted;
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            rows.swap(shard.dirty);
+            deleted.swap(shard.deleted);
+        }
+
+        try
+        {
+            writeBack(rows);
+            deleteRows(std::vector<std::string>(deleted.begin(), deleted.end()));
+        }
+        catch (const std::exception& e)
+        {
+            LOG_ERROR << "Failed to write back sessions: " << e.what();
+            // 放回待写集合，已有更新版本的不覆盖
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            for (auto& row : rows)
+            {
+                if (!shard.deleted.count(row.first))
+                {
+                    shard.dirty.emplace(row.first, std::move(row.second));
+                }
+            }
+            for (const auto& id : deleted)
+            {
+                if (!shard.dirty.count(id))
+                {
+                    shard.deleted.insert(id);
+                }
+            }
+        }
+    }
+}
+
+void MysqlSessionStorage::cachePut(Shard& shard, const std::shared_ptr<Session>& session, int64_t now)
+{
+    auto it = shard.index.find(session->getId());
+    if (it != shard.index.end())
+    {
+        it->second->session = session;
+        it->second->loadedAt = now;
+        shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+        return;
+    }
+
+    shard.lru.push_front(CacheEntry{session->getId(), session, now});
+    shard.index[session->getId()] = shard.lru.begin();
+    size_t capacity = std::max<size_t>(1, config_.cacheCapacity / kShards);
+    if (shard.lru.size() > capacity)
+    {
+        // 待写数据保存在 dirty 中，淘汰缓存不会丢失修改
+        shard.index.erase(shard.lru.back().id);
+        shard.lru.pop_back();
+    }
+}
+
+std::shared_ptr<Session> MysqlSessionStorage::loadFromDb(const std::string& sessionId)
+{
+    auto conn = http::db::DbConnectionPool::getInstance().getConnection();
+    std::unique_ptr<sql::ResultSet> rs(conn->executeQuery(
+        "SELECT data, max_age, expires_at FROM " + config_.table + " WHERE id = ? AND expires_at > ?",
+        sessionId, nowSecond()));
+    if (!rs || !rs->next())
+    {
+        return nullptr;
+    }
+    PendingWrite row{rs->getString("data"), rs->getInt64("expires_at"), rs->getInt("max_age")};
+    return decode(sessionId, row);
+}
+
+std::shared_ptr<Session> MysqlSessionStorage::decode(const std::string& sessionId, const PendingWrite& row)
+{
+    SessionData data;
+    json j = json::parse(row.payload);
+    for (auto it = j.begin(); it != j.end(); ++it)
+    {
+        data.set(it.key(), it.value().get<std::string>());
+    }
+
+    auto session = std::make_shared<Session>(sessionId, nullptr, row.maxAge);
+    session->restore(std::move(data),
+                     std::chrono::system_clock::time_point(std::chrono::seconds(row.expiresAt)));
+    return session;
+}
+
+std::string MysqlSessionStorage::encode(const Session& session)
+{
+    json j = json::object();
+    for (const auto& kv : session.getData())
+    {
+        j[kv.name()] = kv.value;
+    }
+    // 会话值可能不是合法的 UTF-8，默认的 dump 会抛出 type_error，这里把非法字节替换为 U+FFFD
+    return j.dump(-1, ' ', false, json::error_handler_t::replace);
+}
+
+void MysqlSessionStorage::createTable()
+{
+    auto conn = http::db::DbConnectionPool::getInstance().getConnection();
+    conn->executeUpdate(
+        "CREATE TABLE IF NOT EXISTS " + config_.table + " ("
+        "id VARCHAR(64) NOT NULL PRIMARY KEY, "
+        "data MEDIUMTEXT NOT NULL, "
+        "max_age INT NOT NULL, "
+        "expires_at BIGINT NOT NULL, "
+        "INDEX idx_expires_at (expires_at))");
+}
+
+// 按 batchSize 拆分为多条多行 upsert
+void MysqlSessionStorage::writeBack(std::unordered_map<std::string, PendingWrite>& rows)
+{
+    if (rows.empty())
+    {
+        return;
+    }
+
+    auto conn = http::db::DbConnectionPool::getInstance().getConnection();
+    auto it = rows.begin();
+    while (it != rows.end())
+    {
+        std::string sql = "INSERT INTO " + config_.table + " (id, data, max_age, expires_at) VALUES ";
+        std::vector<std::string> params;
+        size_t count = 0;
+        for (; it != rows.end() && count < config_.batchSize; ++it, ++count)
+        {
+            sql += count == 0 ? "(?, ?, ?, ?)" : ", (?, ?, ?, ?)";
+            params.push_back(it->first);
+            params.push_back(it->second.payload);
+            params.push_back(std::to_string(it->second.maxAge));
+            params.push_back(std::to_string(it->second.expiresAt));
+        }
+        sql += " ON DUPLICATE KEY UPDATE data = VALUES(data), max_age = VALUES(max_age), "
+               "expires_at = VALUES(expires_at)";
+        conn->executeBatchUpdate(sql, params);
+    }
+    LOG_DEBUG << "Wrote back " << rows.size() << " sessions";
+}
+
+void MysqlSessionStorage::deleteRows(const std::vector<std::string>& ids)
+{
+    if (ids.empty())
+    {
+        return;
+    }
+
+    auto conn = http::db::DbConnectionPool::getInstance().getConnection();
+    for (size_t begin = 0; begin < ids.size(); begin += config_.batchSize)
+    {
+        size_t end = std::min(ids.size(), begin + config_.batchSize);
+        std::string sql = "DELETE FROM " + config_.table + " WHERE id IN (";
+        for (size_t i = begin; i < end; ++i)
+        {
+            sql += i == begin ? "?" : ", ?";
+        }
+        sql += ")";
+        conn->executeBatchUpdate(sql, std::vector<std::string>(ids.begin() + begin, ids.begin() + end));
+    }
+}
+
+// 分批删除过期行，每批有上限，避免长时间持有行锁
+void MysqlSessionStorage::purgeExpiredRows()
+{
+    auto conn = http::db::DbConnectionPool::getInstance().getConnection();
+    std::string sql = "DELETE FROM " + config_.table + " WHERE expires_at < ? LIMIT "
+                    + std::to_string(config_.purgeBatchSize);
+    size_t total = 0;
+    int affected = 0;
+    do
+    {
+        affected = conn->executeUpdate(sql, nowSecond());
+        total += affected;
+    } while (affected >= static_cast<int>(config_.purgeBatchSize));
+
+    if (total > 0)
+    {
+        LOG_INFO << "Purged " << total << " expired sessions from " << config_.table;
+    }
+}
+
+void MysqlSessionStorage::flushLoop()
+{
+    int64_t lastPurge = nowSecond();
+    std::unique_lock<std::mutex> lock(threadMutex_);
+    while (!stopping_)
+    {
+        cv_.wait_for(lock, std::chrono::milliseconds(config_.flushIntervalMs));
+        if (stopping_)
+        {
+            break;
+        }
+
+        lock.unlock();
+        try
+        {
+            flush();
+            if (nowSecond() - lastPurge >= config_.purgeIntervalSecs)
+            {
+                lastPurge = nowSecond();
+                purgeExpiredRows();
+            }
+        }
+        catch (const std::exception& e)
+        {
+            LOG_ERROR << "Error in session flush thread: " << e.what();
+        }
+        lock.lock();
+    }
+}
+
+} // namespace session
+} // namespace http
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <condition_variable>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "SessionStorage.h"
+
+namespace http
+{
+namespace session
+{
+
+struct MysqlSessionStorageConfig
+{
+    std::string table = "http_sessions"; // 会话表名，不存在时自动创建
+    size_t      cacheCapacity = 100000; // 本地读缓存容量
+    int         cacheTtlSecs = 5; // 缓存条目的有效期，超过后重新从数据库读取，使其它实例的写入可见
+    int         flushIntervalMs = 200; // 写回间隔
+    size_t      batchSize = 500; // 每条多行 INSERT / DELETE 语句包含的最大行数
+    int         purgeIntervalSecs = 60; // 批量删除过期行的间隔
+    size_t      purgeBatchSize = 5000; // 每次删除过期行的上限
+};
+
+// 基于 MySQL 的会话存储，多个实例可共享会话
+// 读：优先本地缓存（分片 LRU），未命中才查询数据库
+// 写：save 只在本地序列化并记入待写集合，后台线程按间隔用多行 upsert 批量写回
+// 删除过期行也由后台线程批量执行，不占用请求路径
+// 依赖 DbConnectionPool，需在其初始化之后创建
+class MysqlSessionStorage : public SessionStorage
+{
+public:
+    explicit MysqlSessionStorage(const MysqlSessionStorageConfig& config = MysqlSessionStorageConfig());
+    ~MysqlSessionStorage() override;
+
+    void save(std::shared_ptr<Session> session) override;
+    std::shared_ptr<Session> load(const std::string& sessionId) override;
+    void remove(const std::string& sessionId) override;
+    size_t cleanExpired(size_t maxCount) override;
+
+    // 立即写回所有待写数据（析构时也会调用）
+    void flush();
+
+private:
+    struct CacheEntry
+    {
+        std::string              id;
+        std::shared_ptr<Session> session;
+        int64_t                  loadedAt; // 放入缓存的时间（unix 秒）
+    };
+
+    // 待写回的会话，save 时已序列化，后台线程不再访问 Session 对象
+    struct PendingWrite
+    {
+        std::string payload;
+        int64_t     expiresAt; // unix 秒
+        int         maxAge;
+    };
+
+    struct Shard
+    {
+        std::mutex                                                 mutex;
+        std::list<CacheEntry>                                      lru; // 头部为最近使用
+        std::unordered_map<std::string, std::list<CacheEntry>::iterator> index;
+        std::unordered_map<std::string, PendingWrite>              dirty; // 待写回
+        std::unordered_set<std::string>                            deleted; // 待删除
+    };
+
+    static const size_t kShards = 16;
+
+    Shard& shardFor(const std::string& sessionId)
+    { return shards_[std::hash<std::string>{}(sessionId) % kShards]; }
+
+    void cachePut(Shard& shard, const std::shared_ptr<Session>& session, int64_t now);
+    std::shared_ptr<Session> loadFromDb(const std::string& sessionId);
+    std::shared_ptr<Session> decode(const std::string& sessionId, const PendingWrite& row);
+    static std::string encode(const Session& session);
+
+    void createTable();
+    void writeBack(std::unordered_map<std::string, PendingWrite>& rows);
+    void deleteRows(const std::vector<std::string>& ids);
+    void purgeExpiredRows();
+    void flushLoop();
+
+private:
+    MysqlSessionStorageConfig config_;
+    std::unique_ptr<Shard[]>  shards_;
+    size_t                    cleanCursor_; // 本地缓存清理的起始分片
+    std::mutex                flushMutex_; // 串行化写回，同一会话的新旧版本不会乱序
+    std::mutex                threadMutex_;
+    std::condition_variable   cv_;
+    bool                      stopping_;
+    std::thread               flushThread_;
+};
+
+} // namespace session
+} // namespace http
@@ -0,0 +1,749 @@
+#include "PersistentSessionStorage.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include <muduo/base/Logging.h>
+
+namespace http
+{
+namespace session
+{
+
+namespace
+{
+
+// 快照文件格式（主机字节序，仅供本机重启使用）：
+//   Header | 记录块 ... | 块索引（SnapshotChunk × chunkCount）
+// 记录格式与日志相同：u32 长度 | u32 CRC32 | 负载
+// 负载：u8 类型 | u16 ID 长度 | ID | [i64 过期秒 | i32 maxAge | u32 键值对数 | (u32 长度, 键, u32 长度, 值)...]
+const char     kSnapshotMagic[8] = {'H', 'S', 'S', 'N', 'A', 'P', '1', '\0'};
+const uint32_t kSnapshotVersion = 1;
+const size_t   kRecordsPerChunk = 65536;
+
+struct SnapshotHeader
+{
+    char     magic[8];
+    uint32_t version;
+    uint32_t chunkCount;
+    uint64_t recordCount;
+    uint64_t journalSeq; // 快照之后需要重放的第一个日志序号
+    uint64_t indexOffset;
+};
+
+struct SnapshotChunk
+{
+    uint64_t offset;
+    uint64_t length;
+    uint64_t count;
+};
+
+uint32_t crc32(const char* data, size_t len)
+{
+    static const auto table = [] {
+        std::vector<uint32_t> t(256);
+        for (uint32_t i = 0; i < 256; ++i)
+        {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k)
+            {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            t[i] = c;
+        }
+        return t;
+    }();
+
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < len; ++i)
+    {
+        crc = table[(crc ^ static_cast<unsigned char>(data[i])) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+template <typename T>
+void put(std::string& out, T value)
+{
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void putBytes(std::string& out, const std::string& bytes)
+{
+    put<uint32_t>(out, static_cast<uint32_t>(bytes.size()));
+    out.append(bytes);
+}
+
+// 带边界检查的读取器，数据残缺时 ok() 变为 false
+class Reader
+{
+public:
+    Reader(const char* data, size_t len) : p_(data), end_(data + len) {}
+
+    template <typename T>
+    T get()
+    {
+        T value{};
+        if (static_cast<size_t>(end_ - p_) < sizeof(T))
+        {
+            ok_ = false;
+            return value;
+        }
+        memcpy(&value, p_, sizeof(T));
+        p_ += sizeof(T);
+        return value;
+    }
+
+    std::string getBytes(size_t len)
+    {
+        if (static_cast<size_t>(end_ - p_) < len)
+        {
+            ok_ = false;
+            return std::string();
+        }
+        std::string value(p_, len);
+        p_ += len;
+        return value;
+    }
+
+    bool ok() const { return ok_; }
+
+private:
+    const char* p_;
+    const char* end_;
+    bool        ok_ = true;
+};
+
+// 加上长度和校验和，组成完整记录
+std::string frame(const std::string& payload)
+{
+    std::string record;
+    record.reserve(payload.size() + 8);
+    put<uint32_t>(record, static_cast<uint32_t>(payload.size()));
+    put<uint32_t>(record, crc32(payload.data(), payload.size()));
+    record.append(payload);
+    return record;
+}
+
+std::string encodeSave(const Session& session)
+{
+    std::string payload;
+    put<uint8_t>(payload, 1);
+    put<uint16_t>(payload, static_cast<uint16_t>(session.getId().size()));
+    payload.append(session.getId());
+    put<int64_t>(payload, std::chrono::duration_cast<std::chrono::seconds>(
+        session.getExpiryTime().time_since_epoch()).count());
+    put<int32_t>(payload, session.getMaxAge());
+    put<uint32_t>(payload, static_cast<uint32_t>(session.getData().size()));
+    for (const auto& kv : session.getData())
+    {
+        putBytes(payload, kv.name());
+        putBytes(payload, kv.value);
+    }
+    return payload;
+}
+
+std::string encodeRemove(const std::string& sessionId)
+{
+    std::string payload;
+    put<uint8_t>(payload, 2);
+    put<uint16_t>(payload, static_cast<uint16_t>(sessionId.size()));
+    payload.append(sessionId);
+    return payload;
+}
+
+bool writeAll(int fd, const char* data, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = ::write(fd, data, len);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return false;
+        }
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+void fsyncDirectory(const std::string& dir)
+{
+    int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd >= 0)
+    {
+        ::fsync(fd);
+        ::close(fd);
+    }
+}
+
+int64_t nowSecond()
+{
+    return std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+} // namespace
+
+PersistentSessionStorage::PersistentSessionStorage(const PersistentSessionStorageConfig& config)
+    : config_(config)
+    , memory_(std::make_unique<MemorySessionStorage>(config.shardCount, config.maxSessions))
+    , records_(new RecordShard[kRecordShards])
+    , generation_(0)
+    , journalFd_(-1)
+    , journalSeq_(0)
+    , journalBytes_(0)
+    , stopping_(false)
+{
+    if (::mkdir(config_.directory.c_str(), 0700) != 0 && errno != EEXIST)
+    {
+        throw std::runtime_error("Failed to create session directory: " + config_.directory);
+    }
+    recover();
+    backgroundThread_ = std::thread(&PersistentSessionStorage::backgroundLoop, this);
+}
+
+PersistentSessionStorage::~PersistentSessionStorage()
+{
+    {
+        std::lock_guard<std::mutex> lock(threadMutex_);
+        stopping_ = true;
+    }
+    cv_.notify_one();
+    if (backgroundThread_.joinable())
+    {
+        backgroundThread_.join();
+    }
+
+    std::lock_guard<std::mutex> lock(fileMutex_);
+    flushJournal();
+    if (journalFd_ >= 0)
+    {
+        ::close(journalFd_);
+    }
+}
+
+void PersistentSessionStorage::save(std::shared_ptr<Session> session)
+{
+    // 在当前 IO 线程上序列化，之后快照只使用这份记录
+    std::string record = frame(encodeSave(*session));
+    std::string id = session->getId();
+    // 同一会话的并发写入按同一顺序进入内存和日志，否则重放可能恢复旧数据或已删除的会话
+    std::lock_guard<std::mutex> lock(recordShardFor(id).writeMutex);
+    memory_->save(std::move(session));
+    rememberRecord(id, record);
+    appendRecord(record);
+}
+
+std::shared_ptr<Session> PersistentSessionStorage::load(const std::string& sessionId)
+{
+    return memory_->load(sessionId);
+}
+
+void PersistentSessionStorage::remove(const std::string& sessionId)
+{
+    std::string record = frame(encodeRemove(sessionId));
+    std::lock_guard<std::mutex> lock(recordShardFor(sessionId).writeMutex);
+    memory_->remove(sessionId);
+    forgetRecord(sessionId);
+    appendRecord(record);
+}
+
+// 过期会话不写日志，重放时按过期时间跳过即可
+size_t PersistentSessionStorage::cleanExpired(size_t maxCount)
+{
+    return memory_->cleanExpired(maxCount);
+}
+
+void PersistentSessionStorage::appendRecord(const std::string& record)
+{
+    std::lock_guard<std::mutex> lock(journalMutex_);
+    journalBuffer_.append(record);
+}
+
+void PersistentSessionStorage::rememberRecord(const std::string& sessionId, std::string record)
+{
+    RecordShard& shard = recordShardFor(sessionId);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    // 在锁内读取代数：快照开始后保存的记录不会被本轮快照当作过期记录清除
+    shard.records[sessionId] = SavedRecord{std::move(record), generation_.load()};
+}
+
+void PersistentSessionStorage::forgetRecord(const std::string& sessionId)
+{
+    RecordShard& shard = recordShardFor(sessionId);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.records.erase(sessionId);
+}
+
+void PersistentSessionStorage::flushJournal()
+{
+    // 只在交换缓冲区时持有 journalMutex_，写文件和 fdatasync 期间 IO 线程仍可追加记录
+    {
+        std::lock_guard<std::mutex> lock(journalMutex_);
+        if (unwritten_.empty())
+        {
+            unwritten_.swap(journalBuffer_);
+        }
+        else
+        {
+            unwritten_.append(journalBuffer_); // 上次写入失败的记录在前，顺序不变
+            journalBuffer_.clear();
+        }
+    }
+    if (unwritten_.empty() || journalFd_ < 0)
+    {
+        return;
+    }
+    if (!writeAll(journalFd_, unwritten_.data(), unwritten_.size()))
+    {
+        int savedErrno = errno;
+        LOG_ERROR << "Failed to write session journal: " << strerror(savedErrno);
+        // 部分写入（如 ENOSPC）会在文件中留下半条记录，重放到此即停止，之后追加的记录全部丢失；
+        // 截断回上次成功写入的位置再重试，截断失败则换一个新的日志文件
+        if (::ftruncate(journalFd_, static_cast<off_t>(journalBytes_)) != 0)
+        {
+            LOG_ERROR << "Failed to truncate session journal: " << strerror(errno);
+            try
+            {
+                openJournal(journalSeq_ + 1);
+            }
+            catch (const std::exception& e)
+            {
+                LOG_ERROR << e.what();
+            }
+        }
+        return; // 保留 unwritten_，下次重试
+    }
+    ::fdatasync(journalFd_);
+    journalBytes_ += unwritten_.size();
+    unwritten_.clear();
+}
+
+void PersistentSessionStorage::openJournal(uint64_t seq)
+{
+    std::string path = journalPath(seq);
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+    if (fd < 0)
+    {
+        throw std::runtime_error("Failed to open session journal: " + path);
+    }
+    fsyncDirectory(config_.directory);
+    if (journalFd_ >= 0)
+    {
+        ::close(journalFd_);
+    }
+    journalFd_ = fd;
+    journalSeq_ = seq;
+    journalBytes_ = 0;
+}
+
+// 生成快照：先切换到新日志，再写快照，成功后删除旧日志
+// 切换后的修改既可能出现在快照中也会出现在新日志中，重放是幂等的
+void PersistentSessionStorage::snapshot()
+{
+    std::lock_guard<std::mutex> snapshotLock(snapshotMutex_);
+
+    uint64_t seq;
+    {
+        std::lock_guard<std::mutex> lock(fileMutex_);
+        flushJournal();
+        openJournal(journalSeq_ + 1);
+        seq = journalSeq_;
+    }
+
+    std::string tmpPath = snapshotPath() + ".tmp";
+    int fd = ::open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0)
+    {
+        LOG_ERROR << "Failed to create session snapshot: " << strerror(errno);
+        return;
+    }
+
+    SnapshotHeader header{};
+    memcpy(header.magic, kSnapshotMagic, sizeof(kSnapshotMagic));
+    header.version = kSnapshotVersion;
+    header.journalSeq = seq;
+
+    std::vector<SnapshotChunk> chunks;
+    std::string chunk;
+    uint64_t offset = sizeof(header);
+    uint64_t chunkCount = 0;
+    bool ok = ::lseek(fd, sizeof(header), SEEK_SET) == static_cast<off_t>(sizeof(header));
+
+    auto finishChunk = [&] {
+        if (chunkCount == 0 || !ok)
+        {
+            return;
+        }
+        ok = writeAll(fd, chunk.data(), chunk.size());
+        chunks.push_back(SnapshotChunk{offset, chunk.size(), chunkCount});
+        offset += chunk.size();
+        header.recordCount += chunkCount;
+        chunk.clear();
+        chunkCount = 0;
+    };
+
+    // 只从 Session 读取不可变的 ID 和原子的过期时间，数据取自保存时序列化好的记录，
+    // 不与 IO 线程上对会话的修改竞争
+    uint64_t generation = ++generation_;
+    int64_t now = nowSecond();
+    memory_->forEach([&](const std::shared_ptr<Session>& session) {
+        if (std::chrono::duration_cast<std::chrono::seconds>(
+                session->getExpiryTime().time_since_epoch()).count() <= now)
+        {
+            return;
+        }
+        RecordShard& shard = recordShardFor(session->getId());
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            auto it = shard.records.find(session->getId());
+            if (it == shard.records.end())
+            {
+                return; // 正在保存，记录会出现在切换后的新日志中
+            }
+            it->second.generation = generation;
+            chunk.append(it->second.record);
+        }
+        if (++chunkCount >= kRecordsPerChunk)
+        {
+            finishChunk();
+        }
+    });
+    finishChunk();
+
+    // 本轮没有被标记的记录对应的会话已过期或被内存存储淘汰
+    for (size_t i = 0; i < kRecordShards; ++i)
+    {
+        std::lock_guard<std::mutex> lock(records_[i].mutex);
+        for (auto it = records_[i].records.begin(); it != records_[i].records.end();)
+        {
+            if (it->second.generation < generation)
+            {
+                it = records_[i].records.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+
+    header.chunkCount = static_cast<uint32_t>(chunks.size());
+    header.indexOffset = offset;
+    ok = ok && writeAll(fd, reinterpret_cast<const char*>(chunks.data()), chunks.size() * sizeof(SnapshotChunk));
+    ok = ok && ::pwrite(fd, &header, sizeof(header), 0) == static_cast<ssize_t>(sizeof(header));
+    ok = ok && ::fsync(fd) == 0;
+    ::close(fd);
+
+    // 先落盘再原子替换，任何时刻磁盘上都有一份完整的快照
+    if (!ok || ::rename(tmpPath.c_str(), snapshotPath().c_str()) != 0)
+    {
+        LOG_ERROR << "Failed to write session snapshot: " << strerror(errno);
+        ::unlink(tmpPath.c_str());
+        return;
+    }
+    fsyncDirectory(config_.directory);
+
+    // 快照已覆盖之前的所有日志
+    for (uint64_t old : listJournals())
+    {
+        if (old < seq)
+        {
+            ::unlink(journalPath(old).c_str());
+        }
+    }
+    LOG_INFO << "Session snapshot written: " << header.recordCount << " sessions";
+}
+
+void PersistentSessionStorage::recover()
+{
+    auto start = std::chrono::steady_clock::now();
+
+    uint64_t snapshotSeq = 0;
+    size_t loaded = loadSnapshot(snapshotPath(), &snapshotSeq);
+
+    size_t replayed = 0;
+    uint64_t maxSeq = snapshotSeq;
+    for (uint64_t seq : listJournals())
+    {
+        maxSeq = std::max(maxSeq, seq);
+        if (seq >= snapshotSeq)
+        {
+            replayed += replayJournal(journalPath(seq));
+        }
+    }
+
+    // 总是写入新的日志文件，不在可能残缺的旧日志尾部追加
+    std::lock_guard<std::mutex> lock(fileMutex_);
+    openJournal(maxSeq + 1);
+
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    LOG_INFO << "Session store recovered " << loaded << " sessions from snapshot and "
+             << replayed << " journal records in " << secs << "s";
+}
+
+size_t PersistentSessionStorage::loadSnapshot(const std::string& path, uint64_t* journalSeq)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return 0;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(SnapshotHeader))
+    {
+        ::close(fd);
+        return 0;
+    }
+
+    size_t size = st.st_size;
+    void* addr = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED)
+    {
+        LOG_ERROR << "Failed to mmap session snapshot: " << strerror(errno);
+        return 0;
+    }
+    const char* base = static_cast<const char*>(addr);
+
+    SnapshotHeader header;
+    memcpy(&header, base, sizeof(header));
+    if (memcmp(header.magic, kSnapshotMagic, sizeof(kSnapshotMagic)) != 0 ||
+        header.version != kSnapshotVersion ||
+        header.indexOffset + header.chunkCount * sizeof(SnapshotChunk) > size)
+    {
+        LOG_ERROR << "Invalid session snapshot: " << path;
+        ::munmap(addr, size);
+        return 0;
+    }
+    *journalSeq = header.journalSeq;
+
+    std::vector<SnapshotChunk> chunks(header.chunkCount);
+    memcpy(chunks.data(), base + header.indexOffset, chunks.size() * sizeof(SnapshotChunk));
+    ::madvise(addr, size, MADV_SEQUENTIAL);
+
+    // 各块相互独立，多线程并行解码；内存存储按分片加锁，可并发写入
+    size_t threadCount = config_.loadThreads > 0 ? config_.loadThreads
+                                                  : std::max(1u, std::thread::hardware_concurrency());
+    threadCount = std::min(threadCount, std::max<size_t>(1, chunks.size()));
+    std::atomic<size_t> nextChunk(0);
+    std::atomic<size_t> loaded(0);
+    auto worker = [&] {
+        size_t index;
+        while ((index = nextChunk.fetch_add(1)) < chunks.size())
+        {
+            const SnapshotChunk& chunk = chunks[index];
+            if (chunk.offset + chunk.length > header.indexOffset)
+            {
+                continue;
+            }
+            const char* p = base + chunk.offset;
+            const char* end = p + chunk.length;
+            while (p + 8 <= end)
+            {
+                uint32_t len, crc;
+                memcpy(&len, p, 4);
+                memcpy(&crc, p + 4, 4);
+                if (p + 8 + len > end || crc32(p + 8, len) != crc)
+                {
+                    break;
+                }
+                if (applyRecord(p + 8, len))
+                {
+                    loaded.fetch_add(1, std::memory_order_relaxed);
+                }
+                p += 8 + len;
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < threadCount; ++i)
+    {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+
+    ::munmap(addr, size);
+    return loaded.load();
+}
+
+size_t PersistentSessionStorage::replayJournal(const std::string& path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return 0;
+    }
+    std::string data;
+    char buf[65536];
+    ssize_t n;
+    while ((n = ::read(fd, buf, sizeof(buf))) > 0)
+    {
+        data.append(buf, n);
+    }
+    ::close(fd);
+
+    // 日志必须按顺序重放；遇到残缺或校验失败的记录即停止（崩溃时未写完的尾部）
+    size_t count = 0;
+    size_t pos = 0;
+    while (pos + 8 <= data.size())
+    {
+        uint32_t len, crc;
+        memcpy(&len, data.data() + pos, 4);
+        memcpy(&crc, data.data() + pos + 4, 4);
+        if (pos + 8 + len > data.size() || crc32(data.data() + pos + 8, len) != crc)
+        {
+            LOG_WARN << "Session journal truncated at offset " << pos << ": " << path;
+            break;
+        }
+        applyRecord(data.data() + pos + 8, len);
+        pos += 8 + len;
+        ++count;
+    }
+    return count;
+}
+
+bool PersistentSessionStorage::applyRecord(const char* data, size_t len)
+{
+    Reader reader(data, len);
+    uint8_t type = reader.get<uint8_t>();
+    uint16_t idLen = reader.get<uint16_t>();
+    std::string id = reader.getBytes(idLen);
+    if (!reader.ok())
+    {
+        return false;
+    }
+
+    if (type == kRemove)
+    {
+        memory_->remove(id);
+        forgetRecord(id);
+        return true;
+    }
+    if (type != kSave)
+    {
+        return false;
+    }
+
+    int64_t expiresAt = reader.get<int64_t>();
+    int32_t maxAge = reader.get<int32_t>();
+    uint32_t count = reader.get<uint32_t>();
+    SessionData values;
+    for (uint32_t i = 0; i < count && reader.ok(); ++i)
+    {
+        std::string key = reader.getBytes(reader.get<uint32_t>());
+        std::string value = reader.getBytes(reader.get<uint32_t>());
+        values.set(key, value);
+    }
+    if (!reader.ok())
+    {
+        return false;
+    }
+    if (expiresAt <= nowSecond())
+    {
+        // 已过期的会话不必恢复，同时删掉之前记录中可能恢复出的旧版本
+        memory_->remove(id);
+        forgetRecord(id);
+        return false;
+    }
+
+    auto session = std::make_shared<Session>(id, nullptr, maxAge);
+    session->restore(std::move(values),
+                     std::chrono::system_clock::time_point(std::chrono::seconds(expiresAt)));
+    memory_->save(std::move(session));
+    rememberRecord(id, frame(std::string(data, len)));
+    return true;
+}
+
+void PersistentSessionStorage::backgroundLoop()
+{
+    auto lastSnapshot = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> lock(threadMutex_);
+    while (!stopping_)
+    {
+        cv_.wait_for(lock, std::chrono::milliseconds(config_.flushIntervalMs));
+        if (stopping_)
+        {
+            break;
+        }
+        lock.unlock();
+
+        size_t journalBytes;
+        {
+            std::lock_guard<std::mutex> fileLock(fileMutex_);
+            flushJournal();
+            journalBytes = journalBytes_;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (journalBytes >= config_.journalMaxBytes ||
+            now - lastSnapshot >= std::chrono::seconds(config_.snapshotIntervalSecs))
+        {
+            lastSnapshot = now;
+            try
+            {
+                snapshot();
+            }
+            catch (const std::exception& e)
+            {
+                LOG_ERROR << "Session snapshot failed: " << e.what();
+            }
+        }
+        lock.lock();
+    }
+}
+
+// 目录中所有日志文件的序号，按从小到大排序
+std::vector<uint64_t> PersistentSessionStorage::listJournals() const
+{
+    std::vector<uint64_t> seqs;
+    if (DIR* dir = ::opendir(config_.directory.c_str()))
+    {
+        while (struct dirent* entry = ::readdir(dir))
+        {
+            unsigned long long seq = 0;
+            char tail = 0;
+            if (sscanf(entry->d_name, "journal.%llu.lo%c", &seq, &tail) == 2 && tail == 'g')
+            {
+                seqs.push_back(seq);
+            }
+        }
+        ::closedir(dir);
+    }
+    std::sort(seqs.begin(), seqs.end());
+    return seqs;
+}
+
+std::string PersistentSessionStorage::journalPath(uint64_t seq) const
+{
+    return config_.directory + "/journal." + std::to_string(seq) + ".log";
+}
+
+std::string PersistentSessionStorage::snapshotPath() const
+{
+    return config_.directory + "/sessions.snapshot";
+}
+
+} // namespace session
+} // namespace http
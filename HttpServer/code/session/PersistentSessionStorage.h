@@ -0,0 +1,118 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "SessionStorage.h"
+
+namespace http
+{
+namespace session
+{
+
+struct PersistentSessionStorageConfig
+{
+    std::string directory; // 日志和快照所在目录，不存在时自动创建
+    int         flushIntervalMs = 100; // 日志写盘（fdatasync）间隔，崩溃最多丢失这段时间内的修改
+    int         snapshotIntervalSecs = 600; // 生成快照的间隔
+    size_t      journalMaxBytes = 256 << 20; // 日志超过该大小时提前生成快照
+    size_t      loadThreads = 0; // 启动时加载快照的线程数，0 表示按 CPU 核数
+    size_t      shardCount = 64; // 传给内存存储
+    size_t      maxSessions = 0; // 传给内存存储
+};
+
+// 可持久化的内存会话存储，进程重启后会话不丢失
+// 读写都在 MemorySessionStorage 上完成，修改同时追加到日志（journal），后台线程按间隔批量写盘；
+// 定期把全部会话写成紧凑的二进制快照，之后删除旧日志。
+// 快照按块组织并带块索引，启动时 mmap 后多线程并行解码，再按顺序重放快照之后的日志。
+// 每条记录带 CRC32，崩溃导致的日志尾部残缺记录在重放时丢弃。
+// Session 对象只在 IO 线程上修改，后台线程不读取其数据：save 时序列化好的记录按 ID 保留一份，
+// 快照直接写出这些记录（代价是每个会话多占一份序列化后的内存）。
+class PersistentSessionStorage : public SessionStorage
+{
+public:
+    explicit PersistentSessionStorage(const PersistentSessionStorageConfig& config);
+    ~PersistentSessionStorage() override;
+
+    void save(std::shared_ptr<Session> session) override;
+    std::shared_ptr<Session> load(const std::string& sessionId) override;
+    void remove(const std::string& sessionId) override;
+    size_t cleanExpired(size_t maxCount) override;
+
+    // 立即生成快照并截断日志
+    void snapshot();
+
+private:
+    enum RecordType : uint8_t
+    {
+        kSave = 1,
+        kRemove = 2,
+    };
+
+    void recover();
+    size_t loadSnapshot(const std::string& path, uint64_t* journalSeq);
+    size_t replayJournal(const std::string& path);
+    bool applyRecord(const char* data, size_t len);
+
+    void openJournal(uint64_t seq);
+    void flushJournal(); // 调用方持有 fileMutex_
+    void appendRecord(const std::string& record);
+
+    // 保存/删除会话最新的序列化记录，供快照使用
+    void rememberRecord(const std::string& sessionId, std::string record);
+    void forgetRecord(const std::string& sessionId);
+    void backgroundLoop();
+
+    std::vector<uint64_t> listJournals() const;
+    std::string journalPath(uint64_t seq) const;
+    std::string snapshotPath() const;
+
+    // 会话最新的完整记录（含长度和校验和），generation 为最近一次被快照写出（或保存）时的快照代数
+    struct SavedRecord
+    {
+        std::string record;
+        uint64_t    generation;
+    };
+
+    struct RecordShard
+    {
+        std::mutex                                   mutex; // 保护 records
+        std::unordered_map<std::string, SavedRecord> records;
+        std::mutex                                   writeMutex; // 串行化本分片上的 save/remove，内存、记录和日志的顺序一致
+    };
+
+    static const size_t kRecordShards = 64;
+
+    RecordShard& recordShardFor(const std::string& sessionId)
+    { return records_[std::hash<std::string>{}(sessionId) % kRecordShards]; }
+
+private:
+    PersistentSessionStorageConfig        config_;
+    std::unique_ptr<MemorySessionStorage> memory_;
+    std::unique_ptr<RecordShard[]>        records_;
+    std::atomic<uint64_t>                 generation_; // 快照代数，未被新快照标记的记录对应的会话已淘汰或过期
+
+    std::mutex                            journalMutex_; // 只保护 journalBuffer_，IO 线程追加记录时持有
+    std::string                           journalBuffer_; // IO 线程追加的记录
+    std::mutex                            fileMutex_; // 保护以下日志文件状态，写盘和切换日志时持有
+    std::string                           unwritten_; // 已从 journalBuffer_ 取出、尚未成功写入文件的记录
+    int                                   journalFd_;
+    uint64_t                              journalSeq_; // 当前日志文件的序号
+    size_t                                journalBytes_; // 当前日志文件的大小
+
+    std::mutex                            snapshotMutex_; // 串行化快照
+    std::mutex                            threadMutex_;
+    std::condition_variable               cv_;
+    bool                                  stopping_;
+    std::thread                           backgroundThread_;
+};
+
+} // namespace session
+} // namespace http
@@ -9,6 +9,7 @@ namespace session
 
 Session::Session(const std::string& sessionId, SessionManager* sessionManager, int maxAge)
     : sessionId_(sessionId)
+    , expiryMicros_(0)
     , maxAge_(maxAge)
     , sessionManager_(sessionManager)
 {
@@ -18,43 +19,74 @@ Session::Session(const std::string& sessionId, SessionManager* sessionManager, i
 // 检查会话是否已过期
 bool Session::isExpired() const
 {
-    return std::chrono::system_clock::now() > expiryTime_;
+    return std::chrono::system_clock::now() > getExpiryTime();
 }
 
 // 刷新会话的过期时间
 void Session::refresh()
 {
-    expiryTime_ = std::chrono::system_clock::now() + std::chrono::seconds(maxAge_);
+    expiryMicros_.store(toMicros(std::chrono::system_clock::now() + std::chrono::seconds(maxAge_)),
+                        std::memory_order_relaxed);
+    expiryDirty_.store(true, std::memory_order_relaxed);
+}
+
+// 过期时间只在距上次刷新超过阈值时延长，避免每个请求都写回存储
+bool Session::touch(int minIntervalSecs)
+{
+    auto now = std::chrono::system_clock::now();
+    auto lastRefresh = getExpiryTime() - std::chrono::seconds(maxAge_);
+    if (now - lastRefresh < std::chrono::seconds(minIntervalSecs))
+    {
+        return false;
+    }
+    refresh();
+    return true;
 }
 
 // 设置会话数据
 void Session::setValue(const std::string& key, const std::string& value)
 {
-    data_[key] = value;
-    // 如果设置了manager，自动保存更改
-    if (sessionManager_)
+    if (data_.set(key, value))
     {
-        sessionManager_->updateSession(shared_from_this());
+        markDirty(); // 值未变化时不产生写入
     }
 }
 
 // 获取会话数据
 std::string Session::getValue(const std::string& key) const
 {
-    auto it = data_.find(key);
-    return it != data_.end() ? it->second : std::string();
+    const std::string* value = data_.find(key);
+    return value ? *value : std::string();
 }
 
 // 删除会话数据
 void Session::remove(const std::string& key)
 {
-    data_.erase(key);
+    if (data_.erase(key))
+    {
+        markDirty();
+    }
 }
 
 // 清空会话数据
 void Session::clear()
 {
-    data_.clear();
+    if (!data_.empty())
+    {
+        data_.clear();
+        markDirty();
+    }
+}
+
+size_t Session::memoryUsage() const
+{
+    // make_shared 把控制块和对象分配在一起，控制块约两个指针
+    size_t bytes = sizeof(Session) + 2 * sizeof(void*);
+    if (sessionId_.capacity() > std::string().capacity())
+    {
+        bytes += sessionId_.capacity() + 1;
+    }
+    return bytes + data_.memoryUsage();
 }
 
 } // namespace session
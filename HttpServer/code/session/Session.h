@@ -1,10 +1,13 @@
 #pragma once
 
+#include <atomic>
+#include <cstdint>
 #include <memory>
 #include <string>
-#include <unordered_map>
 #include <chrono>
 
+#include "SessionData.h"
+
 namespace http
 {
 
@@ -23,6 +26,26 @@ public:
 
     bool isExpired() const;
     void refresh(); // 刷新过期时间
+    // 距上次刷新超过 minIntervalSecs 时才刷新过期时间，返回是否刷新
+    bool touch(int minIntervalSecs);
+
+    std::chrono::system_clock::time_point getExpiryTime() const
+    { return toTimePoint(expiryMicros_.load(std::memory_order_relaxed)); }
+
+    int getMaxAge() const 
+    { return maxAge_; }
+
+    // 从持久化存储恢复会话时使用，不标记为脏
+    void restore(SessionData data,
+                 std::chrono::system_clock::time_point expiryTime)
+    {
+        data_ = std::move(data);
+        expiryMicros_.store(toMicros(expiryTime), std::memory_order_relaxed);
+        markPersisted();
+    }
+
+    const SessionData& getData() const 
+    { return data_; }
 
     void setManager(SessionManager* sessionManager) 
     { sessionManager_ = sessionManager; }
@@ -30,17 +53,43 @@ public:
     SessionManager* getManager() const 
     { return sessionManager_; }
 
-    // 数据存取
+    // 数据存取，修改只标记为脏，由 SessionManager 在请求结束时统一保存
     void setValue(const std::string&key, const std::string&value);
     std::string getValue(const std::string&key) const;
     void remove(const std::string&key);
     void clear();
+
+    // 数据被修改或过期时间被延长后需要写回存储
+    bool needsPersist() const 
+    { return dirty_.load(std::memory_order_relaxed) || expiryDirty_.load(std::memory_order_relaxed); }
+    void markDirty() 
+    { dirty_.store(true, std::memory_order_relaxed); }
+    void markPersisted() 
+    {
+        dirty_.store(false, std::memory_order_relaxed);
+        expiryDirty_.store(false, std::memory_order_relaxed);
+    }
+
+    // 会话占用的内存（对象本身、控制块和堆上的数据），供存储统计使用
+    size_t memoryUsage() const;
+private:
+    static int64_t toMicros(std::chrono::system_clock::time_point t)
+    { return std::chrono::duration_cast<std::chrono::microseconds>(t.time_since_epoch()).count(); }
+    static std::chrono::system_clock::time_point toTimePoint(int64_t micros)
+    {
+        return std::chrono::system_clock::time_point(
+            std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::microseconds(micros)));
+    }
+
 private:
     std::string                                  sessionId_;
-    std::unordered_map<std::string, std::string> data_;
-    std::chrono::system_clock::time_point        expiryTime_;
+    SessionData                                  data_;
+    // 过期时间（unix 微秒）与脏标记会被清理线程、后台持久化线程读取，同时被 IO 线程修改，使用原子变量
+    std::atomic<int64_t>                         expiryMicros_;
     int                                          maxAge_; // 过期时间（秒）
     SessionManager*                              sessionManager_;
+    std::atomic<bool>                            dirty_{false}; // 数据有未保存的修改
+    std::atomic<bool>                            expiryDirty_{false}; // 过期时间有未保存的延长
 };
 
 } // namespace session
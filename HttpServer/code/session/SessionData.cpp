@@ -0,0 +1,111 @@
+#include "SessionData.h"
+
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_set>
+
+namespace http
+{
+namespace session
+{
+
+namespace
+{
+
+// 驻留表，键的种类由业务代码决定，数量很少且不会释放
+struct KeyTable
+{
+    std::shared_mutex               mutex;
+    std::unordered_set<std::string> keys; // 节点式容器，元素地址在插入后不变
+};
+
+KeyTable& keyTable()
+{
+    static KeyTable table;
+    return table;
+}
+
+// 超出 SSO 缓冲区的字符串才会在堆上分配
+size_t stringHeapBytes(const std::string& s)
+{
+    return s.capacity() > std::string().capacity() ? s.capacity() + 1 : 0;
+}
+
+} // namespace
+
+const std::string* SessionData::find(const std::string& key) const
+{
+    // 直接比较内容，读路径不需要访问驻留表
+    for (const auto& field : fields_)
+    {
+        if (*field.key == key)
+        {
+            return &field.value;
+        }
+    }
+    return nullptr;
+}
+
+bool SessionData::set(const std::string& key, const std::string& value)
+{
+    for (auto& field : fields_)
+    {
+        if (*field.key == key)
+        {
+            if (field.value == value)
+            {
+                return false;
+            }
+            field.value = value;
+            return true;
+        }
+    }
+    fields_.push_back(Field{intern(key), value});
+    return true;
+}
+
+bool SessionData::erase(const std::string& key)
+{
+    for (auto it = fields_.begin(); it != fields_.end(); ++it)
+    {
+        if (*it->key == key)
+        {
+            // 顺序无关，与末尾交换后删除
+            if (it != fields_.end() - 1)
+            {
+                *it = std::move(fields_.back());
+            }
+            fields_.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t SessionData::memoryUsage() const
+{
+    size_t bytes = fields_.capacity() * sizeof(Field);
+    for (const auto& field : fields_)
+    {
+        bytes += stringHeapBytes(field.value);
+    }
+    return bytes;
+}
+
+const std::string* SessionData::intern(const std::string& key)
+{
+    KeyTable& table = keyTable();
+    {
+        std::shared_lock<std::shared_mutex> lock(table.mutex);
+        auto it = table.keys.find(key);
+        if (it != table.keys.end())
+        {
+            return &*it;
+        }
+    }
+    std::unique_lock<std::shared_mutex> lock(table.mutex);
+    return &*table.keys.insert(key).first;
+}
+
+} // namespace session
+} // namespace http
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace http
+{
+namespace session
+{
+
+// 会话数据的紧凑存储
+// 会话通常只有几个键，用连续数组线性查找比哈希表更省内存也更快（没有桶数组和节点分配）；
+// 键在进程内驻留，所有会话共享同一份键字符串，每个字段只额外占用一个指针
+class SessionData
+{
+public:
+    struct Field
+    {
+        const std::string* key; // 指向驻留的键，进程生命周期内有效
+        std::string        value;
+
+        const std::string& name() const
+        { return *key; }
+    };
+
+    using const_iterator = std::vector<Field>::const_iterator;
+
+    // 返回值的指针，不存在时返回 nullptr
+    const std::string* find(const std::string& key) const;
+    // 设置值，返回是否发生了变化
+    bool set(const std::string& key, const std::string& value);
+    // 删除键，返回是否存在
+    bool erase(const std::string& key);
+    void clear() 
+    { fields_.clear(); fields_.shrink_to_fit(); }
+
+    bool empty() const 
+    { return fields_.empty(); }
+    size_t size() const 
+    { return fields_.size(); }
+    const_iterator begin() const 
+    { return fields_.begin(); }
+    const_iterator end() const 
+    { return fields_.end(); }
+
+    void reserve(size_t n) 
+    { fields_.reserve(n); }
+
+    // 堆上实际占用的字节数（不含驻留的键，它们由所有会话共享）
+    size_t memoryUsage() const;
+
+    // 返回驻留的键，相同内容的键总是返回同一个指针
+    static const std::string* intern(const std::string& key);
+
+private:
+    std::vector<Field> fields_;
+};
+
+} // namespace session
+} // namespace http
@@ -0,0 +1,119 @@
+#include "SessionIdGenerator.h"
+
+#include <pthread.h>
+
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
+
+#include <openssl/rand.h>
+
+namespace http
+{
+namespace session
+{
+
+namespace
+{
+
+// fork 后在子进程中递增，使继承来的缓冲区全部失效
+std::atomic<unsigned> forkGeneration { 0 };
+
+void onForkChild()
+{
+    forkGeneration.fetch_add(1, std::memory_order_relaxed);
+}
+
+const int registerForkHandler = ::pthread_atfork(nullptr, nullptr, &onForkChild);
+
+// 线程本地的随机字节缓冲区，一次 RAND_bytes 可供 256 个 ID 使用
+struct RandomBuffer
+{
+    static const size_t kSize = 4096;
+
+    unsigned char bytes[kSize];
+    size_t        pos = kSize; // 已消耗的位置，初始为空
+    unsigned      generation = 0; // 填充时的 fork 代数
+
+    void take(unsigned char* out, size_t len)
+    {
+        // fork 出的子进程会继承缓冲区中的内容，必须丢弃，否则父子进程会生成相同的 ID
+        unsigned current = forkGeneration.load(std::memory_order_relaxed);
+        if (pos + len > kSize || generation != current)
+        {
+            if (RAND_bytes(bytes, static_cast<int>(kSize)) != 1)
+            {
+                throw std::runtime_error("RAND_bytes failed to generate session id");
+            }
+            pos = 0;
+            generation = current;
+        }
+        memcpy(out, bytes + pos, len);
+        // 用过的随机数立即清零，避免之后从内存中被读到
+        memset(bytes + pos, 0, len);
+        pos += len;
+    }
+};
+
+thread_local RandomBuffer tlsRandom;
+
+} // namespace
+
+std::string SessionIdGenerator::generate()
+{
+    unsigned char raw[kIdBytes];
+    randomBytes(raw);
+
+    char hex[kIdLength];
+    encodeHex(raw, kIdBytes, hex);
+    return std::string(hex, kIdLength);
+}
+
+void SessionIdGenerator::randomBytes(unsigned char* out)
+{
+    tlsRandom.take(out, kIdBytes);
+}
+
+void SessionIdGenerator::encodeHex(const unsigned char* in, size_t len, char* out)
+{
+    static const char kDigits[] = "0123456789abcdef";
+    for (size_t i = 0; i < len; ++i)
+    {
+        out[2 * i] = kDigits[in[i] >> 4];
+        out[2 * i + 1] = kDigits[in[i] & 0x0F];
+    }
+}
+
+bool SessionIdGenerator::decode(const std::string& id, BinarySessionId* out)
+{
+    if (id.size() != kIdLength)
+    {
+        return false;
+    }
+    // 只接受小写，保证一个会话只有一种字符串形式
+    uint64_t words[2] = {0, 0};
+    for (size_t i = 0; i < kIdLength; ++i)
+    {
+        char c = id[i];
+        uint64_t v;
+        if (c >= '0' && c <= '9')
+        {
+            v = c - '0';
+        }
+        else if (c >= 'a' && c <= 'f')
+        {
+            v = c - 'a' + 10;
+        }
+        else
+        {
+            return false;
+        }
+        words[i / 16] = (words[i / 16] << 4) | v;
+    }
+    out->high = words[0];
+    out->low = words[1];
+    return true;
+}
+
+} // namespace session
+} // namespace http
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace http
+{
+namespace session
+{
+
+// 会话 ID 的二进制形式，存储内部用作键，不必为每个会话保存 32 字节的十六进制串
+struct BinarySessionId
+{
+    uint64_t high; // 用于选择分片
+    uint64_t low; // 用于分片内的哈希表定位
+
+    bool operator==(const BinarySessionId& other) const
+    { return high == other.high && low == other.low; }
+};
+
+// 会话 ID 生成器
+// 随机数来自 OpenSSL RAND_bytes（CSPRNG），每个线程一块缓冲区批量填充，
+// 多个 IO 线程并发生成时无需加锁；编码为定长十六进制串，不经过 stringstream
+class SessionIdGenerator
+{
+public:
+    static const size_t kIdBytes = 16; // 128 位随机数
+    static const size_t kIdLength = kIdBytes * 2; // 十六进制编码后的长度
+
+    // 生成新的会话 ID，随机源不可用时抛出 std::runtime_error
+    static std::string generate();
+
+    // 把 kIdBytes 个随机字节写入 out
+    static void randomBytes(unsigned char* out);
+
+    // 十六进制编码，out 至少 len * 2 字节，查表实现，无分支
+    static void encodeHex(const unsigned char* in, size_t len, char* out);
+
+    // 把 generate() 生成的 ID 解析为二进制形式，长度不符或含非小写十六进制字符时返回 false
+    static bool decode(const std::string& id, BinarySessionId* out);
+};
+
+} // namespace session
+} // namespace http
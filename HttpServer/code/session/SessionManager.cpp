@@ -1,97 +1,151 @@
 #include"SessionManager.h"
-#include <iomanip>
+#include "SessionIdGenerator.h"
+#include <algorithm>
 #include <iostream>
-#include <sstream>
+#include <muduo/base/Logging.h>
 
 namespace http
 {
 namespace session
 {
 
-// 初始化会话管理器，设置会话存储对象和随机数生成器
+// 初始化会话管理器，设置会话存储对象
 SessionManager::SessionManager(std::unique_ptr<SessionStorage> storage)
     : storage_(std::move(storage)) 
-    , rng_(std::random_device{}()) // 初始化随机数生成器，用于生成随机的会话ID
+{}
+
+SessionManager::SessionManager(std::unique_ptr<CookieSessionCodec> codec)
+    : codec_(std::move(codec))
 {}
 
 // 从请求中获取或创建会话，也就是说，如果请求中包含会话ID，则从存储中加载会话，否则创建一个新的会话
 std::shared_ptr<Session> SessionManager::getSession(const HttpRequest& req, HttpResponse* resp)
 {   
-    std::string sessionId = getSessionIdFromCookie(req);
+    auto& pending = pendingSessions();
+    if (codec_)
+    {
+        // 同一请求中多次获取返回同一个会话，避免重复解码和重复写 cookie
+        for (const auto& p : pending)
+        {
+            if (p.resp == resp && p.session->getManager() == this && !p.destroyed)
+            {
+                return p.session;
+            }
+        }
+    }
+
+    std::string sessionId(req.getCookie(codec_ ? codec_->config().cookieName : "sessionId"));
     
     std::shared_ptr<Session> session;
 
     if (!sessionId.empty())
     {
-        session = storage_->load(sessionId);
+        // 无状态模式下 cookie 中就是会话本身，验证签名即可，不访问任何共享状态
+        session = codec_ ? codec_->decode(sessionId, this) : storage_->load(sessionId);
     }
 
     if (!session || session->isExpired())
     {
         sessionId = generateSessionId();
         session = std::make_shared<Session>(sessionId, this);
-        setSessionCookie(sessionId, resp);
+        session->markDirty(); // 新会话必须保存
+        if (!codec_)
+        {
+            setSessionCookie(sessionId, resp); // 无状态模式在请求结束时连同数据一起写入
+        }
     }
     else 
     {
         session->setManager(this); // 为现有会话设置管理器
+        session->touch(touchInterval_);
     }
 
-    session->refresh();
-    storage_->save(session);  // 这里可能有问题，需要确保正确保存会话
+    // 不立即保存，请求结束时只在有修改时写回一次
+    auto it = std::find_if(pending.begin(), pending.end(),
+                           [&](const PendingSession& p) { return p.session == session; });
+    if (it == pending.end())
+    {
+        pending.push_back(PendingSession{session, resp, false});
+    }
     return session;
 }
 
-// 生成唯一的会话标识符，确保会话的唯一性和安全性
-std::string SessionManager::generateSessionId()
+std::vector<SessionManager::PendingSession>& SessionManager::pendingSessions()
 {
-    std::stringstream ss;
-    std::uniform_int_distribution<> dist(0, 15);
-
-    // 生成32个字符的会话ID，每个字符是一个十六进制数字
-    for (int i = 0; i < 32; ++i)
-    {
-        ss << std::hex << dist(rng_);
-    }
-    return ss.str();
+    // 处理函数在 IO 线程上同步执行，本线程的列表即为当前请求的会话
+    static thread_local std::vector<PendingSession> sessions;
+    return sessions;
 }
 
-void SessionManager::destroySession(const std::string& sessionId)
+void SessionManager::flushPendingSessions()
 {
-    storage_->remove(sessionId);
+    auto& pending = pendingSessions();
+    if (pending.empty())
+    {
+        return;
+    }
+    for (auto& p : pending)
+    {
+        SessionManager* manager = p.session->getManager();
+        if (!manager)
+        {
+            continue;
+        }
+        if (manager->codec_)
+        {
+            manager->writeSessionCookie(p);
+        }
+        else if (p.session->needsPersist())
+        {
+            manager->updateSession(p.session);
+        }
+    }
+    pending.clear();
 }
 
-void SessionManager::cleanExpiredSessions()
+// 生成唯一的会话标识符，确保会话的唯一性和安全性
+std::string SessionManager::generateSessionId()
 {
-    // 注意：这个实现依赖于具体的存储实现
-    // 对于内存存储，可以在加载时检查是否过期
-    // 对于其他存储的实现，可能需要定期清理过期会话
+    // 128 位 CSPRNG 随机数，编码为 32 个十六进制字符
+    return SessionIdGenerator::generate();
 }
 
-std::string SessionManager::getSessionIdFromCookie(const HttpRequest& req)
+void SessionManager::destroySession(const std::string& sessionId)
 {
-    std::string sessionId;
-    std::string cookie = req.getHeader("Cookie");
+    if (!codec_)
+    {
+        storage_->remove(sessionId);
+        return;
+    }
 
-    if (!cookie.empty())
+    // 无状态模式无法在服务端删除，只能在本次响应中清除客户端的 cookie
+    for (auto& p : pendingSessions())
     {
-        size_t pos = cookie.find("sessionId=");
-        if (pos != std::string::npos)
+        if (p.session->getId() == sessionId && p.session->getManager() == this)
         {
-            pos += 10; // 跳过"sessionId="
-            size_t end = cookie.find(';', pos);
-            if (end != std::string::npos)
-            {
-                sessionId = cookie.substr(pos, end - pos);
-            }
-            else
-            {
-                sessionId = cookie.substr(pos);
-            }
+            p.destroyed = true;
         }
     }
-    
-    return sessionId;
+}
+
+void SessionManager::cleanExpiredSessions()
+{
+    // 具体的清理方式由存储实现决定，这里只限定单次的工作量，避免长时间占用事件循环
+    if (!storage_)
+    {
+        return; // 无状态模式的过期由 cookie 中的过期时间保证
+    }
+    size_t removed = storage_->cleanExpired(maxCleanPerTick_);
+    if (removed > 0)
+    {
+        LOG_DEBUG << "Cleaned " << removed << " expired sessions";
+    }
+}
+
+void SessionManager::startCleanup(muduo::net::EventLoop* loop, double intervalSecs, size_t maxPerTick)
+{
+    maxCleanPerTick_ = maxPerTick;
+    loop->runEvery(intervalSecs, std::bind(&SessionManager::cleanExpiredSessions, this));
 }
 
 void SessionManager::setSessionCookie(const std::string& sessionId, HttpResponse* resp)
@@ -101,5 +155,28 @@ void SessionManager::setSessionCookie(const std::string& sessionId, HttpResponse
     resp->addHeader("Set-Cookie", cookie);
 }
 
+void SessionManager::writeSessionCookie(const PendingSession& pending)
+{
+    const CookieSessionConfig& config = codec_->config();
+    if (pending.destroyed)
+    {
+        pending.resp->addHeader("Set-Cookie", config.cookieName + "=; Max-Age=0; " + config.cookieAttributes);
+        return;
+    }
+    if (!pending.session->needsPersist())
+    {
+        return; // 未修改且未续期，客户端已有的 cookie 仍然有效
+    }
+
+    std::string value = codec_->encode(*pending.session);
+    if (value.empty())
+    {
+        LOG_ERROR << "Session " << pending.session->getId() << " is too large for a cookie, dropped";
+        return;
+    }
+    pending.resp->addHeader("Set-Cookie", config.cookieName + "=" + value + "; " + config.cookieAttributes);
+    pending.session->markPersisted();
+}
+
 } // namespace session
 } // namespace http
\ No newline at end of file
@@ -1,10 +1,13 @@
 #pragma once
 
+#include "CookieSessionCodec.h"
 #include "SessionStorage.h"
 #include "../http/HttpRequest.h"
 #include "../http/HttpResponse.h"
 #include <memory>
-#include <random>
+#include <vector>
+#include <muduo/base/noncopyable.h>
+#include <muduo/net/EventLoop.h>
 
 namespace http
 {
@@ -15,6 +18,8 @@ class SessionManager
 {
 public:
     explicit SessionManager(std::unique_ptr<SessionStorage> storage);
+    // 无状态模式：会话数据签名后保存在 cookie 中，服务端不使用存储
+    explicit SessionManager(std::unique_ptr<CookieSessionCodec> codec);
 
     // 从请求中获取或创建会话
     std::shared_ptr<Session> getSession(const HttpRequest& req, HttpResponse* resp);
@@ -22,22 +27,59 @@ public:
      // 销毁会话
     void destroySession(const std::string& sessionId);
 
-    // 清理过期会话
+    // 清理过期会话，每次调用最多处理 maxCleanPerTick_ 个条目
     void cleanExpiredSessions();
 
-    // 更新会话
+    // 在 loop 上定时增量清理过期会话，intervalSecs 为清理间隔，maxPerTick 为每次最多处理的条目数
+    void startCleanup(muduo::net::EventLoop* loop, double intervalSecs = 1.0, size_t maxPerTick = 10000);
+
+    // 立即保存会话；无状态模式下只能在请求结束时写入 cookie，这里只标记为脏
     void updateSession(std::shared_ptr<Session> session)
     {
+        if (!storage_)
+        {
+            session->markDirty();
+            return;
+        }
         storage_->save(session);
+        session->markPersisted();
     }
+
+    // 过期时间的刷新间隔（秒），间隔内的访问不延长过期时间，也就不需要写回存储
+    void setTouchInterval(int seconds)
+    { touchInterval_ = seconds; }
+
+    // 把当前线程本次请求中取出、且有修改的会话写回各自的存储
+    // HttpServer 在每个请求处理完毕后调用，处理函数本身不需要关心
+    static void flushPendingSessions();
+
+    // 一个请求的会话作用域，构造和析构时都清空当前线程的待写回列表
+    // 处理函数或写回抛出异常时，指向已释放响应的条目不会留给同一线程上的下一个请求
+    class RequestScope : muduo::noncopyable
+    {
+    public:
+        RequestScope() { pendingSessions().clear(); }
+        ~RequestScope() { pendingSessions().clear(); }
+    };
 private:
+    // 本次请求中取出的会话，无状态模式需要在请求结束时把会话写入响应
+    struct PendingSession
+    {
+        std::shared_ptr<Session> session;
+        HttpResponse*            resp;
+        bool                     destroyed;
+    };
+
+    static std::vector<PendingSession>& pendingSessions();
     std::string generateSessionId();
-    std::string getSessionIdFromCookie(const HttpRequest& req);
     void setSessionCookie(const std::string& sessionId, HttpResponse* resp);
+    void writeSessionCookie(const PendingSession& pending);
 
 private:
     std::unique_ptr<SessionStorage> storage_;
-    std::mt19937 rng_; // 用于生成随机会话id
+    std::unique_ptr<CookieSessionCodec> codec_; // 非空时为无状态模式
+    size_t maxCleanPerTick_ = 10000; // 每次清理最多处理的条目数
+    int touchInterval_ = 60; // 过期时间的刷新间隔（秒）
 };
 
 } // namespace session
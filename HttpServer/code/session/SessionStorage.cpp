@@ -1,35 +1,136 @@
 #include "SessionStorage.h"
+#include <algorithm>
+#include <chrono>
 #include <iostream>
 
+#include <muduo/base/Logging.h>
+
 namespace http
 {
 
 namespace session
 {
 
+namespace
+{
+
+int64_t nowSecond()
+{
+    return std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+} // namespace
+
+MemorySessionStorage::MemorySessionStorage(size_t shardCount, size_t maxSessions)
+    : cleanCursor_(0)
+{
+    // 向上取整到 2 的幂
+    size_t count = 1;
+    while (count < shardCount)
+    {
+        count <<= 1;
+    }
+    shards_.reset(new Shard[count]);
+    shardMask_ = count - 1;
+    maxPerShard_ = maxSessions == 0 ? 0 : std::max<size_t>(1, maxSessions / count);
+
+    int64_t now = nowSecond();
+    for (size_t i = 0; i < count; ++i)
+    {
+        resize(shards_[i], kInitialSlots);
+        shards_[i].wheel.resize(kWheelSlots);
+        shards_[i].nextSecond = now;
+    }
+}
+
 void MemorySessionStorage::save(std::shared_ptr<Session> session)
 {
-    // 创建会话副本并存储
-    sessions_[session->getId()] = session;
+    BinarySessionId id;
+    if (!SessionIdGenerator::decode(session->getId(), &id))
+    {
+        LOG_ERROR << "MemorySessionStorage rejects malformed session id: " << session->getId();
+        return;
+    }
+
+    // 在锁外统计内存占用
+    uint32_t bytes = static_cast<uint32_t>(session->memoryUsage());
+    Shard& shard = shardFor(id);
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    size_t index = find(shard, id);
+    if (index != kNotFound)
+    {
+        // 已在时间轮中，过期时间延长后由清理时重新入轮，这里不需要调整
+        Slot& slot = shard.slots[index];
+        // 两者都是 uint32_t，直接相减在会话变小时会回绕
+        shard.bytes -= slot.bytes;
+        shard.bytes += bytes;
+        slot.session = std::move(session);
+        slot.bytes = bytes;
+        shard.referenced[index].store(true, std::memory_order_relaxed);
+        return;
+    }
+
+    if (maxPerShard_ > 0 && shard.count >= maxPerShard_)
+    {
+        evictOne(shard);
+    }
+    // 负载因子不超过 3/4，保证线性探测的链足够短
+    if ((shard.count + 1) * 4 > shard.slots.size() * 3)
+    {
+        resize(shard, shard.slots.size() * 2);
+    }
+
+    size_t mask = shard.slots.size() - 1;
+    index = id.low & mask;
+    while (shard.slots[index].session)
+    {
+        index = (index + 1) & mask;
+    }
+    int64_t expiry = expirySecond(*session);
+    Slot& slot = shard.slots[index];
+    slot.id = id;
+    slot.session = std::move(session);
+    slot.bytes = bytes;
+    shard.referenced[index].store(false, std::memory_order_relaxed);
+    ++shard.count;
+    shard.bytes += bytes;
+    schedule(shard, id, expiry);
 }
 
 // 通过会话ID从存储中加载会话
 std::shared_ptr<Session> MemorySessionStorage::load(const std::string& sessionId)
 {
-    auto it = sessions_.find(sessionId);
-    if (it != sessions_.end())
+    BinarySessionId id;
+    if (!SessionIdGenerator::decode(sessionId, &id))
+    {
+        return nullptr; // 伪造或损坏的 cookie，不需要加锁
+    }
+
+    Shard& shard = shardFor(id);
     {
-        if (!it->second->isExpired())
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        size_t index = find(shard, id);
+        if (index == kNotFound)
         {
-            return it->second;
+            return nullptr;
         }
-        else
+        if (!shard.slots[index].session->isExpired())
         {
-            // 如果会话已过期，则从存储中移除
-            sessions_.erase(it);
+            // 只置访问位，CLOCK 淘汰时跳过最近访问过的会话
+            shard.referenced[index].store(true, std::memory_order_relaxed);
+            return shard.slots[index].session;
         }
     }
 
+    // 如果会话已过期，则升级为写锁从存储中移除（期间可能已被其它线程替换，需重新检查）
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    size_t index = find(shard, id);
+    if (index != kNotFound && shard.slots[index].session->isExpired())
+    {
+        erase(shard, index);
+    }
+
     // 如果会话不存在或已过期，则返回nullptr
     return nullptr;
 }
@@ -37,7 +138,230 @@ std::shared_ptr<Session> MemorySessionStorage::load(const std::string& sessionId
 // 通过会话ID从存储中移除会话
 void MemorySessionStorage::remove(const std::string& sessionId)
 {
-    sessions_.erase(sessionId);
+    BinarySessionId id;
+    if (!SessionIdGenerator::decode(sessionId, &id))
+    {
+        return;
+    }
+
+    Shard& shard = shardFor(id);
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    size_t index = find(shard, id);
+    if (index != kNotFound)
+    {
+        // 时间轮中残留的 ID 在到期处理时会被忽略
+        erase(shard, index);
+    }
+}
+
+// 每次最多处理 maxCount 个时间轮条目，各分片轮流处理，单次持锁时间有界
+size_t MemorySessionStorage::cleanExpired(size_t maxCount)
+{
+    size_t shardCount = shardMask_ + 1;
+    size_t perShard = std::max<size_t>(1, maxCount / shardCount);
+    int64_t now = nowSecond();
+    size_t removed = 0;
+    size_t budget = maxCount;
+    for (size_t i = 0; i < shardCount && budget > 0; ++i)
+    {
+        Shard& shard = shards_[(cleanCursor_ + i) & shardMask_];
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        removed += cleanShard(shard, std::min(perShard, budget), now);
+        budget -= std::min(perShard, budget);
+    }
+    cleanCursor_ = (cleanCursor_ + 1) & shardMask_;
+    return removed;
+}
+
+size_t MemorySessionStorage::cleanShard(Shard& shard, size_t maxCount, int64_t now)
+{
+    size_t removed = 0;
+    size_t processed = 0;
+    while (processed < maxCount)
+    {
+        if (shard.pending.empty())
+        {
+            if (shard.nextSecond > now)
+            {
+                break;
+            }
+            shard.pending.swap(shard.wheel[shard.nextSecond % kWheelSlots]);
+            ++shard.nextSecond;
+            continue;
+        }
+
+        BinarySessionId id = shard.pending.back();
+        shard.pending.pop_back();
+        ++processed;
+
+        size_t index = find(shard, id);
+        if (index == kNotFound)
+        {
+            continue; // 已被删除或淘汰
+        }
+        const Session& session = *shard.slots[index].session;
+        if (session.isExpired())
+        {
+            erase(shard, index);
+            ++removed;
+        }
+        else
+        {
+            // 过期时间被刷新过（或超出时间轮一圈），按新的过期时间重新入轮
+            schedule(shard, id, expirySecond(session));
+        }
+    }
+    return removed;
+}
+
+size_t MemorySessionStorage::size() const
+{
+    size_t total = 0;
+    for (size_t i = 0; i <= shardMask_; ++i)
+    {
+        std::shared_lock<std::shared_mutex> lock(shards_[i].mutex);
+        total += shards_[i].count;
+    }
+    return total;
+}
+
+size_t MemorySessionStorage::memoryUsage() const
+{
+    size_t total = sizeof(*this) + (shardMask_ + 1) * sizeof(Shard);
+    for (size_t i = 0; i <= shardMask_; ++i)
+    {
+        const Shard& shard = shards_[i];
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        total += shard.bytes;
+        total += shard.slots.capacity() * (sizeof(Slot) + sizeof(std::atomic<bool>));
+        total += shard.wheel.capacity() * sizeof(std::vector<BinarySessionId>);
+        for (const auto& bucket : shard.wheel)
+        {
+            total += bucket.capacity() * sizeof(BinarySessionId);
+        }
+        total += shard.pending.capacity() * sizeof(BinarySessionId);
+    }
+    return total;
+}
+
+void MemorySessionStorage::forEach(const std::function<void(const std::shared_ptr<Session>&)>& fn) const
+{
+    for (size_t i = 0; i <= shardMask_; ++i)
+    {
+        std::shared_lock<std::shared_mutex> lock(shards_[i].mutex);
+        for (const auto& slot : shards_[i].slots)
+        {
+            if (slot.session)
+            {
+                fn(slot.session);
+            }
+        }
+    }
+}
+
+int64_t MemorySessionStorage::expirySecond(const Session& session)
+{
+    return std::chrono::duration_cast<std::chrono::seconds>(
+        session.getExpiryTime().time_since_epoch()).count() + 1;
+}
+
+size_t MemorySessionStorage::find(const Shard& shard, const BinarySessionId& id)
+{
+    size_t mask = shard.slots.size() - 1;
+    for (size_t index = id.low & mask; shard.slots[index].session; index = (index + 1) & mask)
+    {
+        if (shard.slots[index].id == id)
+        {
+            return index;
+        }
+    }
+    return kNotFound;
+}
+
+// 调整哈希表容量并重新插入所有会话，访问位随会话一起迁移
+void MemorySessionStorage::resize(Shard& shard, size_t capacity)
+{
+    std::vector<Slot> slots(capacity);
+    std::unique_ptr<std::atomic<bool>[]> referenced(new std::atomic<bool>[capacity]);
+    for (size_t i = 0; i < capacity; ++i)
+    {
+        referenced[i].store(false, std::memory_order_relaxed);
+    }
+
+    size_t mask = capacity - 1;
+    for (size_t i = 0; i < shard.slots.size(); ++i)
+    {
+        Slot& slot = shard.slots[i];
+        if (!slot.session)
+        {
+            continue;
+        }
+        size_t index = slot.id.low & mask;
+        while (slots[index].session)
+        {
+            index = (index + 1) & mask;
+        }
+        referenced[index].store(shard.referenced[i].load(std::memory_order_relaxed),
+                                std::memory_order_relaxed);
+        slots[index] = std::move(slot);
+    }
+    shard.slots.swap(slots);
+    shard.referenced.swap(referenced);
+    shard.hand = 0;
+}
+
+void MemorySessionStorage::schedule(Shard& shard, const BinarySessionId& id, int64_t second)
+{
+    // 已经处理过的秒不会再被扫描，放到下一个待处理的秒
+    second = std::max(second, shard.nextSecond);
+    shard.wheel[second % kWheelSlots].push_back(id);
+}
+
+// 删除后把同一探测链上的后续条目前移（backward shift），不使用墓碑，查找链不会越来越长
+void MemorySessionStorage::erase(Shard& shard, size_t index)
+{
+    size_t mask = shard.slots.size() - 1;
+    shard.bytes -= shard.slots[index].bytes;
+    --shard.count;
+
+    size_t hole = index;
+    for (size_t next = (hole + 1) & mask; shard.slots[next].session; next = (next + 1) & mask)
+    {
+        // 条目的理想位置不在 (hole, next] 区间内时，可以移到空洞处
+        size_t home = shard.slots[next].id.low & mask;
+        bool movable = hole <= next ? (home <= hole || home > next)
+                                    : (home <= hole && home > next);
+        if (movable)
+        {
+            shard.slots[hole] = std::move(shard.slots[next]);
+            shard.referenced[hole].store(shard.referenced[next].load(std::memory_order_relaxed),
+                                         std::memory_order_relaxed);
+            hole = next;
+        }
+    }
+    shard.slots[hole].session.reset();
+    shard.slots[hole].bytes = 0;
+    shard.referenced[hole].store(false, std::memory_order_relaxed);
+}
+
+// CLOCK 淘汰：指针在槽位数组上循环，访问位为真的清除后跳过（第二次机会），否则淘汰
+void MemorySessionStorage::evictOne(Shard& shard)
+{
+    size_t mask = shard.slots.size() - 1;
+    // 最多扫描两圈：第一圈清除所有访问位，第二圈必然能找到可淘汰的条目
+    for (size_t step = 0; step < 2 * shard.slots.size() && shard.count > 0; ++step)
+    {
+        size_t index = shard.hand;
+        shard.hand = (shard.hand + 1) & mask;
+        if (!shard.slots[index].session ||
+            shard.referenced[index].exchange(false, std::memory_order_relaxed))
+        {
+            continue;
+        }
+        LOG_DEBUG << "Session evicted by capacity limit: " << shard.slots[index].session->getId();
+        erase(shard, index);
+        return;
+    }
 }
 
 } // namespace session
@@ -1,6 +1,13 @@
 #pragma once
 #include "Session.h"
+#include "SessionIdGenerator.h"
+#include <atomic>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <vector>
 
 namespace http
 {
@@ -14,17 +21,80 @@ public:
     virtual void save(std::shared_ptr<Session> session) = 0;
     virtual std::shared_ptr<Session> load(const std::string& sessionId) = 0;
     virtual void remove(const std::string& sessionId) = 0;
+
+    // 清理过期会话，最多处理 maxCount 个条目，返回实际清理的数量
+    // 由 SessionManager 定时调用，不需要主动清理的存储实现可以不重写
+    virtual size_t cleanExpired(size_t /*maxCount*/) { return 0; }
 };
 
 // 基于内存的会话存储实现
+// 多个 IO 线程并发访问，按会话 ID 哈希分片，每个分片一把读写锁，load 只需共享锁
+// 每个分片是一张开放寻址（线性探测）哈希表，以 16 字节二进制 ID 为键，槽位连续存放，
+// 没有哈希节点、没有重复保存的 ID 字符串，也没有 CLOCK 链表节点
+// 过期清理：每个分片一个按秒划分的时间轮，cleanExpired 每次只处理有限个条目
+// 容量上限：超过 maxSessions 时按 CLOCK（近似 LRU）淘汰，指针直接扫描槽位数组，load 只置访问位，不需要写锁
+// 只接受 SessionIdGenerator 生成的 ID，其它格式的 ID 查找不到，也不会被保存
 class MemorySessionStorage : public SessionStorage
 {
 public:
+    // maxSessions 为 0 表示不限制会话数量
+    explicit MemorySessionStorage(size_t shardCount = 64, size_t maxSessions = 0);
+
     void save(std::shared_ptr<Session> session) override;
     std::shared_ptr<Session> load(const std::string& sessionId) override;
     void remove(const std::string& sessionId) override;
+    size_t cleanExpired(size_t maxCount) override;
+
+    // 会话总数（各分片逐个加锁统计，仅供监控使用）
+    size_t size() const;
+
+    // 估算的内存占用：各会话保存时统计的大小加上哈希表和时间轮本身（仅供监控使用）
+    size_t memoryUsage() const;
+
+    // 遍历所有会话（逐个分片持共享锁），用于生成快照
+    void forEach(const std::function<void(const std::shared_ptr<Session>&)>& fn) const;
+private:
+    static const size_t kWheelSlots = 4096; // 时间轮槽数（秒），超出一圈的条目到期时重新入轮
+    static const size_t kInitialSlots = 16; // 每个分片哈希表的初始槽数
+    static const size_t kNotFound = static_cast<size_t>(-1);
+
+    struct Slot
+    {
+        BinarySessionId          id;
+        std::shared_ptr<Session> session; // 为空表示槽位空闲
+        uint32_t                 bytes = 0; // 保存时统计的会话内存占用
+    };
+
+    // 按缓存行对齐，避免相邻分片的锁伪共享
+    struct alignas(64) Shard
+    {
+        mutable std::shared_mutex                 mutex;
+        std::vector<Slot>                         slots; // 容量为 2 的幂
+        std::unique_ptr<std::atomic<bool>[]>      referenced; // 与 slots 一一对应的访问位
+        size_t                                    count = 0; // 已占用的槽数
+        size_t                                    hand = 0; // CLOCK 指针
+        size_t                                    bytes = 0; // 会话内存占用之和
+        std::vector<std::vector<BinarySessionId>> wheel; // 到期秒 % kWheelSlots -> 会话 ID
+        std::vector<BinarySessionId>              pending; // 正在处理的槽中尚未处理的条目
+        int64_t                                   nextSecond = 0; // 下一个待处理的秒
+    };
+
+    Shard& shardFor(const BinarySessionId& id)
+    { return shards_[id.high & shardMask_]; }
+
+    static int64_t expirySecond(const Session& session);
+    static size_t find(const Shard& shard, const BinarySessionId& id);
+    static void resize(Shard& shard, size_t capacity);
+    void schedule(Shard& shard, const BinarySessionId& id, int64_t second);
+    void erase(Shard& shard, size_t index);
+    void evictOne(Shard& shard);
+    size_t cleanShard(Shard& shard, size_t maxCount, int64_t now);
+
 private:
-    std::unordered_map<std::string, std::shared_ptr<Session>> sessions_;
+    std::unique_ptr<Shard[]> shards_;
+    size_t                   shardMask_; // 分片数为 2 的幂，用掩码代替取模
+    size_t                   maxPerShard_; // 每个分片的容量上限，0 表示不限制
+    size_t                   cleanCursor_; // 下次清理开始的分片，只在清理线程访问
 };
 
 } // namespace session
@@ -0,0 +1,639 @@
+#include "SharedMemorySessionStorage.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <vector>
+
+#include <muduo/base/Logging.h>
+
+namespace http
+{
+namespace session
+{
+
+namespace
+{
+
+const uint64_t kMagic = 0x48535348534D454DULL; // "HSSHSMEM"
+const uint32_t kVersion = 1;
+const size_t   kCacheLine = 64;
+
+int64_t nowSecond()
+{
+    return std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+size_t roundUp(size_t n, size_t align)
+{
+    return (n + align - 1) / align * align;
+}
+
+// 会话数据格式：u16 键值对数 | (u16 长度, 键, u32 长度, 值)...
+void encodeData(const Session& session, std::string* out)
+{
+    auto put = [out](uint32_t value, size_t bytes) {
+        out->append(reinterpret_cast<const char*>(&value), bytes);
+    };
+    put(static_cast<uint32_t>(session.getData().size()), 2);
+    for (const auto& kv : session.getData())
+    {
+        put(static_cast<uint32_t>(kv.name().size()), 2);
+        out->append(kv.name());
+        put(static_cast<uint32_t>(kv.value.size()), 4);
+        out->append(kv.value);
+    }
+}
+
+bool decodeData(const std::string& in, SessionData* data)
+{
+    size_t pos = 0;
+    auto get = [&](size_t bytes, uint32_t* value) {
+        if (in.size() - pos < bytes)
+        {
+            return false;
+        }
+        *value = 0;
+        memcpy(value, in.data() + pos, bytes);
+        pos += bytes;
+        return true;
+    };
+
+    uint32_t count = 0;
+    if (!get(2, &count))
+    {
+        return false;
+    }
+    data->reserve(count);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        uint32_t klen = 0, vlen = 0;
+        if (!get(2, &klen) || in.size() - pos < klen)
+        {
+            return false;
+        }
+        std::string key(in, pos, klen);
+        pos += klen;
+        if (!get(4, &vlen) || in.size() - pos < vlen)
+        {
+            return false;
+        }
+        data->set(key, std::string(in, pos, vlen));
+        pos += vlen;
+    }
+    return true;
+}
+
+} // namespace
+
+// 段头，位于共享内存起始处；由创建段的进程初始化，所有进程共享
+struct SharedMemorySessionStorage::Header
+{
+    uint64_t              magic;
+    uint32_t              version;
+    uint32_t              slotBytes;
+    uint64_t              slotCount;
+    std::atomic<uint32_t> ready; // 初始化完成后置 1
+    std::atomic<uint64_t> epoch; // 重建哈希表时为奇数，读者据此等待或重试
+    std::atomic<uint64_t> used; // 已占用的槽数
+    pthread_mutex_t       writeMutex; // 进程间共享的健壮互斥锁，串行化所有写入
+
+    // 以下字段只在持有 writeMutex 时访问
+    uint64_t              tombstones;
+    int64_t               writingSlot; // 正在写入的槽，持锁进程崩溃时据此修复，-1 表示没有
+    uint32_t              rebuilding; // 正在重建哈希表
+    uint64_t              cleanCursor; // 过期清理的扫描位置，各进程共用
+};
+
+// 槽布局：u32 序列号（奇数表示写入中）| 填充 | SlotData | 会话数据
+struct SharedMemorySessionStorage::SlotData
+{
+    uint32_t state;
+    uint32_t length; // 会话数据的字节数
+    uint64_t high;
+    uint64_t low;
+    int64_t  expiresAt; // unix 秒
+    int32_t  maxAge;
+    uint32_t reserved;
+};
+
+namespace
+{
+
+const size_t kSlotHeaderBytes = 8 + 40; // 序列号和 SlotData
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free && std::atomic<uint64_t>::is_always_lock_free,
+              "shared memory atomics must be lock-free");
+
+std::atomic<uint32_t>& slotSeq(char* slot)
+{
+    return *reinterpret_cast<std::atomic<uint32_t>*>(slot);
+}
+
+} // namespace
+
+// 写锁：持锁进程崩溃后锁变为 EOWNERDEAD，由下一个加锁者修复后继续使用
+class SharedMemorySessionStorage::WriteLock
+{
+public:
+    explicit WriteLock(SharedMemorySessionStorage* storage)
+        : mutex_(&storage->header_->writeMutex)
+    {
+        int rc = pthread_mutex_lock(mutex_);
+        if (rc == EOWNERDEAD)
+        {
+            LOG_WARN << "Session store writer died while holding the lock, recovering";
+            storage->recover();
+            pthread_mutex_consistent(mutex_);
+        }
+        else if (rc != 0)
+        {
+            throw std::runtime_error("Failed to lock shared session store: " + std::string(strerror(rc)));
+        }
+    }
+
+    ~WriteLock()
+    {
+        pthread_mutex_unlock(mutex_);
+    }
+
+private:
+    pthread_mutex_t* mutex_;
+};
+
+SharedMemorySessionStorage::SharedMemorySessionStorage(const SharedMemorySessionStorageConfig& config)
+    : config_(config)
+    , slotCount_(1)
+    , slotBytes_(roundUp(std::max(config.slotBytes, kSlotHeaderBytes + kCacheLine), kCacheLine))
+    , mappedBytes_(0)
+    , fd_(-1)
+    , base_(nullptr)
+    , header_(nullptr)
+{
+    static_assert(sizeof(SlotData) + 8 == kSlotHeaderBytes, "unexpected slot header size");
+    while (slotCount_ < config.capacity)
+    {
+        slotCount_ <<= 1;
+    }
+    mappedBytes_ = roundUp(sizeof(Header), kCacheLine) + slotCount_ * slotBytes_;
+    attach();
+}
+
+SharedMemorySessionStorage::~SharedMemorySessionStorage()
+{
+    // 只解除映射，段留给其它进程和重启后的进程使用
+    if (base_)
+    {
+        ::munmap(base_, mappedBytes_);
+    }
+    if (fd_ >= 0)
+    {
+        ::close(fd_);
+    }
+}
+
+void SharedMemorySessionStorage::attach()
+{
+    bool creator = true;
+    fd_ = ::shm_open(config_.name.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    if (fd_ < 0 && errno == EEXIST)
+    {
+        creator = false;
+        fd_ = ::shm_open(config_.name.c_str(), O_RDWR | O_CLOEXEC, 0600);
+    }
+    if (fd_ < 0)
+    {
+        throw std::runtime_error("shm_open failed for " + config_.name + ": " + strerror(errno));
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(config_.attachTimeoutMs);
+    if (creator)
+    {
+        // 新扩展的部分由内核清零，所有槽初始即为空
+        if (::ftruncate(fd_, static_cast<off_t>(mappedBytes_)) != 0)
+        {
+            throw std::runtime_error("ftruncate failed for " + config_.name + ": " + strerror(errno));
+        }
+    }
+    else
+    {
+        // 等待创建者设置好段大小
+        struct stat st;
+        while (::fstat(fd_, &st) == 0 && st.st_size == 0 && std::chrono::steady_clock::now() < deadline)
+        {
+            ::usleep(1000);
+        }
+        if (static_cast<size_t>(st.st_size) != mappedBytes_)
+        {
+            throw std::runtime_error("Shared session store " + config_.name +
+                                     " exists with a different capacity or slot size");
+        }
+    }
+
+    void* addr = ::mmap(nullptr, mappedBytes_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (addr == MAP_FAILED)
+    {
+        throw std::runtime_error("mmap failed for " + config_.name + ": " + strerror(errno));
+    }
+    base_ = static_cast<char*>(addr);
+    header_ = reinterpret_cast<Header*>(base_);
+
+    if (creator)
+    {
+        new (header_) Header();
+        header_->magic = kMagic;
+        header_->version = kVersion;
+        header_->slotBytes = static_cast<uint32_t>(slotBytes_);
+        header_->slotCount = slotCount_;
+        header_->tombstones = 0;
+        header_->writingSlot = -1;
+        header_->rebuilding = 0;
+        header_->cleanCursor = 0;
+
+        pthread_mutexattr_t attr;
+        pthread_mutexattr_init(&attr);
+        pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+        pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+        pthread_mutex_init(&header_->writeMutex, &attr);
+        pthread_mutexattr_destroy(&attr);
+
+        header_->ready.store(1, std::memory_order_release);
+        LOG_INFO << "Created shared session store " << config_.name << " with " << slotCount_ << " slots";
+        return;
+    }
+
+    while (header_->ready.load(std::memory_order_acquire) != 1)
+    {
+        if (std::chrono::steady_clock::now() >= deadline)
+        {
+            throw std::runtime_error("Shared session store " + config_.name +
+                                     " was never initialized, remove it with SharedMemorySessionStorage::unlink");
+        }
+        ::usleep(1000);
+    }
+    if (header_->magic != kMagic || header_->version != kVersion ||
+        header_->slotCount != slotCount_ || header_->slotBytes != slotBytes_)
+    {
+        throw std::runtime_error("Shared session store " + config_.name + " has an incompatible layout");
+    }
+    LOG_INFO << "Attached to shared session store " << config_.name
+             << " (" << header_->used.load(std::memory_order_relaxed) << " sessions)";
+}
+
+void SharedMemorySessionStorage::save(std::shared_ptr<Session> session)
+{
+    BinarySessionId id;
+    if (!SessionIdGenerator::decode(session->getId(), &id))
+    {
+        LOG_ERROR << "SharedMemorySessionStorage rejects malformed session id: " << session->getId();
+        return;
+    }
+
+    // 序列化在锁外完成，持锁期间只做探测和拷贝
+    std::string payload;
+    encodeData(*session, &payload);
+    if (payload.size() > slotBytes_ - kSlotHeaderBytes)
+    {
+        LOG_ERROR << "Session " << session->getId() << " (" << payload.size()
+                  << " bytes) exceeds the shared store slot size, not saved";
+        return;
+    }
+    SlotData data{kFull, static_cast<uint32_t>(payload.size()), id.high, id.low,
+                  std::chrono::duration_cast<std::chrono::seconds>(
+                      session->getExpiryTime().time_since_epoch()).count(),
+                  session->getMaxAge(), 0};
+
+    int64_t now = nowSecond();
+    WriteLock lock(this);
+    size_t mask = slotCount_ - 1;
+    size_t target = static_cast<size_t>(-1);
+    size_t reusable = static_cast<size_t>(-1); // 探测链上第一个墓碑或已过期的槽
+    bool existing = false;
+    for (size_t n = 0, index = id.low & mask; n < slotCount_; ++n, index = (index + 1) & mask)
+    {
+        // 写者持锁，槽内容不会被并发修改，可以直接读取
+        const SlotData* cur = reinterpret_cast<const SlotData*>(slotAt(index) + 8);
+        if (cur->state == kEmpty)
+        {
+            target = reusable != static_cast<size_t>(-1) ? reusable : index;
+            break;
+        }
+        if (cur->state == kFull && cur->high == id.high && cur->low == id.low)
+        {
+            target = index;
+            existing = true;
+            break;
+        }
+        if (reusable == static_cast<size_t>(-1) &&
+            (cur->state == kTombstone || cur->expiresAt <= now))
+        {
+            reusable = index;
+        }
+    }
+    if (target == static_cast<size_t>(-1))
+    {
+        target = reusable; // 没有空槽，只能复用墓碑或过期会话
+    }
+    if (target == static_cast<size_t>(-1))
+    {
+        LOG_ERROR << "Shared session store " << config_.name << " is full, session not saved";
+        return;
+    }
+
+    uint32_t previous = reinterpret_cast<const SlotData*>(slotAt(target) + 8)->state;
+    writeSlot(target, data, payload);
+    if (!existing && previous != kFull)
+    {
+        header_->used.fetch_add(1, std::memory_order_relaxed);
+        if (previous == kTombstone)
+        {
+            --header_->tombstones;
+        }
+    }
+}
+
+std::shared_ptr<Session> SharedMemorySessionStorage::load(const std::string& sessionId)
+{
+    BinarySessionId id;
+    if (!SessionIdGenerator::decode(sessionId, &id))
+    {
+        return nullptr;
+    }
+
+    SlotData data;
+    std::string payload;
+    bool found = false;
+    size_t mask = slotCount_ - 1;
+    for (;;)
+    {
+        uint64_t epoch = header_->epoch.load(std::memory_order_acquire);
+        if (epoch & 1)
+        {
+            sched_yield(); // 其它进程正在重建哈希表
+            continue;
+        }
+
+        found = false;
+        for (size_t n = 0, index = id.low & mask; n < slotCount_; ++n, index = (index + 1) & mask)
+        {
+            if (readSlot(index, id, &data, &payload))
+            {
+                found = true;
+                break;
+            }
+            if (data.state == kEmpty)
+            {
+                break;
+            }
+        }
+
+        // 探测期间发生过重建，槽位可能已经移动，重新查找
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (header_->epoch.load(std::memory_order_relaxed) == epoch)
+        {
+            break;
+        }
+    }
+
+    if (!found || data.expiresAt <= nowSecond())
+    {
+        return nullptr;
+    }
+
+    SessionData values;
+    if (!decodeData(payload, &values))
+    {
+        LOG_ERROR << "Corrupted session in shared store: " << sessionId;
+        return nullptr;
+    }
+    auto session = std::make_shared<Session>(sessionId, nullptr, data.maxAge);
+    session->restore(std::move(values),
+                     std::chrono::system_clock::time_point(std::chrono::seconds(data.expiresAt)));
+    return session;
+}
+
+void SharedMemorySessionStorage::remove(const std::string& sessionId)
+{
+    BinarySessionId id;
+    if (!SessionIdGenerator::decode(sessionId, &id))
+    {
+        return;
+    }
+
+    WriteLock lock(this);
+    size_t mask = slotCount_ - 1;
+    for (size_t n = 0, index = id.low & mask; n < slotCount_; ++n, index = (index + 1) & mask)
+    {
+        const SlotData* cur = reinterpret_cast<const SlotData*>(slotAt(index) + 8);
+        if (cur->state == kEmpty)
+        {
+            return;
+        }
+        if (cur->state == kFull && cur->high == id.high && cur->low == id.low)
+        {
+            // 留下墓碑，不中断其它会话的探测链
+            writeSlot(index, SlotData{kTombstone, 0, id.high, id.low, 0, 0, 0}, std::string());
+            header_->used.fetch_sub(1, std::memory_order_relaxed);
+            ++header_->tombstones;
+            return;
+        }
+    }
+}
+
+// 各进程共用一个扫描位置，每次最多检查 maxCount 个槽；墓碑超过四分之一时重建哈希表
+size_t SharedMemorySessionStorage::cleanExpired(size_t maxCount)
+{
+    int64_t now = nowSecond();
+    size_t removed = 0;
+    WriteLock lock(this);
+    size_t count = std::min(maxCount, slotCount_);
+    for (size_t n = 0; n < count; ++n)
+    {
+        size_t index = header_->cleanCursor;
+        header_->cleanCursor = (index + 1) & (slotCount_ - 1);
+        const SlotData* cur = reinterpret_cast<const SlotData*>(slotAt(index) + 8);
+        if (cur->state == kFull && cur->expiresAt <= now)
+        {
+            writeSlot(index, SlotData{kTombstone, 0, cur->high, cur->low, 0, 0, 0}, std::string());
+            header_->used.fetch_sub(1, std::memory_order_relaxed);
+            ++header_->tombstones;
+            ++removed;
+        }
+    }
+
+    if (header_->tombstones * 4 > slotCount_)
+    {
+        rebuild();
+    }
+    return removed;
+}
+
+size_t SharedMemorySessionStorage::size() const
+{
+    return header_->used.load(std::memory_order_relaxed);
+}
+
+void SharedMemorySessionStorage::unlink(const std::string& name)
+{
+    ::shm_unlink(name.c_str());
+}
+
+char* SharedMemorySessionStorage::slotAt(size_t index) const
+{
+    return base_ + roundUp(sizeof(Header), kCacheLine) + index * slotBytes_;
+}
+
+// 序列锁读：序列号为偶数且读取前后一致时数据有效，否则重试
+// 返回槽中是否为 id 对应的会话，是则同时拷贝出会话数据
+bool SharedMemorySessionStorage::readSlot(size_t index, const BinarySessionId& id,
+                                          SlotData* data, std::string* payload) const
+{
+    char* slot = slotAt(index);
+    std::atomic<uint32_t>& seq = slotSeq(slot);
+    size_t maxPayload = slotBytes_ - kSlotHeaderBytes;
+    for (;;)
+    {
+        uint32_t before = seq.load(std::memory_order_acquire);
+        if (before & 1)
+        {
+            sched_yield();
+            continue;
+        }
+
+        memcpy(data, slot + 8, sizeof(SlotData));
+        bool match = data->state == kFull && data->high == id.high && data->low == id.low;
+        if (match)
+        {
+            // 长度可能读到写入中的值，先限定范围，校验序列号后才使用
+            payload->assign(slot + kSlotHeaderBytes, std::min<size_t>(data->length, maxPayload));
+        }
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (seq.load(std::memory_order_relaxed) == before)
+        {
+            return match;
+        }
+    }
+}
+
+void SharedMemorySessionStorage::writeSlot(size_t index, const SlotData& data, const std::string& payload)
+{
+    char* slot = slotAt(index);
+    std::atomic<uint32_t>& seq = slotSeq(slot);
+    header_->writingSlot = static_cast<int64_t>(index);
+
+    uint32_t current = seq.load(std::memory_order_relaxed);
+    seq.store(current + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(slot + 8, &data, sizeof(SlotData));
+    if (!payload.empty())
+    {
+        memcpy(slot + kSlotHeaderBytes, payload.data(), payload.size());
+    }
+    seq.store(current + 2, std::memory_order_release);
+
+    header_->writingSlot = -1;
+}
+
+// 原地重建：取出所有有效会话，清空后重新插入，消除墓碑
+void SharedMemorySessionStorage::rebuild()
+{
+    auto start = std::chrono::steady_clock::now();
+    header_->rebuilding = 1;
+    header_->epoch.fetch_add(1, std::memory_order_acq_rel);
+
+    int64_t now = nowSecond();
+    std::vector<std::pair<SlotData, std::string>> live;
+    live.reserve(header_->used.load(std::memory_order_relaxed));
+    for (size_t index = 0; index < slotCount_; ++index)
+    {
+        char* slot = slotAt(index);
+        const SlotData* cur = reinterpret_cast<const SlotData*>(slot + 8);
+        if (cur->state == kFull && cur->expiresAt > now)
+        {
+            live.emplace_back(*cur, std::string(slot + kSlotHeaderBytes, cur->length));
+        }
+        if (cur->state != kEmpty)
+        {
+            writeSlot(index, SlotData{kEmpty, 0, 0, 0, 0, 0, 0}, std::string());
+        }
+    }
+
+    size_t mask = slotCount_ - 1;
+    for (const auto& entry : live)
+    {
+        size_t index = entry.first.low & mask;
+        while (reinterpret_cast<const SlotData*>(slotAt(index) + 8)->state != kEmpty)
+        {
+            index = (index + 1) & mask;
+        }
+        writeSlot(index, entry.first, entry.second);
+    }
+
+    header_->used.store(live.size(), std::memory_order_relaxed);
+    header_->tombstones = 0;
+    header_->epoch.fetch_add(1, std::memory_order_acq_rel);
+    header_->rebuilding = 0;
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    LOG_INFO << "Rebuilt shared session store " << config_.name << ": " << live.size()
+             << " sessions in " << ms << "ms";
+}
+
+void SharedMemorySessionStorage::recover()
+{
+    if (header_->rebuilding)
+    {
+        // 重建中途崩溃，被取出的会话只存在于崩溃进程的内存中，无法恢复，清空以保证一致
+        LOG_ERROR << "Writer died while rebuilding shared session store " << config_.name
+                  << ", all sessions are discarded";
+        for (size_t index = 0; index < slotCount_; ++index)
+        {
+            char* slot = slotAt(index);
+            uint32_t seq = slotSeq(slot).load(std::memory_order_relaxed);
+            slotSeq(slot).store(seq + (seq & 1) + 2, std::memory_order_relaxed);
+            memset(slot + 8, 0, sizeof(SlotData));
+        }
+        if (header_->epoch.load(std::memory_order_relaxed) & 1)
+        {
+            header_->epoch.fetch_add(1, std::memory_order_release);
+        }
+        header_->rebuilding = 0;
+    }
+    else if (header_->writingSlot >= 0)
+    {
+        // 写到一半的槽内容不可信，改为墓碑
+        char* slot = slotAt(static_cast<size_t>(header_->writingSlot));
+        SlotData* cur = reinterpret_cast<SlotData*>(slot + 8);
+        cur->state = kTombstone;
+        cur->length = 0;
+        uint32_t seq = slotSeq(slot).load(std::memory_order_relaxed);
+        slotSeq(slot).store(seq + (seq & 1), std::memory_order_release);
+    }
+    header_->writingSlot = -1;
+
+    // 计数可能在崩溃时未更新，重新统计
+    uint64_t used = 0, tombstones = 0;
+    for (size_t index = 0; index < slotCount_; ++index)
+    {
+        uint32_t state = reinterpret_cast<const SlotData*>(slotAt(index) + 8)->state;
+        used += state == kFull;
+        tombstones += state == kTombstone;
+    }
+    header_->used.store(used, std::memory_order_relaxed);
+    header_->tombstones = tombstones;
+}
+
+} // namespace session
+} // namespace http
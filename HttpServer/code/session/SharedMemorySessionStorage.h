@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "SessionStorage.h"
+
+namespace http
+{
+namespace session
+{
+
+struct SharedMemorySessionStorageConfig
+{
+    std::string name = "/http_sessions"; // shm_open 使用的名称，同一台机器上的进程用相同名称共享会话
+    size_t      capacity = 65536; // 槽数，向上取整为 2 的幂；所有进程必须一致
+    size_t      slotBytes = 1024; // 每个槽的字节数（含槽头），序列化后放不下的会话无法保存；所有进程必须一致
+    int         attachTimeoutMs = 5000; // 等待其它进程完成段初始化的最长时间
+};
+
+// 基于共享内存的会话存储，同一台机器上的多个工作进程（如 SO_REUSEPORT 部署）共享会话
+// 段由第一个进程创建，其余进程直接映射；段在进程退出后仍然存在，单个进程重启不会丢失会话
+// 段内是一张定长槽位的开放寻址哈希表（线性探测，删除留墓碑），以 16 字节二进制 ID 为键：
+//   读：每个槽一个序列锁（seqlock），读者无锁，读到写入中的槽时重试
+//   写：所有进程串行化在段内一把进程间共享的健壮互斥锁上（会话以读为主，写入只是一次 memcpy）；
+//       持锁进程崩溃时，下一个加锁者会修复写到一半的槽
+// 墓碑过多时由 cleanExpired 原地重建哈希表，期间读者等待
+class SharedMemorySessionStorage : public SessionStorage
+{
+public:
+    explicit SharedMemorySessionStorage(const SharedMemorySessionStorageConfig& config = SharedMemorySessionStorageConfig());
+    ~SharedMemorySessionStorage() override;
+
+    SharedMemorySessionStorage(const SharedMemorySessionStorage&) = delete;
+    SharedMemorySessionStorage& operator=(const SharedMemorySessionStorage&) = delete;
+
+    void save(std::shared_ptr<Session> session) override;
+    std::shared_ptr<Session> load(const std::string& sessionId) override;
+    void remove(const std::string& sessionId) override;
+    size_t cleanExpired(size_t maxCount) override;
+
+    // 已占用的槽数（不加锁，仅供监控使用）
+    size_t size() const;
+
+    // 删除共享内存段，已映射的进程不受影响，之后启动的进程会创建新的空段
+    static void unlink(const std::string& name);
+
+private:
+    struct Header;
+    struct SlotData;
+    class WriteLock;
+
+    enum SlotState : uint32_t
+    {
+        kEmpty = 0,
+        kFull = 1,
+        kTombstone = 2,
+    };
+
+    char* slotAt(size_t index) const;
+    bool readSlot(size_t index, const BinarySessionId& id, SlotData* data, std::string* payload) const;
+    void writeSlot(size_t index, const SlotData& data, const std::string& payload);
+    void rebuild(); // 调用方持有写锁
+    void recover(); // 持锁进程崩溃后修复，调用方持有写锁
+    void attach();
+
+private:
+    SharedMemorySessionStorageConfig config_;
+    size_t                           slotCount_;
+    size_t                           slotBytes_;
+    size_t                           mappedBytes_;
+    int                              fd_;
+    char*                            base_; // 映射的起始地址
+    Header*                          header_;
+};
+
+} // namespace session
+} // namespace http
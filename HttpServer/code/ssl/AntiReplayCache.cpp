@@ -0,0 +1,51 @@
+#include "AntiReplayCache.h"
+#include <muduo/base/Logging.h>
+
+namespace ssl
+{
+
+AntiReplayCache::AntiReplayCache(size_t capacity)
+    : capacity_(capacity)
+    , replays_(0)
+{
+}
+
+bool AntiReplayCache::insert(const unsigned char* clientRandom, size_t len)
+{
+    std::string key(reinterpret_cast<const char*>(clientRandom), len);
+    muduo::Timestamp now = muduo::Timestamp::now();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    expire(now);
+    if (seen_.count(key))
+    {
+        ++replays_;
+        LOG_WARN << "Replayed TLS early data rejected";
+        return false;
+    }
+    if (seen_.size() >= capacity_)
+    {
+        // 记不下就无法识别之后的重放，宁可放弃这次 0-RTT
+        return false;
+    }
+    seen_.insert(key);
+    order_.emplace_back(now, std::move(key));
+    return true;
+}
+
+uint64_t AntiReplayCache::replays() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return replays_;
+}
+
+void AntiReplayCache::expire(muduo::Timestamp now)
+{
+    while (!order_.empty() && muduo::timeDifference(now, order_.front().first) > kWindowSecs)
+    {
+        seen_.erase(order_.front().second);
+        order_.pop_front();
+    }
+}
+
+} // namespace ssl
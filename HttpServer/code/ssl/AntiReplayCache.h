@@ -0,0 +1,45 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <muduo/base/noncopyable.h>
+#include <muduo/base/Timestamp.h>
+
+namespace ssl
+{
+
+// TLS 1.3 0-RTT 的防重放缓存（RFC 8446 8.2/8.3：记录 ClientHello + 新鲜度检查）
+// 重放的 ClientHello 与原始的完全相同（改动任何字节都会使 PSK binder 校验失败），按客户端随机数去重；
+// OpenSSL 只在客户端报告的票据年龄与服务端计算的年龄相差不超过 10 秒时接受早期数据，
+// 因此只需记住最近一个窗口内的随机数，更早的重放会被 OpenSSL 自己拒绝
+// 缓存只在本进程内有效，多个工作进程时重放到其它进程的早期数据无法识别，0-RTT 只应用于幂等请求
+class AntiReplayCache : muduo::noncopyable
+{
+public:
+    static constexpr double kWindowSecs = 12.0; // OpenSSL 的票据年龄容差（10 秒）加余量
+
+    // capacity 为窗口内最多记录的 ClientHello 数
+    explicit AntiReplayCache(size_t capacity);
+
+    // 记录一次带早期数据的 ClientHello，返回是否可以接受其早期数据
+    // 窗口内见过同一随机数（重放）或缓存已满（无法判断）时返回 false，连接退回 1-RTT 握手
+    bool insert(const unsigned char* clientRandom, size_t len);
+
+    uint64_t replays() const;
+
+private:
+    void expire(muduo::Timestamp now);
+
+private:
+    size_t                                                capacity_;
+    mutable std::mutex                                    mutex_;
+    std::unordered_set<std::string>                       seen_; // 窗口内的客户端随机数
+    std::deque<std::pair<muduo::Timestamp, std::string>>  order_; // 按记录时间排列，用于过期淘汰
+    uint64_t                                              replays_; // 识别出的重放次数
+};
+
+} // namespace ssl
@@ -0,0 +1,332 @@
+#include "CertificateStore.h"
+#include <muduo/base/Logging.h>
+#include <openssl/err.h>
+#include <openssl/pem.h>
+#include <openssl/x509v3.h>
+
+#include <sys/stat.h>
+#include <algorithm>
+#include <cctype>
+
+namespace ssl
+{
+
+namespace
+{
+
+std::string toLower(std::string s)
+{
+    std::transform(s.begin(), s.end(), s.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return s;
+}
+
+void logSslError(const std::string& msg)
+{
+    char buf[256];
+    ERR_error_string_n(ERR_get_error(), buf, sizeof(buf));
+    LOG_ERROR << msg << ": " << buf;
+}
+
+// 读出 PEM 文件中的所有证书并追加到 certs，文件中没有证书或 PEM 内容损坏时返回 false（certs 不变）
+bool readCertificates(const std::string& path, std::vector<X509*>* certs)
+{
+    BIO* bio = BIO_new_file(path.c_str(), "r");
+    if (!bio)
+    {
+        return false;
+    }
+    std::vector<X509*> read;
+    while (X509* cert = PEM_read_bio_X509(bio, nullptr, nullptr, nullptr))
+    {
+        read.push_back(cert);
+    }
+    BIO_free(bio);
+    // 正常读到文件末尾只会留下一个 "no start line" 错误，其它错误说明中间有损坏的证书
+    unsigned long err = ERR_peek_last_error();
+    if (read.empty() || ERR_GET_LIB(err) != ERR_LIB_PEM || ERR_GET_REASON(err) != PEM_R_NO_START_LINE)
+    {
+        for (X509* cert : read) X509_free(cert);
+        return false;
+    }
+    ERR_clear_error();
+    certs->insert(certs->end(), read.begin(), read.end());
+    return true;
+}
+
+} // namespace
+
+CertificateStore::Snapshot::~Snapshot()
+{
+    for (Certificate& c : certificates)
+    {
+        X509_free(c.cert);
+        EVP_PKEY_free(c.key);
+        sk_X509_pop_free(c.chain, X509_free);
+    }
+}
+
+CertificateStore::CertificateStore(const SslConfig& config)
+{
+    if (!config.getCertificateFile().empty())
+    {
+        CertificateFiles primary;
+        primary.certFile = config.getCertificateFile();
+        primary.keyFile = config.getPrivateKeyFile();
+        primary.chainFile = config.getCertificateChainFile();
+        files_.push_back(primary);
+    }
+    files_.insert(files_.end(), config.getCertificates().begin(), config.getCertificates().end());
+}
+
+bool CertificateStore::reload()
+{
+    if (files_.empty())
+    {
+        LOG_ERROR << "No certificate configured";
+        return false;
+    }
+
+    // 先记下文件状态再读取，读取期间文件又被修改时下次检查还会重新加载
+    std::vector<FileStamp> stamps = stampFiles();
+
+    auto snapshot = std::make_shared<Snapshot>();
+    std::string defaultName;
+    for (size_t i = 0; i < files_.size(); ++i)
+    {
+        Certificate cert;
+        if (!loadCertificate(files_[i], &cert))
+        {
+            stamps_ = stamps; // 同一份坏文件不重复尝试
+            return false;
+        }
+        snapshot->certificates.push_back(cert);
+
+        std::vector<std::string> names;
+        certificateNames(cert.cert, &names);
+        for (const std::string& name : names)
+        {
+            if (name.compare(0, 2, "*.") == 0)
+            {
+                snapshot->wildcard[name.substr(2)].push_back(i);
+            }
+            else
+            {
+                snapshot->exact[name].push_back(i);
+            }
+        }
+
+        // 默认组为默认证书第一个域名的证书组，同一域名的 ECDSA/RSA 证书一起作为默认证书
+        if (i == 0 && !names.empty())
+        {
+            defaultName = names.front();
+        }
+    }
+
+    const Group* defaultGroup = nullptr;
+    if (defaultName.compare(0, 2, "*.") == 0)
+    {
+        defaultGroup = &snapshot->wildcard[defaultName.substr(2)];
+    }
+    else if (!defaultName.empty())
+    {
+        defaultGroup = &snapshot->exact[defaultName];
+    }
+    snapshot->defaultGroup = defaultGroup ? *defaultGroup : Group{ 0 };
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        snapshot_ = std::move(snapshot);
+    }
+    stamps_ = std::move(stamps);
+    LOG_INFO << "Loaded " << files_.size() << " certificate(s)";
+    return true;
+}
+
+bool CertificateStore::reloadIfChanged()
+{
+    std::vector<FileStamp> stamps = stampFiles();
+    bool changed = stamps.size() != stamps_.size();
+    for (size_t i = 0; !changed && i < stamps.size(); ++i)
+    {
+        changed = stamps[i].mtime != stamps_[i].mtime || stamps[i].size != stamps_[i].size;
+    }
+    if (!changed)
+    {
+        return false;
+    }
+
+    LOG_INFO << "Certificate files changed, reloading";
+    return reload();
+}
+
+void CertificateStore::install(SSL_CTX* ctx)
+{
+    // 没有发送 SNI 时 OpenSSL 也会调用该回调，默认证书同样在这里装入
+    SSL_CTX_set_tlsext_servername_callback(ctx, serverNameCallback);
+    SSL_CTX_set_tlsext_servername_arg(ctx, this);
+}
+
+std::shared_ptr<const CertificateStore::Snapshot> CertificateStore::current() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return snapshot_;
+}
+
+std::vector<CertificateStore::FileStamp> CertificateStore::stampFiles() const
+{
+    std::vector<FileStamp> stamps;
+    for (const CertificateFiles& files : files_)
+    {
+        for (const std::string* path : { &files.certFile, &files.keyFile, &files.chainFile })
+        {
+            if (path->empty())
+            {
+                continue;
+            }
+            FileStamp stamp = { *path, 0, -1 };
+            struct stat st;
+            if (::stat(path->c_str(), &st) == 0)
+            {
+                stamp.mtime = st.st_mtime;
+                stamp.size = st.st_size;
+            }
+            stamps.push_back(stamp);
+        }
+    }
+    return stamps;
+}
+
+const CertificateStore::Group& CertificateStore::select(const Snapshot& snapshot, const char* serverName)
+{
+    if (!serverName)
+    {
+        return snapshot.defaultGroup;
+    }
+
+    std::string name = toLower(serverName);
+    auto it = snapshot.exact.find(name);
+    if (it != snapshot.exact.end())
+    {
+        return it->second;
+    }
+
+    // 通配符只匹配一级子域名
+    size_t dot = name.find('.');
+    if (dot != std::string::npos)
+    {
+        it = snapshot.wildcard.find(name.substr(dot + 1));
+        if (it != snapshot.wildcard.end())
+        {
+            return it->second;
+        }
+    }
+    return snapshot.defaultGroup;
+}
+
+bool CertificateStore::loadCertificate(const CertificateFiles& files, Certificate* out)
+{
+    // 证书文件中第一张为服务器证书，其后的证书和证书链文件中的证书都作为中间证书
+    // 指定了证书链文件时其中必须至少有一张证书，否则发出的证书链不完整
+    std::vector<X509*> certs;
+    if (!readCertificates(files.certFile, &certs))
+    {
+        logSslError("Failed to load certificate " + files.certFile);
+        return false;
+    }
+    if (!files.chainFile.empty() && !readCertificates(files.chainFile, &certs))
+    {
+        logSslError("Failed to load certificate chain " + files.chainFile);
+        for (X509* cert : certs) X509_free(cert);
+        return false;
+    }
+
+    out->cert = certs[0];
+    out->chain = sk_X509_new_null();
+    for (size_t i = 1; i < certs.size(); ++i)
+    {
+        sk_X509_push(out->chain, certs[i]);
+    }
+
+    BIO* bio = BIO_new_file(files.keyFile.c_str(), "r");
+    out->key = bio ? PEM_read_bio_PrivateKey(bio, nullptr, nullptr, nullptr) : nullptr;
+    BIO_free(bio);
+    if (!out->key)
+    {
+        logSslError("Failed to load private key " + files.keyFile);
+    }
+    else if (X509_check_private_key(out->cert, out->key) != 1)
+    {
+        logSslError("Private key " + files.keyFile + " does not match certificate " + files.certFile);
+    }
+    else
+    {
+        return true;
+    }
+
+    X509_free(out->cert);
+    EVP_PKEY_free(out->key);
+    sk_X509_pop_free(out->chain, X509_free);
+    *out = Certificate();
+    return false;
+}
+
+void CertificateStore::certificateNames(X509* cert, std::vector<std::string>* names)
+{
+    GENERAL_NAMES* altNames = static_cast<GENERAL_NAMES*>(
+        X509_get_ext_d2i(cert, NID_subject_alt_name, nullptr, nullptr));
+    if (altNames)
+    {
+        for (int i = 0; i < sk_GENERAL_NAME_num(altNames); ++i)
+        {
+            const GENERAL_NAME* name = sk_GENERAL_NAME_value(altNames, i);
+            if (name->type == GEN_DNS)
+            {
+                const ASN1_IA5STRING* dns = name->d.dNSName;
+                names->push_back(toLower(std::string(reinterpret_cast<const char*>(ASN1_STRING_get0_data(dns)),
+                                                     ASN1_STRING_length(dns))));
+            }
+        }
+        GENERAL_NAMES_free(altNames);
+        if (!names->empty())
+        {
+            return;
+        }
+    }
+
+    // 没有 SAN 时退回到 CN
+    X509_NAME* subject = X509_get_subject_name(cert);
+    int index = X509_NAME_get_index_by_NID(subject, NID_commonName, -1);
+    if (index >= 0)
+    {
+        ASN1_STRING* cn = X509_NAME_ENTRY_get_data(X509_NAME_get_entry(subject, index));
+        names->push_back(toLower(std::string(reinterpret_cast<const char*>(ASN1_STRING_get0_data(cn)),
+                                             ASN1_STRING_length(cn))));
+    }
+}
+
+int CertificateStore::serverNameCallback(SSL* ssl, int* alert, void* arg)
+{
+    CertificateStore* store = static_cast<CertificateStore*>(arg);
+    // 持有快照直到证书装入连接（装入时增加引用计数），期间重新加载也不会释放这些证书
+    std::shared_ptr<const Snapshot> snapshot = store->current();
+    if (!snapshot)
+    {
+        *alert = SSL_AD_INTERNAL_ERROR;
+        return SSL_TLSEXT_ERR_ALERT_FATAL;
+    }
+
+    for (size_t index : select(*snapshot, SSL_get_servername(ssl, TLSEXT_NAMETYPE_host_name)))
+    {
+        const Certificate& c = snapshot->certificates[index];
+        if (SSL_use_cert_and_key(ssl, c.cert, c.key, c.chain, 1) != 1)
+        {
+            logSslError("Failed to use certificate");
+            *alert = SSL_AD_INTERNAL_ERROR;
+            return SSL_TLSEXT_ERR_ALERT_FATAL;
+        }
+    }
+    return SSL_TLSEXT_ERR_OK;
+}
+
+} // namespace ssl
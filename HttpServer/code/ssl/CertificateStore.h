@@ -0,0 +1,78 @@
+#pragma once
+#include "SslConfig.h"
+#include <openssl/ssl.h>
+#include <sys/types.h>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <muduo/base/noncopyable.h>
+
+namespace ssl
+{
+
+// 证书集合，按 SNI 选择证书，支持不断连接的热加载
+// 证书的域名取自证书本身（SAN 中的 DNS 名称，没有 SAN 时取 CN）；覆盖同一域名的多张证书
+// （如 ECDSA 和 RSA 各一张）同时装入连接，由 OpenSSL 按客户端支持的签名算法和服务端偏好选择，
+// 客户端支持时优先 ECDSA；没有发送 SNI 或没有匹配的域名时使用默认证书（配置中的第一张）
+// 握手时只替换连接自己的证书和私钥，SSL_CTX 上的会话票据、会话缓存等设置保持不变
+// 加载结果是一份不可变快照，重新加载成功后原子替换，已经在握手中的连接持有证书的引用，不受影响
+class CertificateStore : muduo::noncopyable
+{
+public:
+    explicit CertificateStore(const SslConfig& config);
+
+    // 加载全部证书，任一证书无效时返回 false，原有证书保持不变
+    bool reload();
+
+    // 证书文件有变化时重新加载，返回是否发生了替换
+    bool reloadIfChanged();
+
+    // 注册 SNI 回调，握手时为连接装入对应域名的证书
+    void install(SSL_CTX* ctx);
+
+private:
+    struct Certificate
+    {
+        X509*           cert = nullptr;
+        EVP_PKEY*       key = nullptr;
+        STACK_OF(X509)* chain = nullptr; // 中间证书
+    };
+
+    using Group = std::vector<size_t>; // 同一域名的证书在 certificates 中的下标
+
+    // 一次加载的结果
+    struct Snapshot
+    {
+        ~Snapshot();
+
+        std::vector<Certificate>               certificates;
+        Group                                  defaultGroup;
+        std::unordered_map<std::string, Group> exact; // 精确域名（小写）
+        std::unordered_map<std::string, Group> wildcard; // "*.example.com" 存为 "example.com"
+    };
+
+    struct FileStamp
+    {
+        std::string path;
+        time_t      mtime;
+        off_t       size;
+    };
+
+    std::shared_ptr<const Snapshot> current() const;
+    std::vector<FileStamp> stampFiles() const;
+    static const Group& select(const Snapshot& snapshot, const char* serverName);
+    static bool loadCertificate(const CertificateFiles& files, Certificate* out);
+    static void certificateNames(X509* cert, std::vector<std::string>* names);
+    static int serverNameCallback(SSL* ssl, int* alert, void* arg);
+
+private:
+    std::vector<CertificateFiles>   files_; // 第一个为默认证书
+    mutable std::mutex              mutex_; // 保护 snapshot_ 的替换
+    std::shared_ptr<const Snapshot> snapshot_;
+    std::vector<FileStamp>          stamps_; // 最近一次加载时的文件状态
+};
+
+} // namespace ssl
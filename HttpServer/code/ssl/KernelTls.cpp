@@ -0,0 +1,299 @@
+#include "KernelTls.h"
+#include <muduo/base/Logging.h>
+#include <muduo/net/InetAddress.h>
+#include <openssl/evp.h>
+#include <openssl/kdf.h>
+
+#include <dirent.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <linux/tls.h>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#ifndef SOL_TLS
+#define SOL_TLS 282
+#endif
+
+namespace ssl
+{
+
+namespace
+{
+
+const char kServerTrafficSecretLabel[] = "SERVER_TRAFFIC_SECRET_0 ";
+
+int hexValue(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// TLS 1.3 的 HKDF-Expand-Label(secret, label, "", length)
+bool expandLabel(const EVP_MD* md, const std::string& secret, const char* label,
+                 unsigned char* out, size_t length)
+{
+    // HkdfLabel = uint16 length | uint8 len("tls13 " + label) | "tls13 " + label | uint8 0
+    std::string fullLabel = std::string("tls13 ") + label;
+    std::string info;
+    info.push_back(static_cast<char>(length >> 8));
+    info.push_back(static_cast<char>(length & 0xff));
+    info.push_back(static_cast<char>(fullLabel.size()));
+    info += fullLabel;
+    info.push_back(0);
+
+    EVP_PKEY_CTX* pctx = EVP_PKEY_CTX_new_id(EVP_PKEY_HKDF, nullptr);
+    bool ok = pctx
+        && EVP_PKEY_derive_init(pctx) > 0
+        && EVP_PKEY_CTX_hkdf_mode(pctx, EVP_PKEY_HKDEF_MODE_EXPAND_ONLY) > 0
+        && EVP_PKEY_CTX_set_hkdf_md(pctx, md) > 0
+        && EVP_PKEY_CTX_set1_hkdf_key(pctx, reinterpret_cast<const unsigned char*>(secret.data()),
+                                      static_cast<int>(secret.size())) > 0
+        && EVP_PKEY_CTX_add1_hkdf_info(pctx, reinterpret_cast<const unsigned char*>(info.data()),
+                                       static_cast<int>(info.size())) > 0
+        && EVP_PKEY_derive(pctx, out, &length) > 0;
+    EVP_PKEY_CTX_free(pctx);
+    return ok;
+}
+
+// TLS 1.2 的 key_block = PRF(master_secret, "key expansion", server_random + client_random)
+bool keyExpansion(SSL* ssl, const EVP_MD* md, unsigned char* out, size_t length)
+{
+    unsigned char master[SSL_MAX_MASTER_KEY_LENGTH];
+    size_t masterLen = SSL_SESSION_get_master_key(SSL_get_session(ssl), master, sizeof(master));
+    unsigned char seed[13 + 2 * SSL3_RANDOM_SIZE];
+    memcpy(seed, "key expansion", 13);
+    SSL_get_server_random(ssl, seed + 13, SSL3_RANDOM_SIZE);
+    SSL_get_client_random(ssl, seed + 13 + SSL3_RANDOM_SIZE, SSL3_RANDOM_SIZE);
+
+    EVP_PKEY_CTX* pctx = EVP_PKEY_CTX_new_id(EVP_PKEY_TLS1_PRF, nullptr);
+    bool ok = masterLen > 0 && pctx
+        && EVP_PKEY_derive_init(pctx) > 0
+        && EVP_PKEY_CTX_set_tls1_prf_md(pctx, md) > 0
+        && EVP_PKEY_CTX_set1_tls1_prf_secret(pctx, master, static_cast<int>(masterLen)) > 0
+        && EVP_PKEY_CTX_add1_tls1_prf_seed(pctx, seed, sizeof(seed)) > 0
+        && EVP_PKEY_derive(pctx, out, &length) > 0;
+    EVP_PKEY_CTX_free(pctx);
+    OPENSSL_cleanse(master, sizeof(master));
+    return ok;
+}
+
+bool sameAddress(const struct sockaddr_storage& a, const struct sockaddr* b)
+{
+    if (a.ss_family != b->sa_family)
+    {
+        return false;
+    }
+    if (a.ss_family == AF_INET)
+    {
+        const sockaddr_in* x = reinterpret_cast<const sockaddr_in*>(&a);
+        const sockaddr_in* y = reinterpret_cast<const sockaddr_in*>(b);
+        return x->sin_port == y->sin_port && x->sin_addr.s_addr == y->sin_addr.s_addr;
+    }
+    if (a.ss_family == AF_INET6)
+    {
+        const sockaddr_in6* x = reinterpret_cast<const sockaddr_in6*>(&a);
+        const sockaddr_in6* y = reinterpret_cast<const sockaddr_in6*>(b);
+        return x->sin6_port == y->sin6_port
+            && memcmp(&x->sin6_addr, &y->sin6_addr, sizeof(x->sin6_addr)) == 0;
+    }
+    return false;
+}
+
+} // namespace
+
+bool KernelTls::parseServerTrafficSecret(const char* line, std::string* secret)
+{
+    // 格式：SERVER_TRAFFIC_SECRET_0 <client_random 十六进制> <secret 十六进制>
+    if (strncmp(line, kServerTrafficSecretLabel, sizeof(kServerTrafficSecretLabel) - 1) != 0)
+    {
+        return false;
+    }
+    const char* hex = strchr(line + sizeof(kServerTrafficSecretLabel) - 1, ' ');
+    if (!hex)
+    {
+        return false;
+    }
+    ++hex;
+
+    secret->clear();
+    for (; hex[0] && hex[1]; hex += 2)
+    {
+        int hi = hexValue(hex[0]);
+        int lo = hexValue(hex[1]);
+        if (hi < 0 || lo < 0)
+        {
+            return false;
+        }
+        secret->push_back(static_cast<char>(hi << 4 | lo));
+    }
+    return !secret->empty();
+}
+
+bool KernelTls::deriveTxKey(SSL* ssl, const std::string& trafficSecret, TxKey* out)
+{
+    const SSL_CIPHER* cipher = SSL_get_current_cipher(ssl);
+    if (!cipher)
+    {
+        return false;
+    }
+    const EVP_MD* md = SSL_CIPHER_get_handshake_digest(cipher);
+    out->version = SSL_version(ssl);
+    out->cipherNid = SSL_CIPHER_get_cipher_nid(cipher);
+
+    size_t fixedIvLen; // TLS 1.2 中由 key_block 导出的 IV 长度
+    switch (out->cipherNid)
+    {
+        case NID_aes_128_gcm:
+            out->keyLen = 16;
+            fixedIvLen = 4;
+            break;
+        case NID_aes_256_gcm:
+            out->keyLen = 32;
+            fixedIvLen = 4;
+            break;
+        case NID_chacha20_poly1305:
+            out->keyLen = 32;
+            fixedIvLen = 12;
+            break;
+        default:
+            return false;
+    }
+
+    if (out->version == TLS1_3_VERSION)
+    {
+        out->ivLen = 12;
+        return !trafficSecret.empty()
+            && expandLabel(md, trafficSecret, "key", out->key, out->keyLen)
+            && expandLabel(md, trafficSecret, "iv", out->iv, out->ivLen);
+    }
+    if (out->version == TLS1_2_VERSION)
+    {
+        // AEAD 套件没有 MAC 密钥：client_key | server_key | client_iv | server_iv
+        unsigned char block[2 * 32 + 2 * 12];
+        size_t blockLen = 2 * out->keyLen + 2 * fixedIvLen;
+        if (!keyExpansion(ssl, md, block, blockLen))
+        {
+            return false;
+        }
+        memcpy(out->key, block + out->keyLen, out->keyLen);
+        memcpy(out->iv, block + 2 * out->keyLen + fixedIvLen, fixedIvLen);
+        out->ivLen = fixedIvLen;
+        OPENSSL_cleanse(block, sizeof(block));
+        return true;
+    }
+    return false;
+}
+
+bool KernelTls::install(int fd, const TxKey& key, uint64_t seq)
+{
+    unsigned char recSeq[8];
+    for (int i = 7; i >= 0; --i)
+    {
+        recSeq[i] = static_cast<unsigned char>(seq & 0xff);
+        seq >>= 8;
+    }
+
+    union
+    {
+        struct tls12_crypto_info_aes_gcm_128        gcm128;
+        struct tls12_crypto_info_aes_gcm_256        gcm256;
+        struct tls12_crypto_info_chacha20_poly1305  chacha;
+    } info;
+    memset(&info, 0, sizeof(info));
+    socklen_t infoLen;
+    bool tls13 = key.version == TLS1_3_VERSION;
+
+    // AES-GCM：salt 为 nonce 的前 4 字节；TLS 1.3 中其余 8 字节是 IV 的后半部分，
+    // TLS 1.2 中是显式 nonce，从记录序号开始由内核逐条递增
+    switch (key.cipherNid)
+    {
+        case NID_aes_128_gcm:
+            info.gcm128.info.version = tls13 ? TLS_1_3_VERSION : TLS_1_2_VERSION;
+            info.gcm128.info.cipher_type = TLS_CIPHER_AES_GCM_128;
+            memcpy(info.gcm128.key, key.key, TLS_CIPHER_AES_GCM_128_KEY_SIZE);
+            memcpy(info.gcm128.salt, key.iv, TLS_CIPHER_AES_GCM_128_SALT_SIZE);
+            memcpy(info.gcm128.iv, tls13 ? key.iv + 4 : recSeq, TLS_CIPHER_AES_GCM_128_IV_SIZE);
+            memcpy(info.gcm128.rec_seq, recSeq, TLS_CIPHER_AES_GCM_128_REC_SEQ_SIZE);
+            infoLen = sizeof(info.gcm128);
+            break;
+        case NID_aes_256_gcm:
+            info.gcm256.info.version = tls13 ? TLS_1_3_VERSION : TLS_1_2_VERSION;
+            info.gcm256.info.cipher_type = TLS_CIPHER_AES_GCM_256;
+            memcpy(info.gcm256.key, key.key, TLS_CIPHER_AES_GCM_256_KEY_SIZE);
+            memcpy(info.gcm256.salt, key.iv, TLS_CIPHER_AES_GCM_256_SALT_SIZE);
+            memcpy(info.gcm256.iv, tls13 ? key.iv + 4 : recSeq, TLS_CIPHER_AES_GCM_256_IV_SIZE);
+            memcpy(info.gcm256.rec_seq, recSeq, TLS_CIPHER_AES_GCM_256_REC_SEQ_SIZE);
+            infoLen = sizeof(info.gcm256);
+            break;
+        case NID_chacha20_poly1305:
+            info.chacha.info.version = tls13 ? TLS_1_3_VERSION : TLS_1_2_VERSION;
+            info.chacha.info.cipher_type = TLS_CIPHER_CHACHA20_POLY1305;
+            memcpy(info.chacha.key, key.key, TLS_CIPHER_CHACHA20_POLY1305_KEY_SIZE);
+            memcpy(info.chacha.iv, key.iv, TLS_CIPHER_CHACHA20_POLY1305_IV_SIZE);
+            memcpy(info.chacha.rec_seq, recSeq, TLS_CIPHER_CHACHA20_POLY1305_REC_SEQ_SIZE);
+            infoLen = sizeof(info.chacha);
+            break;
+        default:
+            return false;
+    }
+
+    // 内核没有加载 tls 模块时 TCP_ULP 失败，连接保持原样，继续走用户态加密
+    if (::setsockopt(fd, SOL_TCP, TCP_ULP, "tls", sizeof("tls")) != 0)
+    {
+        LOG_DEBUG << "kTLS unavailable (TCP_ULP): " << strerror(errno);
+        OPENSSL_cleanse(&info, sizeof(info));
+        return false;
+    }
+    bool ok = ::setsockopt(fd, SOL_TLS, TLS_TX, &info, infoLen) == 0;
+    if (!ok)
+    {
+        // ULP 已经挂上，但没有设置密钥时 socket 仍按普通 TCP 收发
+        LOG_DEBUG << "kTLS TX setup failed: " << strerror(errno);
+    }
+    OPENSSL_cleanse(&info, sizeof(info));
+    return ok;
+}
+
+int KernelTls::socketFd(const muduo::net::TcpConnection& conn)
+{
+    DIR* dir = ::opendir("/proc/self/fd");
+    if (!dir)
+    {
+        return -1;
+    }
+
+    int found = -1;
+    while (struct dirent* entry = ::readdir(dir))
+    {
+        char* end = nullptr;
+        long fd = strtol(entry->d_name, &end, 10);
+        if (end == entry->d_name || *end != '\0' || fd == ::dirfd(dir))
+        {
+            continue;
+        }
+
+        struct sockaddr_storage addr;
+        socklen_t len = sizeof(addr);
+        if (::getpeername(static_cast<int>(fd), reinterpret_cast<struct sockaddr*>(&addr), &len) != 0
+            || !sameAddress(addr, conn.peerAddress().getSockAddr()))
+        {
+            continue;
+        }
+        len = sizeof(addr);
+        if (::getsockname(static_cast<int>(fd), reinterpret_cast<struct sockaddr*>(&addr), &len) == 0
+            && sameAddress(addr, conn.localAddress().getSockAddr()))
+        {
+            found = static_cast<int>(fd);
+            break;
+        }
+    }
+    ::closedir(dir);
+    return found;
+}
+
+} // namespace ssl
@@ -0,0 +1,45 @@
+#pragma once
+#include <openssl/ssl.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <muduo/net/TcpConnection.h>
+
+namespace ssl
+{
+
+// Linux 内核 TLS（kTLS）发送方向卸载
+// 握手仍由 OpenSSL 通过内存 BIO 完成，握手结束后把服务端的写密钥和记录序号装入 socket，
+// 之后写给 socket 的明文由内核分记录加密，文件可以直接 sendfile
+// 只卸载发送方向：muduo 自己从 socket 读数据，接收方向仍在用户态解密
+class KernelTls
+{
+public:
+    // 发送方向的密钥材料
+    struct TxKey
+    {
+        int           version; // TLS1_2_VERSION / TLS1_3_VERSION
+        int           cipherNid; // NID_aes_128_gcm / NID_aes_256_gcm / NID_chacha20_poly1305
+        unsigned char key[32];
+        size_t        keyLen;
+        unsigned char iv[12]; // TLS 1.3 和 ChaCha20 为完整 IV；TLS 1.2 AES-GCM 只用前 4 字节（隐式部分）
+        size_t        ivLen;
+    };
+
+    // 由 SSL_CTX 的 keylog 回调调用，从 TLS 1.3 的 SERVER_TRAFFIC_SECRET_0 行中取出服务端应用流量密钥
+    // 不是该行时返回 false
+    static bool parseServerTrafficSecret(const char* line, std::string* secret);
+
+    // 根据协商结果导出服务端写密钥，TLS 1.3 需要 parseServerTrafficSecret 取得的密钥，
+    // 不支持的版本或加密套件返回 false
+    static bool deriveTxKey(SSL* ssl, const std::string& trafficSecret, TxKey* out);
+
+    // 在 socket 上启用 kTLS 发送方向，seq 为下一条记录的序号；内核不支持时返回 false，连接不受影响
+    static bool install(int fd, const TxKey& key, uint64_t seq);
+
+    // 找到连接对应的 socket 描述符（muduo 不对外暴露），按本端和对端地址匹配，找不到返回 -1
+    // 需要遍历进程打开的描述符，只在配置了 kTLS 时于连接建立（创建 SslConnection）时调用一次
+    static int socketFd(const muduo::net::TcpConnection& conn);
+};
+
+} // namespace ssl
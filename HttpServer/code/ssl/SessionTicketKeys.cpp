@@ -0,0 +1,409 @@
+#include "SessionTicketKeys.h"
+#include <muduo/base/Logging.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#include <openssl/params.h>
+#endif
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+
+namespace ssl
+{
+
+namespace
+{
+
+int ticketKeysIndex()
+{
+    static int index = SSL_CTX_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+    return index;
+}
+
+SessionTicketKeys* keysFromSsl(SSL* ssl)
+{
+    return static_cast<SessionTicketKeys*>(
+        SSL_CTX_get_ex_data(SSL_get_SSL_CTX(ssl), ticketKeysIndex()));
+}
+
+int64_t mtimeNanos(const struct stat& st)
+{
+    return static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+}
+
+// 票据回调的公共部分：enc = 1 时选当前密钥、生成 IV 并初始化加密；enc = 0 时按名称找密钥并初始化解密
+// 返回值含义与 OpenSSL 约定一致：-1 出错，0 未找到密钥（走完整握手），1 成功，2 成功且需要换发票据
+int prepareTicketCipher(SSL* ssl, unsigned char* keyName, unsigned char* iv,
+                        EVP_CIPHER_CTX* cipherCtx, SessionTicketKeys::Key* key, int enc)
+{
+    SessionTicketKeys* keys = keysFromSsl(ssl);
+    if (!keys) {
+        return -1;
+    }
+
+    if (enc) {
+        if (!keys->encryptionKey(key) || RAND_bytes(iv, EVP_MAX_IV_LENGTH) != 1) {
+            return -1;
+        }
+        memcpy(keyName, key->name, SessionTicketKeys::kNameSize);
+        if (EVP_EncryptInit_ex(cipherCtx, EVP_aes_256_cbc(), nullptr, key->aesKey, iv) != 1) {
+            return -1;
+        }
+        return 1;
+    }
+
+    int found = keys->decryptionKey(keyName, key);
+    if (found == 0) {
+        return 0;
+    }
+    if (EVP_DecryptInit_ex(cipherCtx, EVP_aes_256_cbc(), nullptr, key->aesKey, iv) != 1) {
+        return -1;
+    }
+    return found;
+}
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+int ticketKeyCallback(SSL* ssl, unsigned char* keyName, unsigned char* iv,
+                      EVP_CIPHER_CTX* cipherCtx, EVP_MAC_CTX* macCtx, int enc)
+{
+    SessionTicketKeys::Key key;
+    int ret = prepareTicketCipher(ssl, keyName, iv, cipherCtx, &key, enc);
+    if (ret <= 0) {
+        return ret;
+    }
+
+    char digest[] = "SHA256";
+    OSSL_PARAM params[] = {
+        OSSL_PARAM_construct_octet_string(OSSL_MAC_PARAM_KEY, key.hmacKey, sizeof(key.hmacKey)),
+        OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, digest, 0),
+        OSSL_PARAM_construct_end()
+    };
+    if (EVP_MAC_CTX_set_params(macCtx, params) != 1) {
+        return -1;
+    }
+    return ret;
+}
+#else
+int ticketKeyCallback(SSL* ssl, unsigned char* keyName, unsigned char* iv,
+                      EVP_CIPHER_CTX* cipherCtx, HMAC_CTX* hmacCtx, int enc)
+{
+    SessionTicketKeys::Key key;
+    int ret = prepareTicketCipher(ssl, keyName, iv, cipherCtx, &key, enc);
+    if (ret <= 0) {
+        return ret;
+    }
+    if (HMAC_Init_ex(hmacCtx, key.hmacKey, sizeof(key.hmacKey), EVP_sha256(), nullptr) != 1) {
+        return -1;
+    }
+    return ret;
+}
+#endif
+
+} // namespace
+
+SessionTicketKeys::SessionTicketKeys(const std::string& keyFile, int rotateIntervalSecs, size_t keyCount)
+    : keyFile_(keyFile)
+    , rotateIntervalSecs_(rotateIntervalSecs > 0 ? rotateIntervalSecs : 1)
+    , keyCount_(keyCount > 0 ? keyCount : 1)
+    , fileMtime_(-1)
+    , lastRotate_(0)
+    , ticketsIssued_(0)
+    , ticketsRenewed_(0)
+    , ticketsUnknownKey_(0)
+{
+}
+
+bool SessionTicketKeys::install(SSL_CTX* ctx)
+{
+    if (keyFile_.empty())
+    {
+        rotateInMemory();
+    }
+    else if (!syncKeyFile(true))
+    {
+        return false;
+    }
+
+    if (!current() || current()->keys.empty())
+    {
+        LOG_ERROR << "No session ticket keys available";
+        return false;
+    }
+
+    SSL_CTX_set_ex_data(ctx, ticketKeysIndex(), this);
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    SSL_CTX_set_tlsext_ticket_key_evp_cb(ctx, ticketKeyCallback);
+#else
+    SSL_CTX_set_tlsext_ticket_key_cb(ctx, ticketKeyCallback);
+#endif
+    // 确保票据没有被关闭
+    SSL_CTX_clear_options(ctx, SSL_OP_NO_TICKET);
+    return true;
+}
+
+void SessionTicketKeys::rotate()
+{
+    if (keyFile_.empty())
+    {
+        int64_t now = ::time(nullptr);
+        if (now - lastRotate_ >= rotateIntervalSecs_)
+        {
+            rotateInMemory();
+        }
+        return;
+    }
+    syncKeyFile(false);
+}
+
+bool SessionTicketKeys::encryptionKey(Key* key)
+{
+    std::shared_ptr<const KeySet> keys = current();
+    if (!keys || keys->keys.empty())
+    {
+        return false;
+    }
+    *key = keys->keys[keys->active];
+    ticketsIssued_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+int SessionTicketKeys::decryptionKey(const unsigned char* name, Key* key)
+{
+    std::shared_ptr<const KeySet> keys = current();
+    if (keys)
+    {
+        for (size_t i = 0; i < keys->keys.size(); ++i)
+        {
+            if (memcmp(keys->keys[i].name, name, kNameSize) == 0)
+            {
+                *key = keys->keys[i];
+                // 比加密密钥新的密钥来自已经切换的进程，不需要换发
+                if (i <= keys->active)
+                {
+                    return 1;
+                }
+                ticketsRenewed_.fetch_add(1, std::memory_order_relaxed);
+                return 2;
+            }
+        }
+    }
+    ticketsUnknownKey_.fetch_add(1, std::memory_order_relaxed);
+    return 0;
+}
+
+std::shared_ptr<const SessionTicketKeys::KeySet> SessionTicketKeys::current() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return keys_;
+}
+
+void SessionTicketKeys::setKeys(std::shared_ptr<const KeySet> keys)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    keys_ = std::move(keys);
+}
+
+void SessionTicketKeys::rotateInMemory()
+{
+    auto keys = std::make_shared<KeySet>();
+    Key key;
+    if (!generateKey(&key))
+    {
+        LOG_ERROR << "Failed to generate session ticket key";
+        return;
+    }
+    // 进程内模式没有其它进程需要等待，新密钥立即用于加密
+    keys->keys.push_back(key);
+
+    std::shared_ptr<const KeySet> old = current();
+    if (old)
+    {
+        for (size_t i = 0; i < old->keys.size() && keys->keys.size() < keyCount_; ++i)
+        {
+            keys->keys.push_back(old->keys[i]);
+        }
+    }
+    setKeys(std::move(keys));
+    lastRotate_ = ::time(nullptr);
+}
+
+bool SessionTicketKeys::syncKeyFile(bool force)
+{
+    // 先不加锁看一眼：密钥未过期且已经加载过时什么都不用做，每个进程的定时检查只是一次 stat
+    struct stat st;
+    int64_t now = ::time(nullptr);
+    bool exists = ::stat(keyFile_.c_str(), &st) == 0 && st.st_size > 0;
+    bool stale = !exists || now - st.st_mtim.tv_sec >= rotateIntervalSecs_;
+    if (!stale && !force && mtimeNanos(st) == fileMtime_)
+    {
+        // 文件没变，只需检查新密钥是否到了转为加密密钥的时间
+        std::shared_ptr<const KeySet> keys = current();
+        size_t active = activeIndex(keys->keys.size(), st.st_mtim.tv_sec, now);
+        if (active != keys->active)
+        {
+            auto promoted = std::make_shared<KeySet>(*keys);
+            promoted->active = active;
+            setKeys(std::move(promoted));
+            LOG_INFO << "Session ticket key promoted for encryption";
+        }
+        return true;
+    }
+
+    if (stale)
+    {
+        // 多个进程同时发现过期时，只有第一个拿到锁的进程生成新密钥，其余进程加锁后看到的已是新文件
+        std::string lockPath = keyFile_ + ".lock";
+        int lockFd = ::open(lockPath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+        if (lockFd < 0)
+        {
+            LOG_ERROR << "Failed to open ticket key lock file " << lockPath << ": " << strerror(errno);
+            return false;
+        }
+        ::flock(lockFd, LOCK_EX);
+
+        std::vector<Key> keys;
+        exists = ::stat(keyFile_.c_str(), &st) == 0 && st.st_size > 0;
+        if (exists && !readKeyFile(keyFile_, &keys))
+        {
+            ::close(lockFd); // 关闭即释放锁
+            return false;
+        }
+        if (!exists || now - st.st_mtim.tv_sec >= rotateIntervalSecs_)
+        {
+            Key key;
+            if (!generateKey(&key))
+            {
+                LOG_ERROR << "Failed to generate session ticket key";
+                ::close(lockFd);
+                return false;
+            }
+            keys.insert(keys.begin(), key);
+            if (keys.size() > keyCount_)
+            {
+                keys.resize(keyCount_);
+            }
+            if (!writeKeyFile(keyFile_, keys))
+            {
+                ::close(lockFd);
+                return false;
+            }
+            LOG_INFO << "Rotated session ticket keys in " << keyFile_ << ", " << keys.size() << " keys kept";
+        }
+        ::close(lockFd);
+
+        if (::stat(keyFile_.c_str(), &st) != 0)
+        {
+            LOG_ERROR << "Failed to stat ticket key file " << keyFile_ << ": " << strerror(errno);
+            return false;
+        }
+    }
+
+    auto keys = std::make_shared<KeySet>();
+    if (!readKeyFile(keyFile_, &keys->keys) || keys->keys.empty())
+    {
+        return false;
+    }
+    if (keys->keys.size() > keyCount_)
+    {
+        keys->keys.resize(keyCount_);
+    }
+    keys->active = activeIndex(keys->keys.size(), st.st_mtim.tv_sec, ::time(nullptr));
+    setKeys(std::move(keys));
+    fileMtime_ = mtimeNanos(st);
+    return true;
+}
+
+size_t SessionTicketKeys::activeIndex(size_t keyCount, int64_t fileMtimeSecs, int64_t now) const
+{
+    // 文件的修改时间就是最新密钥的生成时间；各进程每个检查间隔加载一次，多等 1 秒抵消定时器误差
+    // 只有一个密钥时（首次生成）没有可替代的旧密钥，只能直接使用
+    if (keyCount > 1 && now - fileMtimeSecs < checkIntervalSecs(rotateIntervalSecs_) + 1)
+    {
+        return 1;
+    }
+    return 0;
+}
+
+bool SessionTicketKeys::generateKey(Key* key)
+{
+    return RAND_bytes(key->name, kNameSize) == 1
+        && RAND_bytes(key->hmacKey, kHmacKeySize) == 1
+        && RAND_bytes(key->aesKey, kAesKeySize) == 1;
+}
+
+bool SessionTicketKeys::readKeyFile(const std::string& path, std::vector<Key>* keys)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        LOG_ERROR << "Failed to open ticket key file " << path << ": " << strerror(errno);
+        return false;
+    }
+
+    std::string content;
+    char buf[4096];
+    ssize_t n;
+    while ((n = ::read(fd, buf, sizeof(buf))) > 0)
+    {
+        content.append(buf, n);
+    }
+    ::close(fd);
+
+    if (n < 0 || content.empty() || content.size() % kKeySize != 0)
+    {
+        LOG_ERROR << "Invalid ticket key file " << path << ": size must be a multiple of " << kKeySize;
+        return false;
+    }
+
+    keys->clear();
+    for (size_t off = 0; off < content.size(); off += kKeySize)
+    {
+        Key key;
+        memcpy(key.name, content.data() + off, kNameSize);
+        memcpy(key.hmacKey, content.data() + off + kNameSize, kHmacKeySize);
+        memcpy(key.aesKey, content.data() + off + kNameSize + kHmacKeySize, kAesKeySize);
+        keys->push_back(key);
+    }
+    OPENSSL_cleanse(&content[0], content.size());
+    return true;
+}
+
+bool SessionTicketKeys::writeKeyFile(const std::string& path, const std::vector<Key>& keys)
+{
+    // 先写临时文件再 rename，其它进程不会读到写了一半的文件
+    std::string tmpPath = path + ".tmp";
+    int fd = ::open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0)
+    {
+        LOG_ERROR << "Failed to create ticket key file " << tmpPath << ": " << strerror(errno);
+        return false;
+    }
+
+    bool ok = true;
+    for (const Key& key : keys)
+    {
+        ok = ok && ::write(fd, key.name, kNameSize) == static_cast<ssize_t>(kNameSize)
+                && ::write(fd, key.hmacKey, kHmacKeySize) == static_cast<ssize_t>(kHmacKeySize)
+                && ::write(fd, key.aesKey, kAesKeySize) == static_cast<ssize_t>(kAesKeySize);
+    }
+    ok = ok && ::fsync(fd) == 0;
+    ::close(fd);
+
+    if (!ok || ::rename(tmpPath.c_str(), path.c_str()) != 0)
+    {
+        LOG_ERROR << "Failed to write ticket key file " << path << ": " << strerror(errno);
+        ::unlink(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+} // namespace ssl
@@ -0,0 +1,93 @@
+#pragma once
+#include <openssl/ssl.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <muduo/base/noncopyable.h>
+
+namespace ssl
+{
+
+// TLS 会话票据密钥
+// 票据用第一个密钥加密，其余密钥只用于解密（轮换后的重叠期），用旧密钥解密成功的会话会被换发新票据
+// 配置了密钥文件时，所有工作进程共享同一文件，重启后继续使用，任意进程签发的票据都能在其它进程恢复；
+// 轮换在文件锁保护下进行，新密钥写在文件最前面，其它进程发现文件更新后重新加载；
+// 其它进程最迟一个检查间隔后才加载到新密钥，因此新密钥先只用于解密，文件更新超过一个检查间隔后才用于加密，
+// 在此之前仍用上一个密钥加密，任何进程签发的票据都能被所有进程解密
+// 密钥文件格式与 nginx 的 ssl_session_ticket_key 相同：每个密钥 80 字节（名称 16 | HMAC 32 | AES 32）
+class SessionTicketKeys : muduo::noncopyable
+{
+public:
+    static constexpr size_t kNameSize = 16;
+    static constexpr size_t kHmacKeySize = 32;
+    static constexpr size_t kAesKeySize = 32;
+    static constexpr size_t kKeySize = kNameSize + kHmacKeySize + kAesKeySize;
+
+    struct Key
+    {
+        unsigned char name[kNameSize];
+        unsigned char hmacKey[kHmacKeySize];
+        unsigned char aesKey[kAesKeySize];
+    };
+
+    // keyFile 为空时只在进程内随机生成并轮换，票据无法跨进程和重启恢复
+    // 保留 keyCount 个密钥，旧票据在 (keyCount - 1) * rotateIntervalSecs 内仍可解密
+    SessionTicketKeys(const std::string& keyFile, int rotateIntervalSecs, size_t keyCount);
+
+    // 加载密钥（密钥文件不存在或已过期时生成新密钥），并注册 ctx 的票据回调
+    bool install(SSL_CTX* ctx);
+
+    // 定时调用（间隔为 checkIntervalSecs）：到期时生成新密钥，密钥文件被其它进程更新时重新加载，
+    // 新密钥超过一个检查间隔后转为加密密钥
+    void rotate();
+
+    // 各进程检查密钥文件的间隔（秒）
+    static int checkIntervalSecs(int rotateIntervalSecs)
+    { return rotateIntervalSecs < 60 ? std::max(rotateIntervalSecs, 1) : 60; }
+
+    // 供票据回调使用
+    // 取当前加密密钥
+    bool encryptionKey(Key* key);
+    // 按名称查找解密密钥：未找到返回 0，当前加密密钥或更新的密钥返回 1，旧密钥返回 2（需要换发票据）
+    int decryptionKey(const unsigned char* name, Key* key);
+
+    uint64_t ticketsIssued() const { return ticketsIssued_.load(std::memory_order_relaxed); }
+    uint64_t ticketsRenewed() const { return ticketsRenewed_.load(std::memory_order_relaxed); }
+    uint64_t ticketsUnknownKey() const { return ticketsUnknownKey_.load(std::memory_order_relaxed); }
+
+private:
+    struct KeySet
+    {
+        std::vector<Key> keys; // 从新到旧
+        size_t           active = 0; // 加密密钥的下标，之前的密钥刚生成，只用于解密
+    };
+
+    std::shared_ptr<const KeySet> current() const;
+    void setKeys(std::shared_ptr<const KeySet> keys);
+    bool syncKeyFile(bool force); // 过期时在文件锁内生成新密钥，文件有变化（或 force）时重新加载
+    // 文件最新的密钥生成后，等所有进程都加载过再用于加密
+    size_t activeIndex(size_t keyCount, int64_t fileMtimeSecs, int64_t now) const;
+    void rotateInMemory();
+    static bool generateKey(Key* key);
+    static bool readKeyFile(const std::string& path, std::vector<Key>* keys);
+    static bool writeKeyFile(const std::string& path, const std::vector<Key>& keys);
+
+private:
+    std::string                   keyFile_;
+    int                           rotateIntervalSecs_;
+    size_t                        keyCount_;
+    mutable std::mutex            mutex_; // 保护 keys_ 的替换
+    std::shared_ptr<const KeySet> keys_; // 回调取出快照后无锁使用
+    int64_t                       fileMtime_; // 已加载的密钥文件修改时间（纳秒）
+    int64_t                       lastRotate_; // 进程内模式下上次生成密钥的时间（秒）
+    std::atomic<uint64_t>         ticketsIssued_; // 签发的票据数
+    std::atomic<uint64_t>         ticketsRenewed_; // 用旧密钥解密后换发的票据数
+    std::atomic<uint64_t>         ticketsUnknownKey_; // 密钥已淘汰、无法解密的票据数
+};
+
+} // namespace ssl
@@ -3,12 +3,20 @@
 namespace ssl
 {
 SslConfig::SslConfig()
-    : version_(SSLVersion::TLS_1_2)
+    : certCheckInterval_(60)
+    , version_(SSLVersion::TLS_1_2)
     , cipherList_("HIGH:!aNULL:!MDS")
     , verifyClient_(false)
     , verifyDepth_(4)
     , sessionTimeout_(300)
     , sessionCacheSize_(20480L)
+    , ticketRotateInterval_(12 * 3600)
+    , ticketKeyCount_(3)
+    , handshakeThreads_(0)
+    , kernelTls_(false)
+    , earlyData_(false)
+    , maxEarlyData_(16384)
+    , replayCacheSize_(65536)
 {
 }
 
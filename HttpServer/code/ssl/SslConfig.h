@@ -1,11 +1,21 @@
 #pragma once
 #include "SslTypes.h"
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <vector>
 
 namespace ssl 
 {
 
+// 一张证书的文件
+struct CertificateFiles
+{
+    std::string certFile; // 证书（可以在服务器证书后附带中间证书）
+    std::string keyFile; // 私钥
+    std::string chainFile; // 证书链，可选
+};
+
 class SslConfig 
 {
 public:
@@ -16,6 +26,13 @@ public:
     void setCertificateFile(const std::string& certFile) { certFile_ = certFile; }
     void setPrivateKeyFile(const std::string& keyFile) { keyFile_ = keyFile; }
     void setCertificateChainFile(const std::string& chainFile) { chainFile_ = chainFile; }
+    // 追加证书，按 SNI 选择，域名取自证书的 SAN/CN；同一域名可以同时配置 ECDSA 和 RSA 证书
+    // 上面设置的证书为默认证书，没有设置时以第一张追加的证书为默认
+    void addCertificate(const std::string& certFile, const std::string& keyFile,
+                        const std::string& chainFile = std::string())
+    { certificates_.push_back(CertificateFiles{ certFile, keyFile, chainFile }); }
+    // 检查证书文件是否变化的间隔，变化后不断开连接地重新加载；0 表示不检查
+    void setCertificateCheckInterval(int seconds) { certCheckInterval_ = seconds; }
     
     // 协议版本和加密套件配置
     void setProtocolVersion(SSLVersion version) { version_ = version; }
@@ -29,27 +46,69 @@ public:
     void setSessionTimeout(int seconds) { sessionTimeout_ = seconds; }
     void setSessionCacheSize(long size) { sessionCacheSize_ = size; }
 
+    // 会话票据配置
+    // 密钥文件由所有工作进程共享（格式同 nginx 的 ssl_session_ticket_key），为空时只使用进程内随机密钥
+    void setSessionTicketKeyFile(const std::string& file) { ticketKeyFile_ = file; }
+    void setSessionTicketRotateInterval(int seconds) { ticketRotateInterval_ = seconds; }
+    // 保留的密钥个数，旧票据在 (count - 1) * 轮换间隔内仍可恢复
+    void setSessionTicketKeyCount(size_t count) { ticketKeyCount_ = count; }
+
+    // 握手线程数：大于 0 时握手在独立的线程池中进行，私钥运算不再阻塞 IO 线程；0 表示在 IO 线程上直接握手
+    void setHandshakeThreads(int threads) { handshakeThreads_ = threads; }
+
+    // 内核 TLS：握手完成后把发送方向的加密交给内核（kTLS），内核不支持时自动回退
+    void setKernelTls(bool enable) { kernelTls_ = enable; }
+
+    // TLS 1.3 0-RTT：恢复会话的客户端可以随 ClientHello 发送请求（早期数据），省去一个往返
+    // 早期数据可能被重放，HttpServer 只在握手完成前处理 allowEarlyData 标记的路由，
+    // 同一 ClientHello 由防重放缓存拒绝；需要启用 TLS 1.3
+    void setEarlyData(bool enable) { earlyData_ = enable; }
+    // 每个连接接受的早期数据上限（字节），同时写入签发的票据
+    void setMaxEarlyData(uint32_t bytes) { maxEarlyData_ = bytes; }
+    // 防重放缓存的容量（窗口内带早期数据的握手数），缓存满时新的早期数据一律拒绝
+    void setEarlyDataReplayCacheSize(size_t size) { replayCacheSize_ = size; }
+
     // Getters
     const std::string& getCertificateFile() const { return certFile_; }
     const std::string& getPrivateKeyFile() const { return keyFile_; }
     const std::string& getCertificateChainFile() const { return chainFile_; }
+    const std::vector<CertificateFiles>& getCertificates() const { return certificates_; }
+    int getCertificateCheckInterval() const { return certCheckInterval_; }
     SSLVersion getProtocolVersion() const { return version_; }
     const std::string& getCipherList() const { return cipherList_; }
     bool getVerifyClient() const { return verifyClient_; }
     int getVerifyDepth() const { return verifyDepth_; }
     int getSessionTimeout() const { return sessionTimeout_; }
     long getSessionCacheSize() const { return sessionCacheSize_; }
+    const std::string& getSessionTicketKeyFile() const { return ticketKeyFile_; }
+    int getSessionTicketRotateInterval() const { return ticketRotateInterval_; }
+    size_t getSessionTicketKeyCount() const { return ticketKeyCount_; }
+    int getHandshakeThreads() const { return handshakeThreads_; }
+    bool getKernelTls() const { return kernelTls_; }
+    bool getEarlyData() const { return earlyData_; }
+    uint32_t getMaxEarlyData() const { return maxEarlyData_; }
+    size_t getEarlyDataReplayCacheSize() const { return replayCacheSize_; }
 
 private:
     std::string certFile_; // 证书文件
     std::string keyFile_; // 私钥文件
     std::string chainFile_; // 证书链文件
+    std::vector<CertificateFiles> certificates_; // 按 SNI 选择的其它证书
+    int         certCheckInterval_; // 证书文件检查间隔（秒）
     SSLVersion  version_; // 协议版本
     std::string cipherList_; // 加密套件
     bool        verifyClient_; // 是否验证客户端
     int         verifyDepth_; // 验证深度
     int         sessionTimeout_; // 会话超时时间
     long        sessionCacheSize_; // 会话缓存大小
+    std::string ticketKeyFile_; // 会话票据密钥文件
+    int         ticketRotateInterval_; // 票据密钥轮换间隔（秒）
+    size_t      ticketKeyCount_; // 保留的票据密钥个数
+    int         handshakeThreads_; // 握手线程数
+    bool        kernelTls_; // 是否尝试启用 kTLS
+    bool        earlyData_; // 是否接受 0-RTT 早期数据
+    uint32_t    maxEarlyData_; // 每个连接的早期数据上限
+    size_t      replayCacheSize_; // 防重放缓存容量
 };
 
 } // namespace ssl
\ No newline at end of file
@@ -1,17 +1,25 @@
 #include "SslConnection.h"
+#include "KernelTls.h"
 #include <muduo/base/Logging.h>
+#include <muduo/net/EventLoop.h>
 #include <openssl/err.h>
+#include <sys/sendfile.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
 
 namespace ssl
 {
 
-// 自定义 BIO 方法
-static BIO_METHOD* createCustomBioMethod() 
+// 写方向的自定义 BIO：SSL 产生的密文直接追加到连接的发送暂存缓冲区，不经过内存 BIO 中转
+static BIO_METHOD* bufferBioMethod() 
 {
-    BIO_METHOD* method = BIO_meth_new(BIO_TYPE_MEM, "custom");
-    BIO_meth_set_write(method, SslConnection::bioWrite);
-    BIO_meth_set_read(method, SslConnection::bioRead);
-    BIO_meth_set_ctrl(method, SslConnection::bioCtrl);
+    static BIO_METHOD* method = [] {
+        BIO_METHOD* m = BIO_meth_new(BIO_get_new_index() | BIO_TYPE_SOURCE_SINK, "muduo_buffer");
+        BIO_meth_set_write(m, SslConnection::bioWrite);
+        BIO_meth_set_ctrl(m, SslConnection::bioCtrl);
+        return m;
+    }();
     return method;
 }
 
@@ -23,6 +31,17 @@ SslConnection::SslConnection(const TcpConnectionPtr& conn, SslContext* ctx)
     , readBio_(nullptr)
     , writeBio_(nullptr)
     , messageCallback_(nullptr)
+    , bytesSinceIdle_(0)
+    , lastSendTime_(0)
+    , handshakeInFlight_(false)
+    , kernelTls_(false)
+    , socketFd_(ctx->kernelTls() ? KernelTls::socketFd(*conn) : -1)
+    , txRecords_(0)
+    , txRecordRemaining_(0)
+    , txHeaderLen_(0)
+    , readingEarlyData_(ctx->earlyData())
+    , earlyDataReady_(false)
+    , earlyDataDelivered_(false)
 {
     // 创建 SSL 对象
     ssl_ = SSL_new(ctx_->getNativeHandle());
@@ -31,9 +50,9 @@ SslConnection::SslConnection(const TcpConnectionPtr& conn, SslContext* ctx)
         return;
     }
 
-    // 创建 BIO
+    // 创建 BIO：读方向用内存 BIO 接收密文，写方向用自定义 BIO 直接写入 writeBuffer_
     readBio_ = BIO_new(BIO_s_mem());
-    writeBio_ = BIO_new(BIO_s_mem());
+    writeBio_ = BIO_new(bufferBioMethod());
     
     if (!readBio_ || !writeBio_) {
         LOG_ERROR << "Failed to create BIO objects";
@@ -42,7 +61,10 @@ SslConnection::SslConnection(const TcpConnectionPtr& conn, SslContext* ctx)
         return;
     }
 
+    BIO_set_data(writeBio_, this);
+    BIO_set_init(writeBio_, 1);
     SSL_set_bio(ssl_, readBio_, writeBio_);
+    SSL_set_app_data(ssl_, this);
     SSL_set_accept_state(ssl_);  // 设置为服务器模式
     
     // 设置 SSL 选项
@@ -69,63 +91,286 @@ void SslConnection::startHandshake()
     handleHandshake();
 }
 
+// 按当前的记录大小分块加密，所有记录先写入 writeBuffer_，最后只发送一次
 void SslConnection::send(const void* data, size_t len) 
 {
+    if (state_ == SSLState::HANDSHAKE && earlyDataDelivered_) {
+        sendEarly(data, len);
+        return;
+    }
     if (state_ != SSLState::ESTABLISHED) {
         LOG_ERROR << "Cannot send data before SSL handshake is complete";
         return;
     }
-    
-    int written = SSL_write(ssl_, data, len);
-    if (written <= 0) {
-        int err = SSL_get_error(ssl_, written);
-        LOG_ERROR << "SSL_write failed: " << ERR_error_string(err, nullptr);
+
+    if (kernelTls_) {
+        // 内核负责分记录加密
+        conn_->send(data, static_cast<int>(len));
         return;
     }
+
+    // 空闲一段时间后 TCP 拥塞窗口可能已经收缩，重新从小记录开始
+    muduo::Timestamp now = muduo::Timestamp::now();
+    if (muduo::timeDifference(now, lastSendTime_) > kRecordIdleResetSecs) {
+        bytesSinceIdle_ = 0;
+    }
+    lastSendTime_ = now;
+
+    const char* p = static_cast<const char*>(data);
+    size_t remaining = len;
+    while (remaining > 0) {
+        // 开始阶段用能放进一个 TCP 报文段的小记录，客户端收到一个报文段就能解密，降低首字节时间；
+        // 传输量超过阈值后改用 16KB 的最大记录，减少每条记录的加密和头部开销
+        size_t recordSize = bytesSinceIdle_ < kSmallRecordThreshold ? kSmallRecordSize : kReadChunk;
+        size_t chunk = std::min(remaining, recordSize);
+        int written = SSL_write(ssl_, p, static_cast<int>(chunk));
+        if (written <= 0) {
+            handleError(getLastError(written));
+            break;
+        }
+        p += written;
+        remaining -= written;
+        bytesSinceIdle_ += written;
+    }
     
-    char buf[4096];
-    int pending;
-    while ((pending = BIO_pending(writeBio_)) > 0) {
-        int bytes = BIO_read(writeBio_, buf, 
-                           std::min(pending, static_cast<int>(sizeof(buf))));
-        if (bytes > 0) {
-            conn_->send(buf, bytes);
+    flushWriteBio();
+}
+
+void SslConnection::sendEarly(const void* data, size_t len) 
+{
+    // 握手的下一步正在线程池中执行时 ssl_ 和 writeBuffer_ 归握手线程使用；
+    // 早期数据已经读完时 OpenSSL 不再允许 0.5-RTT 写入。两种情况都暂存，等客户端的 Finished 到达后再发，
+    // 已有暂存数据时后续响应也只能排在后面
+    if (handshakeInFlight_ || !readingEarlyData_ || earlyOutput_.readableBytes() > 0) {
+        earlyOutput_.append(data, len);
+        return;
+    }
+
+    const char* p = static_cast<const char*>(data);
+    while (len > 0) {
+        size_t chunk = len < kReadChunk ? len : kReadChunk;
+        size_t written = 0;
+        if (SSL_write_early_data(ssl_, p, chunk, &written) != 1) {
+            handleError(getLastError(0));
+            break;
         }
+        p += written;
+        len -= written;
+    }
+    flushWriteBio();
+}
+
+ssize_t SslConnection::sendFile(int fd, off_t offset, size_t count) 
+{
+    // 早期数据请求的响应由下面的读取经 send() 按 0.5-RTT 数据发出
+    if (state_ != SSLState::ESTABLISHED && !(state_ == SSLState::HANDSHAKE && earlyDataDelivered_)) {
+        LOG_ERROR << "Cannot send data before SSL handshake is complete";
+        return -1;
+    }
+    // 现在只能暂存到 earlyOutput_（见 sendEarly），不把文件读进内存，等握手完成后调用方再继续
+    if (state_ == SSLState::HANDSHAKE
+        && (handshakeInFlight_ || !readingEarlyData_ || earlyOutput_.readableBytes() > 0)) {
+        return 0;
+    }
+
+    size_t sent = 0;
+    // muduo 输出缓冲区中还有数据时直接写 socket 会打乱顺序，只能走缓冲区
+    if (kernelTls_ && conn_->outputBuffer()->readableBytes() == 0) {
+        while (sent < count) {
+            ssize_t n = ::sendfile(socketFd_, fd, &offset, count - sent);
+            if (n > 0) {
+                sent += n;
+            } else if (n < 0 && errno == EINTR) {
+                continue;
+            } else {
+                break; // 发送缓冲区已满（EAGAIN）或出错，剩余部分交给 muduo
+            }
+        }
+        if (sent > 0) {
+            return static_cast<ssize_t>(sent);
+        }
+    }
+
+    // 读出后交给 muduo：kTLS 下直接写入输出缓冲区，否则按记录大小加密
+    // 数据进入输出缓冲区后，调用方在 WriteCompleteCallback 中继续发送下一块
+    std::string chunk(count, '\0');
+    while (true) {
+        ssize_t n = ::pread(fd, &chunk[0], chunk.size(), offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            LOG_ERROR << "Failed to read file for sending: " << (n < 0 ? strerror(errno) : "unexpected EOF");
+            return -1;
+        }
+        send(chunk.data(), n);
+        return n;
     }
 }
 
 void SslConnection::onRead(const TcpConnectionPtr& conn, BufferPtr buf, 
                          muduo::Timestamp time) 
 {
+    if (state_ == SSLState::ERROR || state_ == SSLState::SHUTDOWN) {
+        buf->retrieveAll();
+        return;
+    }
+
+    if (handshakeInFlight_) {
+        // 握手线程正在使用 SSL 对象，密文先暂存，握手这一步完成后再处理
+        pendingInput_.append(buf->peek(), buf->readableBytes());
+        buf->retrieveAll();
+        return;
+    }
+
+    feedInput(buf->peek(), buf->readableBytes());
+    buf->retrieveAll();
+    if (state_ == SSLState::ERROR) {
+        return;
+    }
+
     if (state_ == SSLState::HANDSHAKE) {
-        // 将数据写入 BIO
-        BIO_write(readBio_, buf->peek(), buf->readableBytes());
-        buf->retrieve(buf->readableBytes());
         handleHandshake();
-        return;
-    } else if (state_ == SSLState::ESTABLISHED) {
-        // 解密数据
-        char decryptedData[4096];
-        int ret = SSL_read(ssl_, decryptedData, sizeof(decryptedData));
+        if (state_ != SSLState::ESTABLISHED) {
+            return;
+        }
+        // 客户端可能把第一个请求和握手的最后一条消息一起发来，继续读取
+    }
+
+    readDecrypted(conn, time);
+}
+
+void SslConnection::feedInput(const char* data, size_t len) 
+{
+    // 收到的密文全部交给 SSL，内存 BIO 不会拒绝写入
+    while (len > 0) {
+        int written = BIO_write(readBio_, data, static_cast<int>(len));
+        if (written <= 0) {
+            LOG_ERROR << "BIO_write failed, dropping connection";
+            state_ = SSLState::ERROR;
+            conn_->shutdown();
+            return;
+        }
+        data += written;
+        len -= written;
+    }
+}
+
+void SslConnection::readDecrypted(const TcpConnectionPtr& conn, muduo::Timestamp time) 
+{
+    // 循环读到 SSL 内部没有完整记录为止，明文直接写入持久的解密缓冲区，
+    // 未解析完的请求留在缓冲区中，等下一批数据到达后继续解析
+    bool gotData = false;
+    for (;;) {
+        decryptedBuffer_.ensureWritableBytes(kReadChunk);
+        int ret = SSL_read(ssl_, decryptedBuffer_.beginWrite(),
+                           static_cast<int>(decryptedBuffer_.writableBytes()));
         if (ret > 0) {
-            // 创建新的 Buffer 存储解密后的数据
-            muduo::net::Buffer decryptedBuffer;
-            decryptedBuffer.append(decryptedData, ret);
-            
-            // 调用上层回调处理解密后的数据
-            if (messageCallback_) {
-                messageCallback_(conn, &decryptedBuffer, time);
-            }
+            decryptedBuffer_.hasWritten(ret);
+            gotData = true;
+            continue;
+        }
+
+        int err = SSL_get_error(ssl_, ret);
+        if (err == SSL_ERROR_WANT_READ) {
+            break; // 需要更多密文
+        }
+        if (err == SSL_ERROR_ZERO_RETURN) {
+            // 对端发送了 close_notify
+            state_ = SSLState::SHUTDOWN;
+            conn_->shutdown();
+            break;
         }
+        handleError(getLastError(ret));
+        break;
+    }
+
+    // TLS 1.3 的会话票据、密钥更新等也会在读取时产生输出
+    flushWriteBio();
+
+    // 握手期间交给上层的早期数据中可能有推迟到握手完成才处理的请求，即使没有新数据也回调一次
+    if ((gotData || earlyDataDelivered_ || earlyDataReady_) && messageCallback_) {
+        earlyDataReady_ = false;
+        earlyDataDelivered_ = false;
+        messageCallback_(conn, &decryptedBuffer_, time);
+    }
+}
+
+void SslConnection::flushWriteBio() 
+{
+    if (kernelTls_ && writeBuffer_.readableBytes() > 0) {
+        // 启用 kTLS 后 OpenSSL 仍用自己的序号加密（如响应对端的 KeyUpdate），与内核的序号对不上，只能断开
+        LOG_WARN << "TLS output after kTLS was enabled, closing connection";
+        writeBuffer_.retrieveAll();
+        conn_->forceClose();
+        return;
+    }
+    // 输出缓冲区为空时 muduo 直接从 writeBuffer_ 写 socket，只有写不完的部分才会被拷贝
+    if (writeBuffer_.readableBytes() > 0) {
+        conn_->send(&writeBuffer_);
     }
 }
 
 void SslConnection::handleHandshake() 
 {
-    int ret = SSL_do_handshake(ssl_);
-    
+    muduo::ThreadPool* pool = ctx_->handshakePool();
+    if (!pool) {
+        int ret = doHandshakeStep();
+        int err = SSL_get_error(ssl_, ret);
+        onHandshakeStep(ret, err, ret == 1 ? 0 : ERR_get_error());
+        return;
+    }
+
+    // 私钥运算在握手线程上执行；期间 IO 线程不再访问 ssl_，握手消息写入 writeBuffer_ 也只发生在握手线程上
+    handshakeInFlight_ = true;
+    std::shared_ptr<SslConnection> self = shared_from_this();
+    pool->run([self] {
+        int ret = self->doHandshakeStep();
+        int err = SSL_get_error(self->ssl_, ret);
+        // OpenSSL 的错误队列是线程局部的，在这里取出
+        unsigned long errCode = ret == 1 ? 0 : ERR_get_error();
+        ERR_clear_error();
+        self->conn_->getLoop()->runInLoop([self, ret, err, errCode] {
+            self->onHandshakeStep(ret, err, errCode);
+            self->resumeAfterHandshake();
+        });
+    });
+}
+
+int SslConnection::doHandshakeStep() 
+{
+    // 接受 0-RTT 时服务端必须先用 SSL_read_early_data 推进握手，读完（或拒绝、客户端没有发送）早期数据后
+    // 返回 FINISH，再用 SSL_do_handshake 等待客户端的 Finished；早期数据直接写入解密缓冲区
+    while (readingEarlyData_) {
+        decryptedBuffer_.ensureWritableBytes(kReadChunk);
+        size_t n = 0;
+        int ret = SSL_read_early_data(ssl_, decryptedBuffer_.beginWrite(), decryptedBuffer_.writableBytes(), &n);
+        if (ret == SSL_READ_EARLY_DATA_SUCCESS) {
+            decryptedBuffer_.hasWritten(n);
+            earlyDataReady_ = true;
+        } else if (ret == SSL_READ_EARLY_DATA_FINISH) {
+            readingEarlyData_ = false;
+        } else {
+            return -1; // 需要更多密文或出错，由 SSL_get_error 区分
+        }
+    }
+    return SSL_do_handshake(ssl_);
+}
+
+void SslConnection::onHandshakeStep(int ret, int err, unsigned long errCode) 
+{
+    handshakeInFlight_ = false;
+    if (conn_->disconnected()) {
+        return;
+    }
+
+    // 握手消息（ServerHello、证书等）写在 writeBuffer_ 中，需要发给对端
+    flushWriteBio();
+
     if (ret == 1) {
         state_ = SSLState::ESTABLISHED;
+        ctx_->recordHandshake(SSL_session_reused(ssl_) == 1,
+                              SSL_get_early_data_status(ssl_) == SSL_EARLY_DATA_ACCEPTED);
         LOG_INFO << "SSL handshake completed successfully";
         LOG_INFO << "Using cipher: " << SSL_get_cipher(ssl_);
         LOG_INFO << "Protocol version: " << SSL_get_version(ssl_);
@@ -134,32 +379,121 @@ void SslConnection::handleHandshake()
         if (!messageCallback_) {
             LOG_WARN << "No message callback set after SSL handshake";
         }
+
+        // 早期数据读完后才产生的响应
+        if (earlyOutput_.readableBytes() > 0) {
+            send(earlyOutput_.peek(), earlyOutput_.readableBytes());
+            earlyOutput_.retrieveAll();
+        }
+
+        if (ctx_->kernelTls()) {
+            enableKernelTls();
+        }
+    } else {
+        switch (err) {
+            case SSL_ERROR_WANT_READ:
+            case SSL_ERROR_WANT_WRITE:
+                // 正常的握手过程，需要继续；期间读出的早期数据先交给上层，响应随服务端握手消息发出
+                if (earlyDataReady_ && messageCallback_) {
+                    earlyDataReady_ = false;
+                    earlyDataDelivered_ = true;
+                    messageCallback_(conn_, &decryptedBuffer_, muduo::Timestamp::now());
+                }
+                break;
+                
+            default: {
+                // 获取详细的错误信息
+                char errBuf[256];
+                ERR_error_string_n(errCode, errBuf, sizeof(errBuf));
+                LOG_ERROR << "SSL handshake failed: " << errBuf;
+                state_ = SSLState::ERROR;
+                conn_->shutdown();  // 关闭连接
+                break;
+            }
+        }
+    }
+}
+
+void SslConnection::resumeAfterHandshake() 
+{
+    if (conn_->disconnected() || state_ == SSLState::ERROR || state_ == SSLState::SHUTDOWN) {
         return;
     }
-    
-    int err = SSL_get_error(ssl_, ret);
-    switch (err) {
-        case SSL_ERROR_WANT_READ:
-        case SSL_ERROR_WANT_WRITE:
-            // 正常的握手过程，需要继续
-            break;
-            
-        default: {
-            // 获取详细的错误信息
-            char errBuf[256];
-            unsigned long errCode = ERR_get_error();
-            ERR_error_string_n(errCode, errBuf, sizeof(errBuf));
-            LOG_ERROR << "SSL handshake failed: " << errBuf;
-            conn_->shutdown();  // 关闭连接
-            break;
+
+    // 握手执行期间暂存的密文
+    bool gotInput = pendingInput_.readableBytes() > 0;
+    if (gotInput) {
+        feedInput(pendingInput_.peek(), pendingInput_.readableBytes());
+        pendingInput_.retrieveAll();
+        if (state_ == SSLState::ERROR) {
+            return;
+        }
+    }
+
+    if (state_ == SSLState::HANDSHAKE) {
+        // 没有新的密文时等 onRead 再发起下一步
+        if (gotInput) {
+            handleHandshake();
+        }
+        return;
+    }
+
+    // 客户端随握手最后一条消息发来的请求已经在 readBio_ 中
+    readDecrypted(conn_, muduo::Timestamp::now());
+}
+
+void SslConnection::enableKernelTls() 
+{
+    // 还没写出 socket 的密文在切换后会被内核再加密一次，这种情况下保持用户态加密
+    if (writeBuffer_.readableBytes() > 0 || conn_->outputBuffer()->readableBytes() > 0) {
+        LOG_DEBUG << "Output pending at handshake completion, kTLS not enabled";
+        return;
+    }
+
+    KernelTls::TxKey key;
+    if (KernelTls::deriveTxKey(ssl_, trafficSecret_, &key)) {
+        if (socketFd_ >= 0 && KernelTls::install(socketFd_, key, txRecords_)) {
+            kernelTls_ = true;
+            LOG_DEBUG << "kTLS TX enabled on " << conn_->name();
         }
+        OPENSSL_cleanse(&key, sizeof(key));
+    }
+    if (!trafficSecret_.empty()) {
+        OPENSSL_cleanse(&trafficSecret_[0], trafficSecret_.size());
+        trafficSecret_.clear();
     }
 }
 
-void SslConnection::onEncrypted(const char* data, size_t len) 
+void SslConnection::countRecords(const char* data, size_t len) 
 {
-    writeBuffer_.append(data, len);
-    conn_->send(&writeBuffer_);
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+    while (len > 0) {
+        if (txRecordRemaining_ > 0) {
+            size_t n = std::min(len, txRecordRemaining_);
+            txRecordRemaining_ -= n;
+            p += n;
+            len -= n;
+            continue;
+        }
+
+        // 记录头：类型(1) 版本(2) 长度(2)
+        size_t n = std::min(len, sizeof(txHeader_) - txHeaderLen_);
+        memcpy(txHeader_ + txHeaderLen_, p, n);
+        txHeaderLen_ += n;
+        p += n;
+        len -= n;
+        if (txHeaderLen_ == sizeof(txHeader_)) {
+            txHeaderLen_ = 0;
+            txRecordRemaining_ = (static_cast<size_t>(txHeader_[3]) << 8) | txHeader_[4];
+            // TLS 1.2 的 ChangeCipherSpec 之后启用新的写密钥，序号从 0 开始；
+            // TLS 1.3 的写密钥切换由 onKeyLog 通知
+            if (txHeader_[0] == SSL3_RT_CHANGE_CIPHER_SPEC) {
+                txRecords_ = 0;
+            } else {
+                ++txRecords_;
+            }
+        }
+    }
 }
 
 void SslConnection::onDecrypted(const char* data, size_t len) 
@@ -212,25 +546,20 @@ int SslConnection::bioWrite(BIO* bio, const char* data, int len)
     SslConnection* conn = static_cast<SslConnection*>(BIO_get_data(bio));
     if (!conn) return -1;
 
-    conn->conn_->send(data, len);
+    conn->writeBuffer_.append(data, len);
+    if (conn->ctx_->kernelTls()) {
+        conn->countRecords(data, len);
+    }
     return len;
 }
 
-int SslConnection::bioRead(BIO* bio, char* data, int len) 
+void SslConnection::onKeyLog(const SSL* ssl, const char* line) 
 {
-    SslConnection* conn = static_cast<SslConnection*>(BIO_get_data(bio));
-    if (!conn) return -1;
-
-    size_t readable = conn->readBuffer_.readableBytes();
-    if (readable == 0) 
-    {
-        return -1;  // 无数据可读
+    SslConnection* conn = static_cast<SslConnection*>(SSL_get_app_data(ssl));
+    // 服务端的应用流量密钥在发出 Finished 之后才启用，之后发出的记录（会话票据）都用这个密钥
+    if (conn && KernelTls::parseServerTrafficSecret(line, &conn->trafficSecret_)) {
+        conn->txRecords_ = 0;
     }
-
-    size_t toRead = std::min(static_cast<size_t>(len), readable);
-    memcpy(data, conn->readBuffer_.peek(), toRead);
-    conn->readBuffer_.retrieve(toRead);
-    return toRead;
 }
 
 long SslConnection::bioCtrl(BIO* bio, int cmd, long num, void* ptr) 
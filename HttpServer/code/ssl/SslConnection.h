@@ -4,7 +4,9 @@
 #include <muduo/net/Buffer.h>
 #include <muduo/base/noncopyable.h>
 #include <openssl/ssl.h>
+#include <sys/types.h>
 #include <memory>
+#include <string>
 
 namespace ssl 
 {
@@ -14,7 +16,13 @@ using MessageCallback = std::function<void(const std::shared_ptr<muduo::net::Tcp
                                          muduo::net::Buffer*,
                                          muduo::Timestamp)>;
 
-class SslConnection : muduo::noncopyable 
+// 配置了握手线程池时，SSL_do_handshake 在池中执行，完成后回到连接所属的 IO 线程继续；
+// 握手进行期间 SSL 对象只由握手线程访问，新到的密文先暂存在 pendingInput_ 中
+// 握手任务持有 shared_ptr，连接在握手期间断开也不会提前析构
+// 接受 0-RTT 时，握手完成前读出的早期数据先交给消息回调（此时 isHandshakeCompleted() 为 false），
+// 回调中发送的响应作为 0.5-RTT 数据随服务端握手消息发出；握手完成后会再回调一次，处理推迟的请求
+class SslConnection : muduo::noncopyable,
+                      public std::enable_shared_from_this<SslConnection>
 {
 public:
     using TcpConnectionPtr = std::shared_ptr<muduo::net::TcpConnection>;
@@ -25,18 +33,39 @@ public:
 
     void startHandshake();
     void send(const void* data, size_t len);
+    // 发送文件的 [offset, offset + count) 部分：启用了 kTLS 时用 sendfile，否则读出后加密发送
+    // 返回发出的字节数，读文件出错时返回 -1；大文件由调用方分块调用
+    // 0.5-RTT 响应暂时不能发送时（握手正在线程池中执行或早期数据已读完）返回 0，握手完成后消息回调会再次触发
+    ssize_t sendFile(int fd, off_t offset, size_t count);
+    bool kernelTlsEnabled() const { return kernelTls_; }
     void onRead(const TcpConnectionPtr& conn, BufferPtr buf, muduo::Timestamp time);
     bool isHandshakeCompleted() const { return state_ == SSLState::ESTABLISHED; }
     muduo::net::Buffer* getDecryptedBuffer() { return &decryptedBuffer_; }
     // SSL BIO 操作回调
     static int bioWrite(BIO* bio, const char* data, int len);
-    static int bioRead(BIO* bio, char* data, int len);
     static long bioCtrl(BIO* bio, int cmd, long num, void* ptr);
+    // SSL_CTX 的 keylog 回调，记下 TLS 1.3 服务端应用流量密钥供 kTLS 使用
+    static void onKeyLog(const SSL* ssl, const char* line);
     // 设置消息回调函数
     void setMessageCallback(const MessageCallback& cb) { messageCallback_ = cb; }
 private:
+    static const size_t kReadChunk = 16 * 1024; // 一条 TLS 记录的最大明文长度
+    static const size_t kSmallRecordSize = 1369; // 加上 TLS、TCP/IP 头部后正好放进一个 1500 MTU 的报文段
+    static const size_t kSmallRecordThreshold = 40 * kSmallRecordSize; // 发送超过该字节数后改用最大记录
+    static constexpr double kRecordIdleResetSecs = 1.0; // 空闲超过该时间后重新使用小记录
+
     void handleHandshake();
-    void onEncrypted(const char* data, size_t len);
+    // 执行握手的一步（可能在握手线程上），返回值同 SSL_do_handshake
+    int doHandshakeStep();
+    void sendEarly(const void* data, size_t len); // 握手完成前发送早期数据请求的响应
+    // 握手的一步执行完毕（在 IO 线程上），ret/err 为 SSL_do_handshake 的结果，errCode 为执行线程上的错误码
+    void onHandshakeStep(int ret, int err, unsigned long errCode);
+    void resumeAfterHandshake(); // 异步握手的一步完成后处理期间到达的数据
+    void feedInput(const char* data, size_t len); // 把密文写入 readBio_
+    void readDecrypted(const TcpConnectionPtr& conn, muduo::Timestamp time);
+    void countRecords(const char* data, size_t len); // 统计当前写密钥下已发出的记录数
+    void enableKernelTls();
+    void flushWriteBio(); // 把 writeBuffer_ 中暂存的密文一次发送出去
     void onDecrypted(const char* data, size_t len);
     SSLError getLastError(int ret);
     void handleError(SSLError error);
@@ -48,10 +77,24 @@ private:
     SSLState            state_; // SSL 状态
     BIO*                readBio_;   // 网络数据 -> SSL
     BIO*                writeBio_;  // SSL -> 网络数据
-    muduo::net::Buffer  readBuffer_; // 读缓冲区
-    muduo::net::Buffer  writeBuffer_; // 写缓冲区
+    muduo::net::Buffer  writeBuffer_; // 待发送的密文，由 writeBio_ 直接写入
     muduo::net::Buffer  decryptedBuffer_; // 解密后的数据
     MessageCallback     messageCallback_; // 消息回调
+    size_t              bytesSinceIdle_; // 上次空闲以来发送的明文字节数，决定记录大小
+    muduo::Timestamp    lastSendTime_; // 上次发送的时间
+    bool                handshakeInFlight_; // 握手正在线程池中执行
+    muduo::net::Buffer  pendingInput_; // 握手执行期间收到的密文
+    bool                kernelTls_; // 发送方向已交给内核加密
+    int                 socketFd_; // 连接的 socket 描述符，在连接建立时取得（只在配置了 kTLS 时）
+    std::string         trafficSecret_; // TLS 1.3 服务端应用流量密钥，装入内核后清除
+    uint64_t            txRecords_; // 当前写密钥下已发出的记录数，即内核接续的记录序号
+    size_t              txRecordRemaining_; // 正在统计的记录还剩多少字节
+    unsigned char       txHeader_[5]; // 跨 bioWrite 调用的记录头
+    size_t              txHeaderLen_;
+    bool                readingEarlyData_; // 握手仍在通过 SSL_read_early_data 进行
+    bool                earlyDataReady_; // 握手这一步读出了早期数据，等待交给消息回调
+    bool                earlyDataDelivered_; // 早期数据已交给消息回调，握手完成后需要再回调一次
+    muduo::net::Buffer  earlyOutput_; // 早期数据读完后、握手完成前产生的响应明文
 };
 
 } // namespace ssl
\ No newline at end of file
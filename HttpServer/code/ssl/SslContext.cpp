@@ -1,18 +1,29 @@
 #include "SslContext.h"
+#include "SslConnection.h"
 #include <muduo/base/Logging.h>
 #include <openssl/err.h>
+#include <algorithm>
 
 namespace ssl
 {
 SslContext::SslContext(const SslConfig& config)
     : ctx_(nullptr)
     , config_(config)
+    , handshakes_(0)
+    , resumed_(0)
+    , earlyDataAccepted_(0)
 {
 
 }
 
 SslContext::~SslContext()
 {
+    // 先停掉握手线程，保证没有线程还在使用 ctx_
+    if (handshakePool_)
+    {
+        handshakePool_->stop();
+        handshakePool_.reset();
+    }
     if (ctx_)
     {
         SSL_CTX_free(ctx_);
@@ -52,52 +63,60 @@ bool SslContext::initialize()
         return false;
     }
 
-    // 设置会话缓存
-    setupSessionCache();
-
-    LOG_INFO << "SSL context initialized successfully";
-    return true;
-}
-
-bool SslContext::loadCertificates()
-{
-    // 加载证书
-    if (SSL_CTX_use_certificate_file(ctx_,
-     config_.getCertificateFile().c_str(), SSL_FILETYPE_PEM) <= 0)
+    // 设置会话缓存和会话票据
+    if (!setupSessionCache())
     {
-        handleSslError("Failed to load server certificate");
         return false;
     }
 
-    // 加载私钥
-    if (SSL_CTX_use_PrivateKey_file(ctx_, 
-        config_.getPrivateKeyFile().c_str(), SSL_FILETYPE_PEM) <= 0)
+    // 0-RTT 早期数据
+    if (config_.getEarlyData())
     {
-        handleSslError("Failed to load private key");
-        return false;
+        setupEarlyData();
     }
 
-    // 验证私钥
-    if (!SSL_CTX_check_private_key(ctx_))
+    // kTLS 需要 TLS 1.3 的服务端应用流量密钥，OpenSSL 只通过 keylog 回调提供
+    if (config_.getKernelTls())
     {
-        handleSslError("Private key does not match the certificate");
-        return false;
+        SSL_CTX_set_keylog_callback(ctx_, SslConnection::onKeyLog);
     }
 
-    // 加载证书链
-    if (!config_.getCertificateChainFile().empty())
+    // 握手线程池
+    if (config_.getHandshakeThreads() > 0)
     {
-        if (SSL_CTX_use_certificate_chain_file(ctx_,
-            config_.getCertificateChainFile().c_str()) <= 0)
-        {
-            handleSslError("Failed to load certificate chain");
-            return false;
-        }
+        handshakePool_ = std::make_unique<muduo::ThreadPool>("SslHandshake");
+        handshakePool_->start(config_.getHandshakeThreads());
     }
 
+    LOG_INFO << "SSL context initialized successfully";
+    return true;
+}
+
+bool SslContext::loadCertificates()
+{
+    // 证书不直接装入 ctx_，握手时由 SNI 回调为每个连接装入，重新加载证书只需替换证书集合
+    certificates_ = std::make_unique<CertificateStore>(config_);
+    if (!certificates_->reload())
+    {
+        return false;
+    }
+    certificates_->install(ctx_);
     return true;
 }
 
+bool SslContext::reloadCertificates()
+{
+    return certificates_ && certificates_->reload();
+}
+
+void SslContext::checkCertificates()
+{
+    if (certificates_)
+    {
+        certificates_->reloadIfChanged();
+    }
+}
+
 bool SslContext::setupProtocol()
 {
     // 设置 SSL/TLS 协议版本
@@ -133,11 +152,79 @@ bool SslContext::setupProtocol()
     return true;
 }
 
-void SslContext::setupSessionCache()
+bool SslContext::setupSessionCache()
 {
+    // 会话缓存只在本进程内有效，票据由客户端保存，配合共享的密钥文件可以在任意工作进程恢复
     SSL_CTX_set_session_cache_mode(ctx_, SSL_SESS_CACHE_SERVER);
     SSL_CTX_sess_set_cache_size(ctx_, config_.getSessionCacheSize());
     SSL_CTX_set_timeout(ctx_, config_.getSessionTimeout());
+
+    ticketKeys_ = std::make_unique<SessionTicketKeys>(config_.getSessionTicketKeyFile(),
+                                                      config_.getSessionTicketRotateInterval(),
+                                                      config_.getSessionTicketKeyCount());
+    if (!ticketKeys_->install(ctx_))
+    {
+        LOG_ERROR << "Failed to set up session ticket keys";
+        return false;
+    }
+    return true;
+}
+
+void SslContext::setupEarlyData()
+{
+    // 票据中记录的上限决定客户端能否发送早期数据，接收上限决定服务端最多读取多少
+    SSL_CTX_set_max_early_data(ctx_, config_.getMaxEarlyData());
+    SSL_CTX_set_recv_max_early_data(ctx_, config_.getMaxEarlyData());
+
+    // OpenSSL 默认的防重放会改用只存在本进程会话缓存中的一次性票据，票据无法再由其它工作进程恢复；
+    // 关掉它保留共享密钥的无状态票据，改由 allowEarlyData 按 ClientHello 去重
+    SSL_CTX_set_options(ctx_, SSL_OP_NO_ANTI_REPLAY);
+    antiReplay_ = std::make_unique<AntiReplayCache>(config_.getEarlyDataReplayCacheSize());
+    SSL_CTX_set_allow_early_data_cb(ctx_, allowEarlyData, this);
+}
+
+int SslContext::allowEarlyData(SSL* ssl, void* arg)
+{
+    // 只有会话恢复成功、票据年龄通过检查的 ClientHello 才会走到这里，拒绝后握手照常完成，只是早期数据被丢弃
+    SslContext* self = static_cast<SslContext*>(arg);
+    unsigned char random[SSL3_RANDOM_SIZE];
+    size_t len = SSL_get_client_random(ssl, random, sizeof(random));
+    return self->antiReplay_->insert(random, len) ? 1 : 0;
+}
+
+void SslContext::rotateTicketKeys()
+{
+    if (ticketKeys_)
+    {
+        ticketKeys_->rotate();
+    }
+
+    SslStats s = stats();
+    if (s.handshakes > 0)
+    {
+        LOG_INFO << "TLS handshakes " << s.handshakes << ", resumed " << s.resumed
+                 << " (" << (100.0 * s.resumed / s.handshakes) << "%), tickets issued " << s.ticketsIssued
+                 << ", renewed " << s.ticketsRenewed << ", unknown key " << s.ticketsUnknownKey
+                 << ", early data accepted " << s.earlyDataAccepted << ", replayed " << s.earlyDataReplayed;
+    }
+}
+
+double SslContext::ticketKeyCheckInterval() const
+{
+    return SessionTicketKeys::checkIntervalSecs(config_.getSessionTicketRotateInterval());
+}
+
+SslStats SslContext::stats() const
+{
+    SslStats s;
+    s.handshakes = handshakes_.load(std::memory_order_relaxed);
+    s.resumed = resumed_.load(std::memory_order_relaxed);
+    s.ticketsIssued = ticketKeys_ ? ticketKeys_->ticketsIssued() : 0;
+    s.ticketsRenewed = ticketKeys_ ? ticketKeys_->ticketsRenewed() : 0;
+    s.ticketsUnknownKey = ticketKeys_ ? ticketKeys_->ticketsUnknownKey() : 0;
+    s.earlyDataAccepted = earlyDataAccepted_.load(std::memory_order_relaxed);
+    s.earlyDataReplayed = antiReplay_ ? antiReplay_->replays() : 0;
+    return s;
 }
 
 void SslContext::handleSslError(const char* msg)
@@ -1,12 +1,29 @@
 #pragma once
 #include "SslConfig.h"
+#include "AntiReplayCache.h"
+#include "CertificateStore.h"
+#include "SessionTicketKeys.h"
 #include <openssl/ssl.h>
+#include <atomic>
 #include <memory>
 #include <muduo/base/noncopyable.h>
+#include <muduo/base/ThreadPool.h>
 
 namespace ssl 
 {
 
+// 会话恢复统计
+struct SslStats
+{
+    uint64_t handshakes; // 完成的握手数
+    uint64_t resumed; // 其中恢复会话的次数
+    uint64_t ticketsIssued; // 签发的票据数
+    uint64_t ticketsRenewed; // 用旧密钥解密后换发的票据数
+    uint64_t ticketsUnknownKey; // 密钥已淘汰、无法恢复的票据数
+    uint64_t earlyDataAccepted; // 接受了 0-RTT 早期数据的握手数
+    uint64_t earlyDataReplayed; // 被防重放缓存拒绝的早期数据
+};
+
 class SslContext : muduo::noncopyable 
 {
 public:
@@ -16,15 +33,54 @@ public:
     bool initialize();
     SSL_CTX* getNativeHandle() { return ctx_; }
 
+    // 由所在进程的主循环定时调用：轮换（或重新加载）票据密钥，并输出会话恢复率
+    void rotateTicketKeys();
+    // 定时调用的间隔，远小于轮换间隔，以便及时加载其它进程写入的新密钥
+    double ticketKeyCheckInterval() const;
+
+    // 握手完成时调用
+    void recordHandshake(bool resumed, bool earlyData)
+    {
+        handshakes_.fetch_add(1, std::memory_order_relaxed);
+        if (resumed) resumed_.fetch_add(1, std::memory_order_relaxed);
+        if (earlyData) earlyDataAccepted_.fetch_add(1, std::memory_order_relaxed);
+    }
+    SslStats stats() const;
+
+    // 重新加载证书，失败时保留原有证书；已建立的连接不受影响
+    bool reloadCertificates();
+    // 由主循环定时调用，证书文件有变化时重新加载
+    void checkCertificates();
+    int certificateCheckInterval() const { return config_.getCertificateCheckInterval(); }
+
+    // 是否在握手完成后尝试启用 kTLS
+    bool kernelTls() const { return config_.getKernelTls(); }
+
+    // 是否接受 0-RTT 早期数据，接受时握手改由 SSL_read_early_data 开始
+    bool earlyData() const { return config_.getEarlyData(); }
+
+    // 握手线程池，未配置握手线程时为 nullptr
+    muduo::ThreadPool* handshakePool() { return handshakePool_.get(); }
+
 private:
     bool loadCertificates();
     bool setupProtocol();
-    void setupSessionCache();
+    bool setupSessionCache();
+    void setupEarlyData();
+    // 决定是否接受一个 ClientHello 的早期数据
+    static int allowEarlyData(SSL* ssl, void* arg);
     static void handleSslError(const char* msg);
 
 private:
     SSL_CTX*  ctx_; // SSL上下文
     SslConfig config_; // SSL配置
+    std::unique_ptr<CertificateStore> certificates_; // 按 SNI 选择的证书
+    std::unique_ptr<SessionTicketKeys> ticketKeys_; // 会话票据密钥
+    std::unique_ptr<AntiReplayCache> antiReplay_; // 0-RTT 防重放缓存（可选）
+    std::unique_ptr<muduo::ThreadPool> handshakePool_; // 握手线程池（可选）
+    std::atomic<uint64_t> handshakes_; // 完成的握手数
+    std::atomic<uint64_t> resumed_; // 恢复会话的握手数
+    std::atomic<uint64_t> earlyDataAccepted_; // 接受早期数据的握手数
 };
 
 } // namespace ssl
\ No newline at end of file
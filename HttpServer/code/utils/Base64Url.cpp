@@ -0,0 +1,73 @@
+#include "Base64Url.h"
+
+#include <array>
+#include <cstdint>
+
+namespace http
+{
+
+namespace
+{
+
+const char kBase64UrlAlphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+} // namespace
+
+std::string base64UrlEncode(const std::string& in)
+{
+    std::string out;
+    out.reserve((in.size() * 4 + 2) / 3);
+    uint32_t acc = 0;
+    int bits = 0;
+    for (unsigned char c : in)
+    {
+        acc = (acc << 8) | c;
+        bits += 8;
+        while (bits >= 6)
+        {
+            bits -= 6;
+            out.push_back(kBase64UrlAlphabet[(acc >> bits) & 0x3F]);
+        }
+    }
+    if (bits > 0)
+    {
+        out.push_back(kBase64UrlAlphabet[(acc << (6 - bits)) & 0x3F]);
+    }
+    return out;
+}
+
+bool base64UrlDecode(const char* begin, const char* end, std::string* out)
+{
+    static const auto table = [] {
+        std::array<signed char, 256> t;
+        t.fill(-1);
+        for (int i = 0; i < 64; ++i)
+        {
+            t[static_cast<unsigned char>(kBase64UrlAlphabet[i])] = static_cast<signed char>(i);
+        }
+        return t;
+    }();
+
+    out->clear();
+    out->reserve((end - begin) * 3 / 4);
+    uint32_t acc = 0;
+    int bits = 0;
+    for (const char* p = begin; p != end; ++p)
+    {
+        signed char v = table[static_cast<unsigned char>(*p)];
+        if (v < 0)
+        {
+            return false;
+        }
+        acc = (acc << 6) | static_cast<uint32_t>(v);
+        bits += 6;
+        if (bits >= 8)
+        {
+            bits -= 8;
+            out->push_back(static_cast<char>((acc >> bits) & 0xFF));
+        }
+    }
+    return true;
+}
+
+} // namespace http
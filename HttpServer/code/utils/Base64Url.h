@@ -0,0 +1,14 @@
+#pragma once
+
+#include <string>
+
+namespace http
+{
+
+// base64url 编码（RFC 4648 第 5 节），不带填充，用于 JWT 与会话 cookie
+std::string base64UrlEncode(const std::string& in);
+
+// base64url 解码（无填充），非法字符返回 false
+bool base64UrlDecode(const char* begin, const char* end, std::string* out);
+
+} // namespace http
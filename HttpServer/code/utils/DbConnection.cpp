@@ -1,5 +1,6 @@
 #include "DbConnection.h"
 #include "DbException.h"
+#include <cmath>
 #include <muduo/base/Logging.h>
 
 namespace http 
@@ -47,6 +48,7 @@ DbConnection::~DbConnection()
     try 
     {
         cleanup();
+        clearStatements();
     } 
     catch (...) 
     {
@@ -55,6 +57,30 @@ DbConnection::~DbConnection()
     LOG_INFO << "Database connection closed";
 }
 
+int DbConnection::executeBatchUpdate(const std::string& sql, const std::vector<std::string>& params)
+{
+    http::RequestDeadline::check("executing query");
+    std::lock_guard<std::mutex> lock(mutex_);
+    try 
+    {
+        // 批量语句的 SQL 随行数变化，但分批大小固定时同样会反复出现，一并走缓存
+        sql::PreparedStatement* stmt = prepare(sql);
+        for (size_t i = 0; i < params.size(); ++i)
+        {
+            stmt->setString(static_cast<unsigned int>(i + 1), params[i]);
+        }
+        applyDeadline(stmt);
+        return stmt->executeUpdate();
+    } 
+    catch (const sql::SQLException& e) 
+    {
+        LOG_ERROR << "Batch update failed: " << e.what() << ", SQL: " << sql.substr(0, 128);
+        queryFailed_ = true;
+        evictStatement(sql);
+        throw DbException(e.what());
+    }
+}
+
 bool DbConnection::ping() 
 {
     try 
@@ -71,6 +97,14 @@ bool DbConnection::ping()
     }
 }
 
+bool DbConnection::takeQueryFailed()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    bool failed = queryFailed_;
+    queryFailed_ = false;
+    return failed;
+}
+
 bool DbConnection::isValid() 
 {
     try 
@@ -88,6 +122,8 @@ bool DbConnection::isValid()
 
 void DbConnection::reconnect() 
 {
+    // 旧连接上预处理的语句在新连接上无效
+    clearStatements();
     try 
     {
         if (conn_) 
@@ -108,6 +144,91 @@ void DbConnection::reconnect()
     }
 }
 
+void DbConnection::setStatementCacheCapacity(size_t capacity)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    statementCacheCapacity_ = capacity;
+    while (statements_.size() > statementCacheCapacity_)
+    {
+        statementIndex_.erase(statements_.back().first);
+        statements_.pop_back();
+    }
+}
+
+size_t DbConnection::statementCacheSize()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return statements_.size();
+}
+
+sql::PreparedStatement* DbConnection::prepare(const std::string& sql)
+{
+    auto it = statementIndex_.find(sql);
+    if (it != statementIndex_.end())
+    {
+        // 命中：移到表头，清掉上次绑定的参数后复用
+        statements_.splice(statements_.begin(), statements_, it->second);
+        sql::PreparedStatement* stmt = it->second->second.get();
+        stmt->clearParameters();
+        return stmt;
+    }
+
+    std::unique_ptr<sql::PreparedStatement> stmt(conn_->prepareStatement(sql));
+    if (statementCacheCapacity_ == 0)
+    {
+        // 不缓存时语句仍要存活到本次执行结束，只保留这一条，下次 prepare 时被替换
+        clearStatements();
+    }
+    else
+    {
+        while (statements_.size() >= statementCacheCapacity_)
+        {
+            statementIndex_.erase(statements_.back().first);
+            statements_.pop_back();
+        }
+    }
+    statements_.emplace_front(sql, std::move(stmt));
+    statementIndex_[sql] = statements_.begin();
+    return statements_.front().second.get();
+}
+
+void DbConnection::evictStatement(const std::string& sql)
+{
+    auto it = statementIndex_.find(sql);
+    if (it == statementIndex_.end())
+    {
+        return;
+    }
+    statements_.erase(it->second);
+    statementIndex_.erase(it);
+}
+
+void DbConnection::clearStatements()
+{
+    statementIndex_.clear();
+    statements_.clear();
+}
+
+void DbConnection::applyDeadline(sql::Statement* stmt)
+{
+    double remaining = http::RequestDeadline::remainingSeconds();
+    if (remaining == 0)
+    {
+        throw http::DeadlineExceeded("Deadline exceeded before executing query");
+    }
+    try
+    {
+        // 查询超时只支持秒级精度，向上取整；预处理语句会被缓存复用，
+        // 没有截止时间时要清除上一个请求设置的超时（0 表示不限时）
+        stmt->setQueryTimeout(remaining < 0 ? 0 : static_cast<unsigned int>(std::ceil(remaining)));
+    }
+    catch (const sql::SQLException& e)
+    {
+        // 部分驱动版本未实现语句超时，此时仅依赖执行前的截止时间检查
+        LOG_DEBUG << "setQueryTimeout not supported: " << e.what();
+    }
+}
+
 void DbConnection::cleanup() 
 {
     std::lock_guard<std::mutex> lock(mutex_);
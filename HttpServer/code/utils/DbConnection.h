@@ -1,7 +1,11 @@
 #pragma once
+#include <list>
 #include <memory>
 #include <string>
 #include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 #include <cppconn/connection.h>
 #include <cppconn/prepared_statement.h>
 #include <cppconn/resultset.h>
@@ -9,6 +13,7 @@
 #include <mysql/mysql.h>
 #include <muduo/base/Logging.h>
 #include "DbException.h"
+#include "RequestDeadline.h"
 
 namespace http 
 {
@@ -32,22 +37,48 @@ public:
     void reconnect();
     void cleanup();
 
+    // 使用缓存的预处理语句执行查询
+    // 结果集与语句共享服务端句柄，必须在本连接再次执行同一 SQL 之前释放（即在归还连接之前读完）
     template<typename... Args>
     sql::ResultSet* executeQuery(const std::string& sql, Args&&... args)
     {
+        http::RequestDeadline::check("executing query");
+        std::lock_guard<std::mutex> lock(mutex_);
+        try 
+        {
+            sql::PreparedStatement* stmt = prepare(sql);
+            bindParams(stmt, 1, std::forward<Args>(args)...);
+            applyDeadline(stmt);
+            return stmt->executeQuery();
+        } 
+        catch (const sql::SQLException& e) 
+        {
+            LOG_ERROR << "Query failed: " << e.what() << ", SQL: " << sql;
+            queryFailed_ = true;
+            evictStatement(sql);
+            throw DbException(e.what());
+        }
+    }
+
+    // 结果集需要在归还连接之后继续使用时调用，每次创建新的预处理语句，不经过缓存
+    template<typename... Args>
+    sql::ResultSet* executeDetachedQuery(const std::string& sql, Args&&... args)
+    {
+        http::RequestDeadline::check("executing query");
         std::lock_guard<std::mutex> lock(mutex_);
         try 
         {
-            // 直接创建新的预处理语句，不使用缓存
             std::unique_ptr<sql::PreparedStatement> stmt(
                 conn_->prepareStatement(sql)
             );
             bindParams(stmt.get(), 1, std::forward<Args>(args)...);
+            applyDeadline(stmt.get());
             return stmt->executeQuery();
         } 
         catch (const sql::SQLException& e) 
         {
             LOG_ERROR << "Query failed: " << e.what() << ", SQL: " << sql;
+            queryFailed_ = true;
             throw DbException(e.what());
         }
     }
@@ -55,25 +86,49 @@ public:
     template<typename... Args>
     int executeUpdate(const std::string& sql, Args&&... args)
     {
+        http::RequestDeadline::check("executing query");
         std::lock_guard<std::mutex> lock(mutex_);
         try 
         {
-            // 直接创建新的预处理语句，不使用缓存
-            std::unique_ptr<sql::PreparedStatement> stmt(
-                conn_->prepareStatement(sql)
-            );
-            bindParams(stmt.get(), 1, std::forward<Args>(args)...);
+            sql::PreparedStatement* stmt = prepare(sql);
+            bindParams(stmt, 1, std::forward<Args>(args)...);
+            applyDeadline(stmt);
             return stmt->executeUpdate();
         } 
         catch (const sql::SQLException& e) 
         {
             LOG_ERROR << "Update failed: " << e.what() << ", SQL: " << sql;
+            queryFailed_ = true;
+            evictStatement(sql);
             throw DbException(e.what());
         }
     }
 
+    // 参数个数运行时才确定的更新（如多行 INSERT），参数按顺序以字符串绑定
+    int executeBatchUpdate(const std::string& sql, const std::vector<std::string>& params);
+
     bool ping();  // 添加检测连接是否有效的方法
+
+    // 上次取出以来是否有语句执行失败（可能是网络错误，连接已不可用），取出后清除
+    // 连接池据此决定归还的连接下次借出前是否需要检测
+    bool takeQueryFailed();
+
+    // 预处理语句缓存的容量（按 SQL 文本），0 表示不缓存；超出时淘汰最久未用的语句
+    void setStatementCacheCapacity(size_t capacity);
+    size_t statementCacheSize();
+
+    static constexpr size_t kDefaultStatementCacheCapacity = 32;
 private:
+    // 取出 SQL 对应的缓存语句（清空旧参数），未命中时预处理并放入缓存，调用方需持有 mutex_
+    sql::PreparedStatement* prepare(const std::string& sql);
+    // 执行失败的语句可能已失效（如表结构变化），丢弃后下次重新预处理
+    void evictStatement(const std::string& sql);
+    // 语句句柄属于当前连接，重连或断开前必须释放
+    void clearStatements();
+
+    // 按当前请求的剩余时间设置语句超时，没有截止时间时清除超时
+    void applyDeadline(sql::Statement* stmt);
+
      // 辅助函数：递归终止条件
     void bindParams(sql::PreparedStatement*, int) {}
     
@@ -102,6 +157,13 @@ private:
     std::string                      password_;
     std::string                      database_;
     std::mutex                       mutex_;
+    bool                             queryFailed_ = false; // 有语句执行失败，由 mutex_ 保护
+
+    using StatementEntry = std::pair<std::string, std::unique_ptr<sql::PreparedStatement>>;
+    // 声明在 conn_ 之后，保证语句先于连接析构
+    std::list<StatementEntry>                                         statements_; // 表头为最近使用
+    std::unordered_map<std::string, std::list<StatementEntry>::iterator> statementIndex_;
+    size_t                                                            statementCacheCapacity_ = kDefaultStatementCacheCapacity;
 };
 
 } // namespace db
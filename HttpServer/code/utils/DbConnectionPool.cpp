@@ -1,22 +1,45 @@
 #include "DbConnectionPool.h"
 #include "DbException.h"
+#include <algorithm>
 #include <muduo/base/Logging.h>
 
-namespace http 
+namespace http
 {
-namespace db 
+namespace db
 {
 
+namespace
+{
+
+double elapsedMs(muduo::Timestamp since, muduo::Timestamp now)
+{
+    return muduo::timeDifference(now, since) * 1000;
+}
+
+} // namespace
+
+void DbConnectionPool::init(const std::string& host,
+                          const std::string& user,
+                          const std::string& password,
+                          const std::string& database,
+                          size_t poolSize)
+{
+    DbConnectionPoolConfig config;
+    config.minSize = poolSize;
+    config.maxSize = poolSize;
+    init(host, user, password, database, config);
+}
+
 void DbConnectionPool::init(const std::string& host,
                           const std::string& user,
                           const std::string& password,
                           const std::string& database,
-                          size_t poolSize) 
+                          const DbConnectionPoolConfig& config)
 {
     // 连接池会被多个线程访问，所以操作其成员变量时需要加锁
     std::lock_guard<std::mutex> lock(mutex_);
     // 确保只初始化一次
-    if (initialized_) 
+    if (initialized_)
     {
         return;
     }
@@ -25,136 +48,362 @@ void DbConnectionPool::init(const std::string& host,
     user_ = user;
     password_ = password;
     database_ = database;
+    config_ = config;
+    config_.maxSize = std::max<size_t>(config_.maxSize, 1);
+    config_.minSize = std::min(config_.minSize, config_.maxSize);
 
-    // 创建连接
-    for (size_t i = 0; i < poolSize; ++i) 
+    size_t shardCount = config_.shards;
+    if (shardCount == 0)
     {
-        connections_.push(createConnection());
+        shardCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    shards_.clear();
+    for (size_t i = 0; i < shardCount; ++i)
+    {
+        shards_.push_back(std::make_unique<Shard>());
+    }
+
+    // 创建常驻连接，任何一个失败都放弃初始化，可以再次调用 init 重试
+    try
+    {
+        for (size_t i = 0; i < config_.minSize; ++i)
+        {
+            ++total_;
+            pushIdle(i % shardCount, IdleConnection{createConnection(),
+                                                    muduo::Timestamp::now(),
+                                                    muduo::Timestamp::now()});
+        }
+    }
+    catch (...)
+    {
+        shards_.clear();
+        total_ = 0;
+        idle_ = 0;
+        throw;
     }
 
     initialized_ = true;
-    LOG_INFO << "Database connection pool initialized with " << poolSize << " connections";
+    maintenanceThread_ = std::thread(&DbConnectionPool::maintenanceLoop, this);
+    LOG_INFO << "Database connection pool initialized with " << config_.minSize
+             << " connections (max " << config_.maxSize << ", " << shardCount << " shards)";
 }
 
-DbConnectionPool::DbConnectionPool() 
+DbConnectionPool::DbConnectionPool()
+    : total_(0)
+    , idle_(0)
+    , waiters_(0)
+    , initialized_(false)
+    , stopping_(false)
 {
-    checkThread_ = std::thread(&DbConnectionPool::checkConnections, this);
-    checkThread_.detach();
 }
 
-DbConnectionPool::~DbConnectionPool() 
+DbConnectionPool::~DbConnectionPool()
 {
-    std::lock_guard<std::mutex> lock(mutex_);
-    while (!connections_.empty()) 
     {
-        connections_.pop();
+        std::lock_guard<std::mutex> lock(threadMutex_);
+        stopping_ = true;
+    }
+    threadCv_.notify_one();
+    if (maintenanceThread_.joinable())
+    {
+        maintenanceThread_.join();
+    }
+
+    for (auto& shard : shards_)
+    {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        shard->idle.clear();
     }
     LOG_INFO << "Database connection pool destroyed";
 }
 
-// 修改获取连接的函数
-std::shared_ptr<DbConnection> DbConnectionPool::getConnection() 
+std::shared_ptr<DbConnection> DbConnectionPool::getConnection()
 {
-    std::shared_ptr<DbConnection> conn;
+    http::RequestDeadline::check("acquiring database connection");
+    if (!initialized_)
     {
-        std::unique_lock<std::mutex> lock(mutex_);
-        
-        while (connections_.empty()) 
+        throw DbException("Connection pool not initialized");
+    }
+
+    // 等待上限取配置的获取超时与当前请求截止时间中较早者
+    muduo::Timestamp deadline = muduo::addTime(muduo::Timestamp::now(), config_.acquireTimeoutMs / 1000.0);
+    bool requestDeadline = false;
+    if (http::RequestDeadline::active() && http::RequestDeadline::current() < deadline)
+    {
+        deadline = http::RequestDeadline::current();
+        requestDeadline = true;
+    }
+
+    while (true)
+    {
+        IdleConnection entry;
+        if (takeIdle(entry))
         {
-            if (!initialized_) 
+            if (validate(entry))
             {
-                throw DbException("Connection pool not initialized");
+                return wrap(entry.conn);
             }
-            LOG_INFO << "Waiting for available connection...";
-            cv_.wait(lock);
+            continue; // 连接已丢弃并释放名额，重新获取
         }
-        
-        conn = connections_.front();
-        connections_.pop();
-    } // 释放锁
-    
-    try 
-    {
-        // 在锁外检查连接
-        if (!conn->ping()) 
+
+        if (reserveSlot())
         {
-            LOG_WARN << "Connection lost, attempting to reconnect...";
-            conn->reconnect();
+            try
+            {
+                return wrap(createConnection());
+            }
+            catch (...)
+            {
+                releaseSlot();
+                throw;
+            }
         }
-        
-        return std::shared_ptr<DbConnection>(conn.get(), 
-            [this, conn](DbConnection*) {
-                std::lock_guard<std::mutex> lock(mutex_);
-                connections_.push(conn);
-                cv_.notify_one();
-            });
-    } 
-    catch (const std::exception& e) 
-    {
-        LOG_ERROR << "Failed to get connection: " << e.what();
+
+        // 已达上限，等待连接归还或名额释放
+        std::unique_lock<std::mutex> lock(mutex_);
+        ++waiters_;
+        while (idle_ == 0 && total_ >= config_.maxSize)
         {
-            std::lock_guard<std::mutex> lock(mutex_);
-            connections_.push(conn);
-            cv_.notify_one();
+            if (cv_.wait_until(lock, http::RequestDeadline::toTimePoint(deadline)) == std::cv_status::timeout
+                && idle_ == 0 && total_ >= config_.maxSize)
+            {
+                --waiters_;
+                if (requestDeadline)
+                {
+                    throw http::DeadlineExceeded("Deadline exceeded while waiting for database connection");
+                }
+                LOG_WARN << "Timed out waiting for database connection";
+                throw DbException("Timed out after " + std::to_string(config_.acquireTimeoutMs)
+                                  + " ms waiting for a database connection (all "
+                                  + std::to_string(config_.maxSize) + " connections in use)");
+            }
         }
-        throw;
+        --waiters_;
     }
 }
 
-std::shared_ptr<DbConnection> DbConnectionPool::createConnection() 
+std::shared_ptr<DbConnection> DbConnectionPool::createConnection()
 {
     return std::make_shared<DbConnection>(host_, user_, password_, database_);
 }
 
-// 修改检查连接的函数
-void DbConnectionPool::checkConnections() 
+size_t DbConnectionPool::homeShard() const
+{
+    static std::atomic<size_t> nextSlot(0);
+    thread_local size_t slot = nextSlot++;
+    return slot % shards_.size();
+}
+
+bool DbConnectionPool::takeIdle(IdleConnection& out)
+{
+    if (idle_ == 0)
+    {
+        return false; // 没有空闲连接时不必逐个分片加锁
+    }
+    size_t home = homeShard();
+    for (size_t i = 0; i < shards_.size(); ++i)
+    {
+        Shard& shard = *shards_[(home + i) % shards_.size()];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (!shard.idle.empty())
+        {
+            out = std::move(shard.idle.back());
+            shard.idle.pop_back();
+            --idle_;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool DbConnectionPool::reserveSlot()
+{
+    size_t n = total_;
+    while (n < config_.maxSize)
+    {
+        if (total_.compare_exchange_weak(n, n + 1))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void DbConnectionPool::releaseSlot()
+{
+    --total_;
+    notifyWaiters();
+}
+
+bool DbConnectionPool::validate(IdleConnection& entry)
+{
+    muduo::Timestamp now = muduo::Timestamp::now();
+    if (elapsedMs(entry.lastChecked, now) < config_.validateAfterIdleMs)
+    {
+        // 最近确认过可用，省去一次往返
+        return true;
+    }
+    if (entry.conn->ping())
+    {
+        return true;
+    }
+    LOG_WARN << "Connection lost, attempting to reconnect...";
+    try
+    {
+        entry.conn->reconnect();
+        return true;
+    }
+    catch (const std::exception& e)
+    {
+        LOG_ERROR << "Failed to reconnect: " << e.what();
+        entry.conn.reset();
+        releaseSlot();
+        return false;
+    }
+}
+
+void DbConnectionPool::giveBack(const std::shared_ptr<DbConnection>& conn)
+{
+    muduo::Timestamp now = muduo::Timestamp::now();
+    // 执行失败的连接可能已经断开，不算作确认可用，下次借出前先检测
+    muduo::Timestamp lastChecked = conn->takeQueryFailed() ? muduo::Timestamp() : now;
+    pushIdle(homeShard(), IdleConnection{conn, now, lastChecked});
+}
+
+void DbConnectionPool::pushIdle(size_t shard, IdleConnection entry)
 {
-    while (true) 
     {
-        try 
+        std::lock_guard<std::mutex> lock(shards_[shard]->mutex);
+        shards_[shard]->idle.push_back(std::move(entry));
+    }
+    ++idle_;
+    notifyWaiters();
+}
+
+void DbConnectionPool::notifyWaiters()
+{
+    // 等待者在 mutex_ 内先登记再检查 idle_/total_，这里先修改计数再检查 waiters_，不会漏掉通知
+    if (waiters_ > 0)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        cv_.notify_one();
+    }
+}
+
+std::shared_ptr<DbConnection> DbConnectionPool::wrap(const std::shared_ptr<DbConnection>& conn)
+{
+    return std::shared_ptr<DbConnection>(conn.get(),
+        [this, conn](DbConnection*) {
+            giveBack(conn);
+        });
+}
+
+void DbConnectionPool::maintenanceLoop()
+{
+    std::unique_lock<std::mutex> lock(threadMutex_);
+    while (!stopping_)
+    {
+        threadCv_.wait_for(lock, std::chrono::milliseconds(config_.maintenanceIntervalMs));
+        if (stopping_)
+        {
+            break;
+        }
+
+        lock.unlock();
+        try
         {
-            std::vector<std::shared_ptr<DbConnection>> connsToCheck;
+            maintain();
+        }
+        catch (const std::exception& e)
+        {
+            LOG_ERROR << "Error in connection pool maintenance: " << e.what();
+        }
+        lock.lock();
+    }
+}
+
+void DbConnectionPool::maintain()
+{
+    muduo::Timestamp now = muduo::Timestamp::now();
+    std::vector<std::shared_ptr<DbConnection>>     toClose;
+    std::vector<std::pair<size_t, IdleConnection>> toCheck;
+
+    // 只在分片锁内摘下连接，关闭与检测都在锁外进行；摘下的连接不在空闲列表中，不会被借出
+    for (size_t i = 0; i < shards_.size(); ++i)
+    {
+        Shard& shard = *shards_[i];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto keep = shard.idle.begin();
+        for (auto it = shard.idle.begin(); it != shard.idle.end(); ++it)
+        {
+            if (elapsedMs(it->lastUsed, now) >= config_.idleTimeoutMs
+                && total_ - toClose.size() > config_.minSize)
             {
-                std::unique_lock<std::mutex> lock(mutex_);
-                if (connections_.empty()) 
-                {
-                    std::this_thread::sleep_for(std::chrono::seconds(1));
-                    continue;
-                }
-                
-                auto temp = connections_;
-                while (!temp.empty()) 
-                {
-                    connsToCheck.push_back(temp.front());
-                    temp.pop();
-                }
+                toClose.push_back(std::move(it->conn));
+                --idle_;
             }
-            
-            // 在锁外检查连接
-            for (auto& conn : connsToCheck) 
+            else if (elapsedMs(it->lastChecked, now) >= config_.keepaliveIntervalMs)
             {
-                if (!conn->ping()) 
-                {
-                    try 
-                    {
-                        conn->reconnect();
-                    } 
-                    catch (const std::exception& e) 
-                    {
-                        LOG_ERROR << "Failed to reconnect: " << e.what();
-                    }
-                }
+                toCheck.emplace_back(i, std::move(*it));
+                --idle_;
+            }
+            else
+            {
+                *keep++ = std::move(*it);
+            }
+        }
+        shard.idle.erase(keep, shard.idle.end());
+    }
+
+    if (!toClose.empty())
+    {
+        size_t closed = toClose.size();
+        toClose.clear();
+        for (size_t i = 0; i < closed; ++i)
+        {
+            releaseSlot();
+        }
+        LOG_INFO << "Closed " << closed << " idle database connections, " << total_ << " remaining";
+    }
+
+    for (auto& item : toCheck)
+    {
+        IdleConnection& entry = item.second;
+        entry.lastChecked = muduo::Timestamp::now();
+        if (!entry.conn->ping())
+        {
+            try
+            {
+                entry.conn->reconnect();
             }
-            
-            std::this_thread::sleep_for(std::chrono::seconds(60));
-        } 
-        catch (const std::exception& e) 
+            catch (const std::exception& e)
+            {
+                LOG_ERROR << "Failed to reconnect: " << e.what();
+                entry.conn.reset();
+                releaseSlot();
+                continue;
+            }
+        }
+        pushIdle(item.first, std::move(entry));
+    }
+
+    // 补足常驻连接（启动后数据库不可用、或检测失败丢弃连接之后）
+    for (size_t i = 0; total_ < config_.minSize && reserveSlot(); ++i)
+    {
+        try
+        {
+            pushIdle(i % shards_.size(), IdleConnection{createConnection(),
+                                                        muduo::Timestamp::now(),
+                                                        muduo::Timestamp::now()});
+        }
+        catch (const std::exception& e)
         {
-            LOG_ERROR << "Error in check thread: " << e.what();
-            std::this_thread::sleep_for(std::chrono::seconds(5));
+            releaseSlot();
+            LOG_ERROR << "Failed to create database connection: " << e.what();
+            break;
         }
     }
 }
 
 } // namespace db
-} // namespace http
\ No newline at end of file
+} // namespace http
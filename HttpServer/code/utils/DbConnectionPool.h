@@ -1,37 +1,79 @@
 #pragma once
-#include <queue>
+#include <atomic>
 #include <mutex>
 #include <condition_variable>
 #include <memory>
 #include <thread>
+#include <vector>
+#include <muduo/base/Timestamp.h>
 #include "DbConnection.h"
 
-namespace http 
+namespace http
 {
-namespace db 
+namespace db
 {
 
-class DbConnectionPool 
+struct DbConnectionPoolConfig
+{
+    size_t minSize = 2; // 常驻连接数，初始化时创建，空闲回收不低于此数
+    size_t maxSize = 10; // 连接数上限，不足时按需创建
+    int    acquireTimeoutMs = 3000; // 获取连接的最长等待时间（请求截止时间更早时以其为准）
+    int    validateAfterIdleMs = 30000; // 空闲超过此时长的连接借出前先检测，刚用过的连接直接借出
+    int    keepaliveIntervalMs = 60000; // 后台线程检测空闲连接的间隔，避免被服务端 wait_timeout 断开
+    int    idleTimeoutMs = 300000; // 超过 minSize 的连接空闲超过此时长后关闭
+    int    maintenanceIntervalMs = 5000; // 后台维护线程的运行间隔
+    size_t shards = 0; // 空闲连接的分片数，线程优先使用自己的分片，0 表示取 CPU 核数
+};
+
+// 弹性数据库连接池
+// 空闲连接按线程分片存放：连接归还到归还线程的分片，该线程下次优先取回同一连接（预处理语句缓存仍然有效），
+// 各 IO 线程基本只访问自己分片的锁；本分片为空时再从其它分片取，仍没有且未达上限时新建连接，
+// 达到上限才等待，等待超时抛出 DbException（请求截止时间先到则抛出 DeadlineExceeded）
+// 后台维护线程只处理从空闲分片中取出的连接，不会与借出的连接并发使用
+class DbConnectionPool
 {
 public:
     // 单例模式
-    static DbConnectionPool& getInstance() 
+    static DbConnectionPool& getInstance()
     {
         static DbConnectionPool instance;
         return instance;
     }
 
-    // 初始化连接池
+    // 初始化连接池，连接数固定为 poolSize
     void init(const std::string& host,
              const std::string& user,
              const std::string& password,
              const std::string& database,
              size_t poolSize = 10);
 
-    // 获取连接
+    void init(const std::string& host,
+             const std::string& user,
+             const std::string& password,
+             const std::string& database,
+             const DbConnectionPoolConfig& config);
+
+    // 获取连接，返回的 shared_ptr 释放时连接归还连接池
     std::shared_ptr<DbConnection> getConnection();
 
+    size_t totalConnections() const { return total_.load(); } // 含借出的连接
+    size_t idleConnections() const { return idle_.load(); }
+
 private:
+    // 空闲连接及其时间戳
+    struct IdleConnection
+    {
+        std::shared_ptr<DbConnection> conn;
+        muduo::Timestamp              lastUsed; // 最近一次归还的时间，用于空闲回收
+        muduo::Timestamp              lastChecked; // 最近一次确认可用的时间（无失败地归还或检测成功），归还前执行失败时为无效时间
+    };
+
+    struct Shard
+    {
+        std::mutex                  mutex;
+        std::vector<IdleConnection> idle; // 尾部为最近归还，后进先出
+    };
+
     // 构造函数
     DbConnectionPool();
     // 析构函数
@@ -43,18 +85,41 @@ private:
 
     std::shared_ptr<DbConnection> createConnection();
 
-    void checkConnections(); // 添加连接检查方法
+    // 当前线程的分片序号，线程首次使用时轮流分配
+    size_t homeShard() const;
+    // 先取本线程分片，再依次取其它分片，都为空时返回 false
+    bool takeIdle(IdleConnection& out);
+    // 在连接数未达上限时占用一个名额，成功后由调用方创建连接
+    bool reserveSlot();
+    // 释放名额（连接关闭或创建失败），唤醒等待者
+    void releaseSlot();
+    // 借出前检测长时间空闲的连接，不可用且重连失败时返回 false
+    bool validate(IdleConnection& entry);
+    void giveBack(const std::shared_ptr<DbConnection>& conn);
+    void pushIdle(size_t shard, IdleConnection entry);
+    void notifyWaiters();
+    std::shared_ptr<DbConnection> wrap(const std::shared_ptr<DbConnection>& conn);
+
+    void maintenanceLoop();
+    void maintain(); // 回收过期空闲连接、检测空闲连接、补足 minSize
 
 private:
-    std::string                               host_;
-    std::string                               user_;
-    std::string                               password_;
-    std::string                               database_;
-    std::queue<std::shared_ptr<DbConnection>> connections_;
-    std::mutex                                mutex_;
-    std::condition_variable                   cv_;
-    bool                                      initialized_ = false;
-    std::thread                               checkThread_; // 添加检查线程
+    std::string                         host_;
+    std::string                         user_;
+    std::string                         password_;
+    std::string                         database_;
+    DbConnectionPoolConfig              config_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+    std::atomic<size_t>                 total_; // 已创建（含正在创建）的连接数
+    std::atomic<size_t>                 idle_; // 各分片中的空闲连接数
+    std::atomic<size_t>                 waiters_; // 正在等待连接的线程数
+    std::mutex                          mutex_; // 保护初始化与等待
+    std::condition_variable             cv_; // 有连接归还或名额释放时通知等待者
+    std::atomic<bool>                   initialized_;
+    std::mutex                          threadMutex_;
+    std::condition_variable             threadCv_;
+    bool                                stopping_;
+    std::thread                         maintenanceThread_; // 后台维护线程，析构时 join
 };
 
 } // namespace db
@@ -20,8 +20,9 @@ public:
     template<typename... Args>
     sql::ResultSet* executeQuery(const std::string& sql, Args&&... args)
     {
+        // 返回时连接已归还连接池，结果集不能依赖连接上缓存的语句
         auto conn = http::db::DbConnectionPool::getInstance().getConnection();
-        return conn->executeQuery(sql, std::forward<Args>(args)...);
+        return conn->executeDetachedQuery(sql, std::forward<Args>(args)...);
     }
 
     template<typename... Args>
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <chrono>
+#include <stdexcept>
+#include <string>
+
+#include <muduo/base/Timestamp.h>
+
+namespace http
+{
+
+// 请求超过截止时间时抛出，HttpServer 捕获后返回 504
+class DeadlineExceeded : public std::runtime_error
+{
+public:
+    explicit DeadlineExceeded(const std::string& message)
+        : std::runtime_error(message) {}
+};
+
+// 当前线程正在处理的请求的截止时间
+// 处理函数在 IO 线程上同步执行，HttpServer 在调用路由前设置，DB 等下游调用据此设置超时
+class RequestDeadline
+{
+public:
+    // 在作用域内设置当前线程的截止时间，退出时恢复
+    class Scope
+    {
+    public:
+        explicit Scope(muduo::Timestamp deadline)
+            : saved_(current_)
+        { current_ = deadline; }
+
+        ~Scope() { current_ = saved_; }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        muduo::Timestamp saved_;
+    };
+
+    // 无截止时间时返回无效的 Timestamp
+    static muduo::Timestamp current() { return current_; }
+
+    static bool active() { return current_.valid(); }
+
+    // 剩余秒数，无截止时间时返回负数
+    static double remainingSeconds()
+    {
+        if (!active())
+        {
+            return -1;
+        }
+        double remaining = muduo::timeDifference(current_, muduo::Timestamp::now());
+        return remaining > 0 ? remaining : 0;
+    }
+
+    static bool exceeded()
+    { return active() && !(muduo::Timestamp::now() < current_); }
+
+    // 已超时则抛出 DeadlineExceeded，what 用于标明超时发生的位置
+    static void check(const char* what)
+    {
+        if (exceeded())
+        {
+            throw DeadlineExceeded(std::string("Deadline exceeded before ") + what);
+        }
+    }
+
+    // 转换为 std::chrono 时间点，供 condition_variable::wait_until 等使用
+    static std::chrono::system_clock::time_point toTimePoint(muduo::Timestamp t)
+    {
+        return std::chrono::system_clock::time_point(
+            std::chrono::microseconds(t.microSecondsSinceEpoch()));
+    }
+
+private:
+    static inline thread_local muduo::Timestamp current_;
+};
+
+} // namespace http
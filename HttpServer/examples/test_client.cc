@@ -1,104 +1,1195 @@
+// HTTP/HTTPS 压测客户端
+// 每个线程一个 epoll 循环，管理若干非阻塞连接；支持长连接、流水线、TLS 会话恢复开关、按权重混合的请求和请求体大小，
+// 结束后输出吞吐量以及请求延迟、建连时间、TLS 握手时间的分位数（HdrHistogram 式的对数-线性直方图）
+// 闭环压测：每个连接收到响应后才发出下一个请求（流水线时保持固定数量的在途请求），延迟不含排队等待发送的时间
+//
+// 编译：g++ -std=c++17 -O2 test_client.cc -o test_client -lssl -lcrypto -pthread
+// 例：test_client --https -p 443 -t 4 -c 64 -d 10 -r "GET / 80" -r "POST /api/echo 20 1024"
+//     test_client -p 80 -c 32 -n 100000 --no-keepalive
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
 #include <iostream>
+#include <memory>
+#include <random>
+#include <stdexcept>
 #include <string>
-#include <openssl/ssl.h>
+#include <thread>
+#include <vector>
+
 #include <openssl/err.h>
-#include <sys/socket.h>
-#include <netinet/in.h>
+#include <openssl/ssl.h>
+
 #include <arpa/inet.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <strings.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <time.h>
 #include <unistd.h>
 
-class HttpsClient 
+namespace
+{
+
+int64_t nowMicros()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+// 延迟直方图（微秒），结构同 HdrHistogram：值按 2 的幂分段，每段分成 1024 个线性子桶，
+// 相对误差不超过 1/1024（3 位有效数字），记录是 O(1) 的数组自增，多个线程的直方图可以直接相加
+class LatencyHistogram
 {
 public:
-    HttpsClient() 
+    static constexpr int     kSubBucketBits = 11;
+    static constexpr int64_t kSubBucketCount = int64_t(1) << kSubBucketBits; // 第 0 段精确记录 [0, 2048)
+    static constexpr int64_t kSubBucketHalf = kSubBucketCount / 2;
+    static constexpr int     kMaxShift = 26; // 最大可记录约 2^37 微秒（38 小时）
+
+    LatencyHistogram()
+        : counts_(kSubBucketCount + kMaxShift * kSubBucketHalf, 0)
+        , total_(0)
+        , min_(INT64_MAX)
+        , max_(0)
+        , sum_(0)
     {
-        // 初始化 OpenSSL
-        SSL_library_init();
-        SSL_load_error_strings();
-        OpenSSL_add_all_algorithms();
+    }
 
-        ctx_ = SSL_CTX_new(TLS_client_method());
-        if (!ctx_) 
+    void record(int64_t value)
+    {
+        value = std::max<int64_t>(value, 0);
+        ++counts_[indexOf(value)];
+        ++total_;
+        min_ = std::min(min_, value);
+        max_ = std::max(max_, value);
+        sum_ += static_cast<double>(value);
+    }
+
+    void merge(const LatencyHistogram& other)
+    {
+        for (size_t i = 0; i < counts_.size(); ++i)
         {
-            throw std::runtime_error("Failed to create SSL context");
+            counts_[i] += other.counts_[i];
         }
+        total_ += other.total_;
+        min_ = std::min(min_, other.min_);
+        max_ = std::max(max_, other.max_);
+        sum_ += other.sum_;
     }
 
-    ~HttpsClient() 
+    // 第 p 百分位的值（取所在子桶的上界，与 HdrHistogram 的 highestEquivalentValue 一致）
+    int64_t percentile(double p) const
     {
-        if (ssl_) SSL_free(ssl_);
-        if (ctx_) SSL_CTX_free(ctx_);
-        if (sock_ > 0) close(sock_);
+        if (total_ == 0)
+        {
+            return 0;
+        }
+        uint64_t target = static_cast<uint64_t>(std::ceil(p / 100.0 * total_));
+        target = std::max<uint64_t>(target, 1);
+        uint64_t seen = 0;
+        for (size_t i = 0; i < counts_.size(); ++i)
+        {
+            seen += counts_[i];
+            if (seen >= target)
+            {
+                return std::min(highestEquivalent(i), max_);
+            }
+        }
+        return max_;
+    }
+
+    uint64_t count() const { return total_; }
+    int64_t min() const { return total_ ? min_ : 0; }
+    int64_t max() const { return max_; }
+    double mean() const { return total_ ? sum_ / total_ : 0; }
+
+private:
+    static size_t indexOf(int64_t value)
+    {
+        if (value < kSubBucketCount)
+        {
+            return static_cast<size_t>(value);
+        }
+        int msb = 63 - __builtin_clzll(static_cast<unsigned long long>(value));
+        int shift = std::min(msb - (kSubBucketBits - 1), kMaxShift);
+        int64_t sub = std::min(value >> shift, kSubBucketCount - 1); // 超出范围的值记入最后一个子桶
+        return static_cast<size_t>(kSubBucketCount + (shift - 1) * kSubBucketHalf + (sub - kSubBucketHalf));
     }
 
-    void connect(const std::string& host, int port) 
+    static int64_t highestEquivalent(size_t index)
+    {
+        if (static_cast<int64_t>(index) < kSubBucketCount)
+        {
+            return static_cast<int64_t>(index);
+        }
+        int64_t k = static_cast<int64_t>(index) - kSubBucketCount;
+        int shift = static_cast<int>(k / kSubBucketHalf) + 1;
+        int64_t sub = k % kSubBucketHalf + kSubBucketHalf;
+        return ((sub + 1) << shift) - 1;
+    }
+
+private:
+    std::vector<uint64_t> counts_;
+    uint64_t              total_;
+    int64_t               min_;
+    int64_t               max_;
+    double                sum_;
+};
+
+// 请求组合中的一项
+struct RequestSpec
+{
+    std::string method;
+    std::string path;
+    int         weight; // 相对权重
+    size_t      bodySize; // 请求体字节数，0 表示没有请求体
+};
+
+struct Options
+{
+    std::string              host = "127.0.0.1";
+    int                      port = 443;
+    bool                     https = false;
+    int                      threads = 1;
+    int                      connections = 1; // 所有线程合计
+    double                   duration = 10; // 秒，requests > 0 时忽略
+    long                     requests = 0; // 总请求数
+    bool                     keepAlive = true;
+    int                      pipeline = 1; // 每个连接的在途请求数
+    bool                     resume = true; // 重新建连时恢复 TLS 会话
+    double                   timeout = 5; // 秒，在途请求或建连、握手超过该时间没有进展视为超时
+    std::string              tlsVersion; // "1.2" / "1.3"，为空时由双方协商
+    std::string              hostHeader;
+    std::vector<RequestSpec> mix;
+};
+
+// 一个线程的统计，结束后汇总
+struct Stats
+{
+    uint64_t         completed = 0;
+    uint64_t         status[6] = {}; // 按状态码首位统计，[0] 为无法识别的状态码
+    uint64_t         bytesRead = 0;
+    uint64_t         bytesWritten = 0;
+    uint64_t         connectionsOpened = 0;
+    uint64_t         handshakesFull = 0;
+    uint64_t         handshakesResumed = 0;
+    uint64_t         connectErrors = 0;
+    uint64_t         tlsErrors = 0;
+    uint64_t         ioErrors = 0; // 读写出错或对端在响应完成前关闭
+    uint64_t         timeouts = 0;
+    uint64_t         protocolErrors = 0; // 响应格式错误
+    LatencyHistogram latency; // 请求发出到完整收到响应
+    LatencyHistogram connectTime; // TCP 建连
+    LatencyHistogram handshakeFull; // 完整 TLS 握手
+    LatencyHistogram handshakeResumed; // 恢复会话的 TLS 握手
+
+    void merge(const Stats& o)
     {
-        // 创建套接字
-        sock_ = socket(AF_INET, SOCK_STREAM, 0);
-        if (sock_ < 0) {
-            throw std::runtime_error("Failed to create socket");
+        completed += o.completed;
+        for (int i = 0; i < 6; ++i)
+        {
+            status[i] += o.status[i];
         }
+        bytesRead += o.bytesRead;
+        bytesWritten += o.bytesWritten;
+        connectionsOpened += o.connectionsOpened;
+        handshakesFull += o.handshakesFull;
+        handshakesResumed += o.handshakesResumed;
+        connectErrors += o.connectErrors;
+        tlsErrors += o.tlsErrors;
+        ioErrors += o.ioErrors;
+        timeouts += o.timeouts;
+        protocolErrors += o.protocolErrors;
+        latency.merge(o.latency);
+        connectTime.merge(o.connectTime);
+        handshakeFull.merge(o.handshakeFull);
+        handshakeResumed.merge(o.handshakeResumed);
+    }
+};
+
+// 所有线程共享的运行参数
+struct Shared
+{
+    Options                 options;
+    struct sockaddr_storage addr;
+    socklen_t               addrLen = 0;
+    std::vector<std::string> prebuilt; // 按 mix 预先拼好的请求报文
+    std::vector<int>        cumulativeWeights;
+    std::atomic<long>       remaining{0}; // 按请求数压测时尚未发出的请求数
+    int64_t                 deadline = 0; // 按时长压测时的结束时间
+};
+
+class Worker;
 
-        struct sockaddr_in addr;
-        addr.sin_family = AF_INET;
-        addr.sin_port = htons(port);
-        addr.sin_addr.s_addr = inet_addr(host.c_str());
+// 一个客户端连接
+// 已发出、尚未收到响应的请求
+struct Inflight
+{
+    int64_t sentAt; // 发出时间
+    bool    head; // HEAD 请求的响应没有响应体
+};
+
+struct Connection
+{
+    enum State { kIdle, kConnecting, kHandshaking, kActive };
 
-        if (::connect(sock_, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
-            throw std::runtime_error("Failed to connect");
+    Worker*             worker = nullptr;
+    uint32_t            index = 0; // 在 Worker::conns_ 中的下标
+    uint32_t            generation = 0; // 每次关闭后递增，丢弃属于旧 socket 的 epoll 事件
+    int                 fd = -1;
+    SSL*                ssl = nullptr;
+    State               state = kIdle;
+    int64_t             phaseStart = 0; // 当前阶段（建连/握手）开始时间
+    int64_t             lastProgress = 0; // 最近一次读写有进展的时间
+    int64_t             retryAt = 0; // 建连失败后下次重试的时间
+    std::string         out; // 待发送的请求
+    size_t              outOffset = 0;
+    std::string         in; // 未解析的响应数据
+    std::deque<Inflight> inflight; // 在途请求，按发出顺序
+    long                requestsSent = 0; // 本连接发出的请求数
+    uint32_t            events = 0; // 当前注册的 epoll 事件
+
+    // 正在解析的响应
+    bool                headerDone = false;
+    int                 statusCode = 0;
+    long                contentLength = -1; // -1 表示没有 Content-Length，读到连接关闭为止
+    bool                serverClose = false;
+};
+
+class Worker
+{
+public:
+    static constexpr int64_t kConnectRetryMicros = 100 * 1000; // 建连失败后的重试间隔
+
+    Worker(Shared* shared, int connections, SSL_CTX* ctx, unsigned seed)
+        : shared_(shared)
+        , ctx_(ctx)
+        , conns_(connections)
+        , rng_(seed)
+        , session_(nullptr)
+    {
+        for (size_t i = 0; i < conns_.size(); ++i)
+        {
+            conns_[i].worker = this;
+            conns_[i].index = static_cast<uint32_t>(i);
         }
+    }
 
-        ssl_ = SSL_new(ctx_);
-        if (!ssl_) {
-            throw std::runtime_error("Failed to create SSL");
+    ~Worker()
+    {
+        for (Connection& c : conns_)
+        {
+            closeConnection(c);
         }
+        if (session_)
+        {
+            SSL_SESSION_free(session_);
+        }
+        if (epfd_ >= 0)
+        {
+            ::close(epfd_);
+        }
+    }
 
-        SSL_set_fd(ssl_, sock_);
-        if (SSL_connect(ssl_) <= 0) {
-            throw std::runtime_error("Failed to establish SSL connection");
+    void run();
+    const Stats& stats() const { return stats_; }
+
+    // 客户端收到新的会话（TLS 1.3 的会话票据在握手之后才到达），保存下来供下次建连恢复
+    static int onNewSession(SSL* ssl, SSL_SESSION* session)
+    {
+        Connection* c = static_cast<Connection*>(SSL_get_app_data(ssl));
+        if (!c || !c->worker->shared_->options.resume)
+        {
+            return 0;
+        }
+        Worker* w = c->worker;
+        if (w->session_)
+        {
+            SSL_SESSION_free(w->session_);
         }
+        w->session_ = session;
+        return 1; // 接管引用
+    }
 
-        std::cout << "Connected using: " << SSL_get_cipher(ssl_) << "\n";
+private:
+    bool running() const
+    {
+        return shared_->options.requests > 0 || nowMicros() < shared_->deadline;
     }
 
-    void sendGetRequest(const std::string& path) 
+    static uint64_t eventTag(const Connection& c)
     {
-        std::cout << "发送请求出去sendGetRequest" << std::endl;
-        std::string request = 
-            "GET " + path + " HTTP/1.1\r\n"
-            "Host: localhost\r\n"
-            "Connection: close\r\n"
-            "\r\n";
+        return (static_cast<uint64_t>(c.index) << 32) | c.generation;
+    }
 
-        if (SSL_write(ssl_, request.c_str(), request.length()) <= 0) 
+    bool claimRequest()
+    {
+        if (shared_->options.requests > 0)
         {
-            throw std::runtime_error("Failed to send request");
+            return shared_->remaining.fetch_sub(1, std::memory_order_relaxed) > 0;
         }
+        return nowMicros() < shared_->deadline;
+    }
 
-        char buffer[4096];
-        int bytes;
-        while ((bytes = SSL_read(ssl_, buffer, sizeof(buffer) - 1)) > 0) {
-            buffer[bytes] = 0;
-            std::cout << buffer;
+    // 按请求数压测时，建连或握手失败也消耗一个请求名额，服务端不可用时不会无限重试
+    void consumeOnFailure()
+    {
+        if (shared_->options.requests > 0)
+        {
+            shared_->remaining.fetch_sub(1, std::memory_order_relaxed);
         }
     }
 
+    bool idle() const
+    {
+        for (const Connection& c : conns_)
+        {
+            if (!c.inflight.empty())
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void startConnect(Connection& c);
+    void onConnected(Connection& c);
+    void doHandshake(Connection& c);
+    void handleEvent(Connection& c, uint32_t events);
+    void fillRequests(Connection& c);
+    bool flush(Connection& c);
+    bool readResponses(Connection& c);
+    bool parseResponses(Connection& c, bool eof);
+    void finishResponse(Connection& c);
+    void updateEvents(Connection& c);
+    void fail(Connection& c, uint64_t* counter);
+    void closeConnection(Connection& c);
+    void reconnectIfNeeded(Connection& c);
+    void checkTimeouts(int64_t now);
+    const std::string& pickRequest();
+
 private:
-    SSL_CTX* ctx_ = nullptr;
-    SSL* ssl_ = nullptr;
-    int sock_ = -1;
+    Shared*                 shared_;
+    SSL_CTX*                ctx_;
+    std::vector<Connection> conns_;
+    std::mt19937            rng_;
+    SSL_SESSION*            session_; // 最近一次拿到的会话，用于恢复
+    int                     epfd_ = -1;
+    Stats                   stats_;
 };
 
-int main() {
-    try {
-        HttpsClient client;
-        client.connect("127.0.0.1", 443);
-        std::cout << "连接成功connect" << std::endl;
-        client.sendGetRequest("/");
-        return 0;
+void Worker::run()
+{
+    epfd_ = ::epoll_create1(EPOLL_CLOEXEC);
+    if (epfd_ < 0)
+    {
+        perror("epoll_create1");
+        return;
+    }
+    for (Connection& c : conns_)
+    {
+        startConnect(c);
+    }
+
+    std::vector<struct epoll_event> events(256);
+    while (running() || !idle())
+    {
+        if (shared_->options.requests > 0 && shared_->remaining.load(std::memory_order_relaxed) <= 0 && idle())
+        {
+            break;
+        }
+        int n = ::epoll_wait(epfd_, events.data(), static_cast<int>(events.size()), 50);
+        if (n < 0 && errno != EINTR)
+        {
+            perror("epoll_wait");
+            break;
+        }
+        for (int i = 0; i < n; ++i)
+        {
+            // 同一批事件中前面的处理可能已经关闭并重建了连接，旧 socket 的事件直接丢弃
+            Connection& c = conns_[events[i].data.u64 >> 32];
+            if (static_cast<uint32_t>(events[i].data.u64) == c.generation)
+            {
+                handleEvent(c, events[i].events);
+            }
+        }
+
+        int64_t now = nowMicros();
+        if (shared_->options.requests == 0 && now >= shared_->deadline)
+        {
+            break; // 到时即停，在途请求不计入结果
+        }
+        checkTimeouts(now);
+    }
+}
+
+void Worker::startConnect(Connection& c)
+{
+    c.fd = ::socket(shared_->addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (c.fd < 0)
+    {
+        ++stats_.connectErrors;
+        consumeOnFailure();
+        c.retryAt = nowMicros() + kConnectRetryMicros;
+        return; // 空闲的连接由 checkTimeouts 稍后重试
+    }
+    int one = 1;
+    ::setsockopt(c.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    c.state = Connection::kConnecting;
+    c.phaseStart = c.lastProgress = nowMicros();
+    c.requestsSent = 0;
+    c.headerDone = false;
+    ++stats_.connectionsOpened;
+
+    int ret = ::connect(c.fd, reinterpret_cast<struct sockaddr*>(&shared_->addr), shared_->addrLen);
+    if (ret < 0 && errno != EINPROGRESS)
+    {
+        ++stats_.connectErrors;
+        consumeOnFailure();
+        closeConnection(c);
+        c.retryAt = nowMicros() + kConnectRetryMicros;
+        return;
+    }
+
+    c.events = EPOLLOUT;
+    struct epoll_event ev;
+    ev.events = c.events;
+    ev.data.u64 = eventTag(c);
+    ::epoll_ctl(epfd_, EPOLL_CTL_ADD, c.fd, &ev);
+}
+
+void Worker::onConnected(Connection& c)
+{
+    int err = 0;
+    socklen_t len = sizeof(err);
+    if (::getsockopt(c.fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0 || err != 0)
+    {
+        // 不立即重连，由 checkTimeouts 稍后重试，避免服务端不可用时空转
+        ++stats_.connectErrors;
+        consumeOnFailure();
+        closeConnection(c);
+        c.retryAt = nowMicros() + kConnectRetryMicros;
+        return;
+    }
+    int64_t now = nowMicros();
+    stats_.connectTime.record(now - c.phaseStart);
+    c.lastProgress = now;
+
+    if (!ctx_)
+    {
+        c.state = Connection::kActive;
+        fillRequests(c);
+        return;
+    }
+
+    c.ssl = SSL_new(ctx_);
+    SSL_set_fd(c.ssl, c.fd);
+    SSL_set_app_data(c.ssl, &c);
+    SSL_set_tlsext_host_name(c.ssl, shared_->options.host.c_str());
+    if (shared_->options.resume && session_)
+    {
+        SSL_set_session(c.ssl, session_);
+    }
+    c.state = Connection::kHandshaking;
+    c.phaseStart = now;
+    doHandshake(c);
+}
+
+void Worker::doHandshake(Connection& c)
+{
+    int ret = SSL_connect(c.ssl);
+    if (ret == 1)
+    {
+        int64_t now = nowMicros();
+        if (SSL_session_reused(c.ssl))
+        {
+            ++stats_.handshakesResumed;
+            stats_.handshakeResumed.record(now - c.phaseStart);
+        }
+        else
+        {
+            ++stats_.handshakesFull;
+            stats_.handshakeFull.record(now - c.phaseStart);
+        }
+        c.state = Connection::kActive;
+        c.lastProgress = now;
+        fillRequests(c);
+        return;
+    }
+
+    switch (SSL_get_error(c.ssl, ret))
+    {
+        case SSL_ERROR_WANT_READ:
+            c.events = EPOLLIN;
+            updateEvents(c);
+            break;
+        case SSL_ERROR_WANT_WRITE:
+            c.events = EPOLLOUT;
+            updateEvents(c);
+            break;
+        default:
+            ERR_clear_error();
+            consumeOnFailure();
+            fail(c, &stats_.tlsErrors);
+            break;
+    }
+}
+
+void Worker::handleEvent(Connection& c, uint32_t events)
+{
+    if (c.fd < 0)
+    {
+        return;
+    }
+    switch (c.state)
+    {
+        case Connection::kConnecting:
+            onConnected(c);
+            break;
+        case Connection::kHandshaking:
+            doHandshake(c);
+            break;
+        case Connection::kActive:
+            if ((events & (EPOLLIN | EPOLLERR | EPOLLHUP)) && !readResponses(c))
+            {
+                return;
+            }
+            if ((events & EPOLLOUT) && flush(c))
+            {
+                updateEvents(c);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+const std::string& Worker::pickRequest()
+{
+    const std::vector<int>& weights = shared_->cumulativeWeights;
+    if (weights.size() == 1)
+    {
+        return shared_->prebuilt[0];
+    }
+    int r = std::uniform_int_distribution<int>(0, weights.back() - 1)(rng_);
+    size_t i = std::upper_bound(weights.begin(), weights.end(), r) - weights.begin();
+    return shared_->prebuilt[i];
+}
+
+void Worker::fillRequests(Connection& c)
+{
+    const Options& opt = shared_->options;
+    // 短连接每个连接只发一个请求；流水线时保持 pipeline 个在途请求
+    size_t depth = opt.keepAlive ? static_cast<size_t>(opt.pipeline) : 1;
+    int64_t now = nowMicros();
+    while (c.inflight.size() < depth && (opt.keepAlive || c.requestsSent == 0) && claimRequest())
+    {
+        const std::string& req = pickRequest();
+        c.out.append(req);
+        c.inflight.push_back(Inflight{now, req.compare(0, 5, "HEAD ") == 0});
+        ++c.requestsSent;
+    }
+    if (flush(c))
+    {
+        updateEvents(c);
+    }
+}
+
+// 尽量写出 out，返回连接是否仍然可用
+bool Worker::flush(Connection& c)
+{
+    while (c.outOffset < c.out.size())
+    {
+        const char* data = c.out.data() + c.outOffset;
+        size_t len = c.out.size() - c.outOffset;
+        ssize_t n;
+        if (c.ssl)
+        {
+            size_t written = 0;
+            int ret = SSL_write_ex(c.ssl, data, len, &written);
+            if (ret <= 0)
+            {
+                int err = SSL_get_error(c.ssl, ret);
+                if (err == SSL_ERROR_WANT_WRITE || err == SSL_ERROR_WANT_READ)
+                {
+                    break;
+                }
+                ERR_clear_error();
+                fail(c, &stats_.ioErrors);
+                return false;
+            }
+            n = static_cast<ssize_t>(written);
+        }
+        else
+        {
+            n = ::send(c.fd, data, len, MSG_NOSIGNAL);
+            if (n < 0)
+            {
+                if (errno == EAGAIN || errno == EINTR)
+                {
+                    break;
+                }
+                fail(c, &stats_.ioErrors);
+                return false;
+            }
+        }
+        c.outOffset += n;
+        stats_.bytesWritten += n;
+        c.lastProgress = nowMicros();
+    }
+    if (c.outOffset == c.out.size())
+    {
+        c.out.clear();
+        c.outOffset = 0;
+    }
+    return true;
+}
+
+// 读出所有可读数据并解析完整的响应，返回连接是否仍然可用
+bool Worker::readResponses(Connection& c)
+{
+    uint32_t generation = c.generation;
+    char buf[64 * 1024];
+    bool eof = false;
+    for (;;)
+    {
+        ssize_t n;
+        if (c.ssl)
+        {
+            size_t got = 0;
+            int ret = SSL_read_ex(c.ssl, buf, sizeof(buf), &got);
+            if (ret <= 0)
+            {
+                int err = SSL_get_error(c.ssl, ret);
+                if (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE)
+                {
+                    break;
+                }
+                ERR_clear_error();
+                eof = true; // close_notify 或连接断开，是否算错误取决于是否还有未完成的响应
+                break;
+            }
+            n = static_cast<ssize_t>(got);
+        }
+        else
+        {
+            n = ::recv(c.fd, buf, sizeof(buf), 0);
+            if (n < 0)
+            {
+                if (errno == EAGAIN || errno == EINTR)
+                {
+                    break;
+                }
+                eof = true;
+                break;
+            }
+            if (n == 0)
+            {
+                eof = true;
+                break;
+            }
+        }
+        c.in.append(buf, n);
+        stats_.bytesRead += n;
+        c.lastProgress = nowMicros();
+    }
+
+    if (!parseResponses(c, eof) || c.generation != generation)
+    {
+        return false;
+    }
+    if (eof)
+    {
+        // 对端关闭：在途请求作废，需要时重新建连
+        if (!c.inflight.empty())
+        {
+            fail(c, &stats_.ioErrors);
+        }
+        else
+        {
+            closeConnection(c);
+            reconnectIfNeeded(c);
+        }
+        return false;
+    }
+    return c.fd >= 0;
+}
+
+// 解析 in 中所有完整的响应，返回连接是否仍然可用
+bool Worker::parseResponses(Connection& c, bool eof)
+{
+    uint32_t generation = c.generation;
+    while (c.generation == generation)
+    {
+        if (!c.headerDone)
+        {
+            size_t end = c.in.find("\r\n\r\n");
+            if (end == std::string::npos)
+            {
+                return true;
+            }
+            if (c.inflight.empty() || c.in.compare(0, 5, "HTTP/") != 0)
+            {
+                fail(c, &stats_.protocolErrors);
+                return false;
+            }
+            size_t space = c.in.find(' ');
+            c.statusCode = space < end ? std::atoi(c.in.c_str() + space + 1) : 0;
+            c.contentLength = -1;
+            // HTTP/1.0 的响应默认是短连接，除非带 Connection: keep-alive
+            c.serverClose = c.in.compare(0, 8, "HTTP/1.0") == 0;
+
+            // 逐行查找需要的响应头，名称不区分大小写
+            size_t pos = c.in.find("\r\n") + 2;
+            while (pos < end)
+            {
+                size_t eol = c.in.find("\r\n", pos);
+                size_t colon = c.in.find(':', pos);
+                if (colon < eol)
+                {
+                    std::string name = c.in.substr(pos, colon - pos);
+                    std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+                    size_t v = c.in.find_first_not_of(' ', colon + 1);
+                    std::string value = c.in.substr(v, eol - v);
+                    if (name == "content-length")
+                    {
+                        c.contentLength = std::atol(value.c_str());
+                    }
+                    else if (name == "connection" && strncasecmp(value.c_str(), "close", 5) == 0)
+                    {
+                        c.serverClose = true;
+                    }
+                    else if (name == "connection" && strncasecmp(value.c_str(), "keep-alive", 10) == 0)
+                    {
+                        c.serverClose = false;
+                    }
+                    else if (name == "transfer-encoding")
+                    {
+                        // 服务端总是带 Content-Length，不支持分块编码
+                        fail(c, &stats_.protocolErrors);
+                        return false;
+                    }
+                }
+                pos = eol + 2;
+            }
+            c.in.erase(0, end + 4);
+            if (c.statusCode >= 100 && c.statusCode < 200)
+            {
+                continue; // 1xx 是临时响应，没有响应体，之后还有最终响应
+            }
+            // HEAD、204、304 的响应没有响应体，Content-Length 描述的是对应 GET 的响应
+            if (c.inflight.front().head || c.statusCode == 204 || c.statusCode == 304)
+            {
+                c.contentLength = 0;
+            }
+            c.headerDone = true;
+        }
+
+        if (c.contentLength < 0)
+        {
+            // 没有 Content-Length 的响应读到连接关闭为止
+            if (!eof)
+            {
+                return true;
+            }
+            c.in.clear();
+        }
+        else if (c.in.size() < static_cast<size_t>(c.contentLength))
+        {
+            return true;
+        }
+        else
+        {
+            c.in.erase(0, c.contentLength);
+        }
+        finishResponse(c);
+        if (c.generation != generation)
+        {
+            return false; // 连接已关闭（可能已经重新建连）
+        }
+        if (c.in.empty())
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void Worker::finishResponse(Connection& c)
+{
+    int64_t now = nowMicros();
+    stats_.latency.record(now - c.inflight.front().sentAt);
+    c.inflight.pop_front();
+    c.headerDone = false;
+    ++stats_.completed;
+    int cls = c.statusCode / 100;
+    ++stats_.status[cls >= 1 && cls <= 5 ? cls : 0];
+
+    if (!shared_->options.keepAlive || c.serverClose)
+    {
+        if (c.inflight.empty())
+        {
+            closeConnection(c);
+            reconnectIfNeeded(c);
+        }
+        else
+        {
+            // 服务端要求关闭，已经发出的流水线请求不会再有响应
+            fail(c, &stats_.ioErrors);
+        }
+        return;
+    }
+    fillRequests(c);
+}
+
+void Worker::updateEvents(Connection& c)
+{
+    if (c.fd < 0)
+    {
+        return;
+    }
+    uint32_t events = c.events;
+    if (c.state == Connection::kActive)
+    {
+        events = EPOLLIN | (c.out.empty() ? 0u : static_cast<uint32_t>(EPOLLOUT));
+    }
+    struct epoll_event ev;
+    ev.events = events;
+    ev.data.u64 = eventTag(c);
+    ::epoll_ctl(epfd_, EPOLL_CTL_MOD, c.fd, &ev);
+    c.events = events;
+}
+
+// 连接出错：在途请求计为一次错误，关闭后重新建连
+void Worker::fail(Connection& c, uint64_t* counter)
+{
+    ++*counter;
+    closeConnection(c);
+    reconnectIfNeeded(c);
+}
+
+void Worker::closeConnection(Connection& c)
+{
+    if (c.ssl)
+    {
+        // 发送 close_notify，否则 OpenSSL 会把会话标记为不可恢复
+        SSL_shutdown(c.ssl);
+        SSL_free(c.ssl);
+        c.ssl = nullptr;
+    }
+    if (c.fd >= 0)
+    {
+        ::close(c.fd); // 关闭时自动从 epoll 中移除
+        c.fd = -1;
+    }
+    c.state = Connection::kIdle;
+    ++c.generation;
+    c.out.clear();
+    c.outOffset = 0;
+    c.in.clear();
+    c.inflight.clear();
+    c.headerDone = false;
+}
+
+void Worker::reconnectIfNeeded(Connection& c)
+{
+    bool moreWork = shared_->options.requests > 0
+        ? shared_->remaining.load(std::memory_order_relaxed) > 0
+        : nowMicros() < shared_->deadline;
+    if (moreWork)
+    {
+        startConnect(c);
+    }
+}
+
+void Worker::checkTimeouts(int64_t now)
+{
+    int64_t limit = static_cast<int64_t>(shared_->options.timeout * 1e6);
+    for (Connection& c : conns_)
+    {
+        bool waiting = c.state == Connection::kConnecting || c.state == Connection::kHandshaking
+            || !c.inflight.empty();
+        if (c.fd >= 0 && waiting && now - c.lastProgress > limit)
+        {
+            fail(c, &stats_.timeouts);
+        }
+        else if (c.fd < 0 && now >= c.retryAt)
+        {
+            reconnectIfNeeded(c); // 之前建连失败的连接
+        }
+    }
+}
+
+std::string buildRequest(const RequestSpec& spec, const Options& opt)
+{
+    std::string host = opt.hostHeader.empty() ? opt.host : opt.hostHeader;
+    std::string req = spec.method + " " + spec.path + " HTTP/1.1\r\n"
+                    + "Host: " + host + "\r\n"
+                    + "Connection: " + (opt.keepAlive ? "Keep-Alive" : "close") + "\r\n";
+    if (spec.bodySize > 0 || spec.method == "POST" || spec.method == "PUT")
+    {
+        req += "Content-Type: application/octet-stream\r\n";
+        req += "Content-Length: " + std::to_string(spec.bodySize) + "\r\n";
+    }
+    req += "\r\n";
+    req.append(spec.bodySize, 'x');
+    return req;
+}
+
+// "METHOD PATH [WEIGHT [BODY_BYTES]]"
+bool parseRequestSpec(const std::string& text, size_t defaultBody, RequestSpec* spec)
+{
+    char method[16], path[2048];
+    int weight = 1;
+    long body = -1;
+    int n = std::sscanf(text.c_str(), "%15s %2047s %d %ld", method, path, &weight, &body);
+    if (n < 2 || weight <= 0)
+    {
+        return false;
+    }
+    spec->method = method;
+    spec->path = path;
+    spec->weight = weight;
+    bool hasBody = spec->method == "POST" || spec->method == "PUT";
+    spec->bodySize = body >= 0 ? static_cast<size_t>(body) : (hasBody ? defaultBody : 0);
+    return true;
+}
+
+void printLatency(const char* name, const LatencyHistogram& h)
+{
+    if (h.count() == 0)
+    {
+        return;
+    }
+    std::printf("  %-18s %9.0f %9ld %9ld %9ld %9ld %9ld %9ld %9ld %10lu\n", name, h.mean(),
+                (long)h.percentile(50), (long)h.percentile(75), (long)h.percentile(90),
+                (long)h.percentile(99), (long)h.percentile(99.9), (long)h.percentile(99.99),
+                (long)h.max(), (unsigned long)h.count());
+}
+
+void usage(const char* prog)
+{
+    std::fprintf(stderr,
+        "用法: %s [选项]\n"
+        "  -H, --host HOST          服务器地址（默认 127.0.0.1）\n"
+        "  -p, --port PORT          端口（默认 443）\n"
+        "      --https              使用 TLS\n"
+        "  -t, --threads N          线程数（默认 1）\n"
+        "  -c, --connections N      并发连接数，所有线程合计（默认 1）\n"
+        "  -d, --duration SECS      压测时长（默认 10）\n"
+        "  -n, --requests N         总请求数，指定后忽略 --duration\n"
+        "      --no-keepalive       每个请求新建连接\n"
+        "  -P, --pipeline N         每个连接的流水线深度（默认 1）\n"
+        "      --no-resume          重新建连时不恢复 TLS 会话\n"
+        "  -r, --request SPEC       请求 \"METHOD PATH [WEIGHT [BODY_BYTES]]\"，可多次指定，按权重混合\n"
+        "  -b, --body-size BYTES    POST/PUT 默认请求体大小（默认 0）\n"
+        "      --timeout SECS       无进展超时（默认 5）\n"
+        "      --tls-version V      限定 TLS 版本 1.2 或 1.3\n"
+        "      --host-header NAME   Host 请求头与 SNI 之外的主机名\n",
+        prog);
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    Options opt;
+    std::vector<std::string> specs;
+    size_t defaultBody = 0;
+    bool portSet = false;
+
+    static const struct option longOptions[] = {
+        { "host", required_argument, nullptr, 'H' },
+        { "port", required_argument, nullptr, 'p' },
+        { "https", no_argument, nullptr, 's' },
+        { "threads", required_argument, nullptr, 't' },
+        { "connections", required_argument, nullptr, 'c' },
+        { "duration", required_argument, nullptr, 'd' },
+        { "requests", required_argument, nullptr, 'n' },
+        { "no-keepalive", no_argument, nullptr, 'K' },
+        { "pipeline", required_argument, nullptr, 'P' },
+        { "no-resume", no_argument, nullptr, 'R' },
+        { "request", required_argument, nullptr, 'r' },
+        { "body-size", required_argument, nullptr, 'b' },
+        { "timeout", required_argument, nullptr, 'T' },
+        { "tls-version", required_argument, nullptr, 'V' },
+        { "host-header", required_argument, nullptr, 'A' },
+        { "help", no_argument, nullptr, 'h' },
+        { nullptr, 0, nullptr, 0 },
+    };
+    int ch;
+    while ((ch = getopt_long(argc, argv, "H:p:t:c:d:n:P:r:b:h", longOptions, nullptr)) != -1)
+    {
+        switch (ch)
+        {
+            case 'H': opt.host = optarg; break;
+            case 'p': opt.port = std::atoi(optarg); portSet = true; break;
+            case 's': opt.https = true; break;
+            case 't': opt.threads = std::max(1, std::atoi(optarg)); break;
+            case 'c': opt.connections = std::max(1, std::atoi(optarg)); break;
+            case 'd': opt.duration = std::atof(optarg); break;
+            case 'n': opt.requests = std::atol(optarg); break;
+            case 'K': opt.keepAlive = false; break;
+            case 'P': opt.pipeline = std::max(1, std::atoi(optarg)); break;
+            case 'R': opt.resume = false; break;
+            case 'r': specs.push_back(optarg); break;
+            case 'b': defaultBody = static_cast<size_t>(std::atol(optarg)); break;
+            case 'T': opt.timeout = std::atof(optarg); break;
+            case 'V': opt.tlsVersion = optarg; break;
+            case 'A': opt.hostHeader = optarg; break;
+            default: usage(argv[0]); return ch == 'h' ? 0 : 1;
+        }
+    }
+    if (!portSet && !opt.https)
+    {
+        opt.port = 80;
+    }
+    if (specs.empty())
+    {
+        specs.push_back("GET /");
+    }
+    opt.threads = std::min(opt.threads, opt.connections);
+
+    auto shared = std::make_unique<Shared>();
+    for (const std::string& text : specs)
+    {
+        RequestSpec spec;
+        if (!parseRequestSpec(text, defaultBody, &spec))
+        {
+            std::cerr << "Invalid request spec: " << text << std::endl;
+            return 1;
+        }
+        opt.mix.push_back(spec);
+        shared->prebuilt.push_back(buildRequest(spec, opt));
+        int prev = shared->cumulativeWeights.empty() ? 0 : shared->cumulativeWeights.back();
+        shared->cumulativeWeights.push_back(prev + spec.weight);
     }
-    catch (const std::exception& e) {
-        std::cerr << "Error: " << e.what() << std::endl;
+
+    struct addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo* res = nullptr;
+    if (getaddrinfo(opt.host.c_str(), std::to_string(opt.port).c_str(), &hints, &res) != 0 || !res)
+    {
+        std::cerr << "Cannot resolve " << opt.host << std::endl;
         return 1;
     }
-}
\ No newline at end of file
+    memcpy(&shared->addr, res->ai_addr, res->ai_addrlen);
+    shared->addrLen = res->ai_addrlen;
+    freeaddrinfo(res);
+
+    SSL_CTX* ctx = nullptr;
+    if (opt.https)
+    {
+        ctx = SSL_CTX_new(TLS_client_method());
+        if (!ctx)
+        {
+            std::cerr << "Failed to create SSL context" << std::endl;
+            return 1;
+        }
+        // 压测不校验服务端证书
+        SSL_CTX_set_verify(ctx, SSL_VERIFY_NONE, nullptr);
+        SSL_CTX_set_mode(ctx, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+        if (opt.tlsVersion == "1.2" || opt.tlsVersion == "1.3")
+        {
+            int v = opt.tlsVersion == "1.2" ? TLS1_2_VERSION : TLS1_3_VERSION;
+            SSL_CTX_set_min_proto_version(ctx, v);
+            SSL_CTX_set_max_proto_version(ctx, v);
+        }
+#ifdef SSL_OP_IGNORE_UNEXPECTED_EOF
+        // 服务端关闭连接时不一定发送 close_notify，不当作致命错误，否则 OpenSSL 会把共用的会话标记为不可恢复
+        SSL_CTX_set_options(ctx, SSL_OP_IGNORE_UNEXPECTED_EOF);
+#endif
+        // 会话由各线程自己保存，不使用内部缓存
+        SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+        SSL_CTX_sess_set_new_cb(ctx, Worker::onNewSession);
+    }
+
+    ::signal(SIGPIPE, SIG_IGN);
+    shared->options = opt;
+    shared->remaining = opt.requests;
+
+    if (opt.requests > 0)
+    {
+        std::printf("Running %ld requests", opt.requests);
+    }
+    else
+    {
+        std::printf("Running %gs test", opt.duration);
+    }
+    std::printf(" @ %s://%s:%d\n", opt.https ? "https" : "http", opt.host.c_str(), opt.port);
+    std::printf("  %d threads, %d connections, %s, pipeline %d%s\n", opt.threads, opt.connections,
+                opt.keepAlive ? "keep-alive" : "new connection per request", opt.keepAlive ? opt.pipeline : 1,
+                opt.https ? (opt.resume ? ", session resumption on" : ", session resumption off") : "");
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    for (int i = 0; i < opt.threads; ++i)
+    {
+        int conns = opt.connections / opt.threads + (i < opt.connections % opt.threads ? 1 : 0);
+        workers.push_back(std::make_unique<Worker>(shared.get(), conns, ctx, 12345u + i));
+    }
+
+    int64_t start = nowMicros();
+    shared->deadline = start + static_cast<int64_t>(opt.duration * 1e6);
+    std::vector<std::thread> threads;
+    for (auto& w : workers)
+    {
+        threads.emplace_back([&w] { w->run(); });
+    }
+    for (std::thread& t : threads)
+    {
+        t.join();
+    }
+    double elapsed = (nowMicros() - start) / 1e6;
+
+    Stats total;
+    for (auto& w : workers)
+    {
+        total.merge(w->stats());
+    }
+    workers.clear();
+    if (ctx)
+    {
+        SSL_CTX_free(ctx);
+    }
+
+    std::printf("\nRequests:     %lu in %.2fs, %.1f req/s\n", (unsigned long)total.completed, elapsed,
+                total.completed / elapsed);
+    std::printf("Transfer:     %.2f MB read (%.2f MB/s), %.2f MB written\n", total.bytesRead / 1048576.0,
+                total.bytesRead / 1048576.0 / elapsed, total.bytesWritten / 1048576.0);
+    std::printf("Status:       2xx %lu, 3xx %lu, 4xx %lu, 5xx %lu, other %lu\n",
+                (unsigned long)total.status[2], (unsigned long)total.status[3], (unsigned long)total.status[4],
+                (unsigned long)total.status[5], (unsigned long)(total.status[0] + total.status[1]));
+    std::printf("Errors:       connect %lu, tls %lu, read/write %lu, timeout %lu, protocol %lu\n",
+                (unsigned long)total.connectErrors, (unsigned long)total.tlsErrors, (unsigned long)total.ioErrors,
+                (unsigned long)total.timeouts, (unsigned long)total.protocolErrors);
+    std::printf("Connections:  %lu opened", (unsigned long)total.connectionsOpened);
+    if (opt.https)
+    {
+        std::printf(", TLS handshakes %lu full, %lu resumed", (unsigned long)total.handshakesFull,
+                    (unsigned long)total.handshakesResumed);
+    }
+    std::printf("\n\nLatency (us)            mean       p50       p75       p90       p99     p99.9    p99.99       max      count\n");
+    printLatency("request", total.latency);
+    printLatency("connect", total.connectTime);
+    printLatency("handshake full", total.handshakeFull);
+    printLatency("handshake resumed", total.handshakeResumed);
+
+    uint64_t errors = total.connectErrors + total.tlsErrors + total.ioErrors + total.timeouts + total.protocolErrors;
+    return errors == 0 ? 0 : 2;
+}